@@ -0,0 +1,274 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "clusters.h"
+#include "color.h"
+#include "depthsort.h"
+#include "framebuffer.h"
+#include "rasterizer.h"
+#include "shading.h"
+#include "threadpool.h"
+#include "vertexstage.h"
+#include "wireframe.h"
+
+// Render por lotes (--batch poses.txt): muchas vistas del mismo modelo sin
+// ventana, para vueltas completas (turntables) y miniaturas.
+//
+// Cada pose se dibuja entera en un solo hilo, sobre su propio framebuffer
+// y sus propios buffers de trabajo, y las poses se reparten entre los hilos
+// del pool. Así no hay nada que sincronizar dentro de un frame y el
+// rendimiento crece con los núcleos aunque cada imagen sea pequeña (con
+// miniaturas los tiles no alcanzan para repartir un solo frame).
+//
+// El dibujo es el mismo que el del frame por tiles (el rasterizador da el
+// mismo resultado con cualquier rectángulo de recorte), así que cada imagen
+// es idéntica a la de la ventana con esa cámara, la misma cantidad de hilos
+// o no.
+
+// Una vista del lote. Los ángulos están en radianes; lightDir, en espacio
+// de vista como la luz de la ventana.
+struct BatchPose {
+    float cameraAngleX, cameraAngleY, cameraDistance;
+    float modelRotationY;
+    glm::vec3 lightDir;
+};
+
+// Leer las poses de path, una por línea:
+//
+//     anguloX anguloY distancia rotacion [luzX luzY luzZ]
+//
+// con los ángulos en grados. Sin luz se usa defaultLight. Las líneas
+// vacías y las que empiezan con # se ignoran.
+bool loadBatchPoses(const std::string& path, const glm::vec3& defaultLight, std::vector<BatchPose>& poses) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Error: No se pudo abrir " << path << std::endl;
+        return false;
+    }
+
+    poses.clear();
+    std::string text;
+    int lineNumber = 0;
+    while (std::getline(file, text)) {
+        lineNumber++;
+        size_t start = text.find_first_not_of(" \t\r");
+        if (start == std::string::npos || text[start] == '#') continue;
+
+        std::istringstream line(text);
+        float angleX, angleY, distance, rotation;
+        if (!(line >> angleX >> angleY >> distance >> rotation)) {
+            std::cerr << "Error: " << path << ":" << lineNumber << ": se esperaban anguloX anguloY distancia rotacion"
+                      << std::endl;
+            return false;
+        }
+
+        BatchPose pose;
+        pose.cameraAngleX = glm::radians(angleX);
+        pose.cameraAngleY = glm::radians(angleY);
+        pose.cameraDistance = distance;
+        pose.modelRotationY = glm::radians(rotation);
+        pose.lightDir = defaultLight;
+
+        glm::vec3 light;
+        if (line >> light.x) {
+            if (!(line >> light.y >> light.z) || glm::length(light) == 0.0f) {
+                std::cerr << "Error: " << path << ":" << lineNumber << ": la luz necesita tres componentes no nulas"
+                          << std::endl;
+                return false;
+            }
+            pose.lightDir = glm::normalize(light);
+        }
+        poses.push_back(pose);
+    }
+    return true;
+}
+
+// Matrices de una pose y el nivel de detalle con que se dibuja
+struct BatchView {
+    glm::mat4 mv, projection, viewport;
+    glm::vec3 lightDir;
+    int lod = 0;
+};
+
+// Lo que se dibuja en todas las poses
+struct BatchSettings {
+    ShadingMode shading = ShadingMode::Flat;
+    RenderMode mode = RenderMode::Filled;
+    Color background = Color(10, 10, 15);
+};
+
+// Triángulo de un solo color
+struct BatchTriangle {
+    glm::vec3 v0, v1, v2;
+    Color color;
+};
+
+// Framebuffer y buffers de trabajo de un hilo, reutilizados entre poses
+struct BatchWorker {
+    Framebuffer fb;
+    TransformedVertices vertices;
+    std::vector<uint32_t> visible;
+    std::vector<uint8_t> clipMasks;
+    std::vector<BatchTriangle> triangles;
+    std::vector<ShadedTriangle<GouraudShader>> gouraud;
+    std::vector<ShadedTriangle<PhongShader>> phong;
+    std::vector<float> depths;
+    std::vector<uint32_t> order;
+    DepthSorter sorter;
+    std::vector<ScreenLine> lines;
+    std::vector<Color> staging;     // Imagen fila por fila en la disposición por bloques
+
+    // Contadores acumulados de las poses que dibujó este hilo
+    ClusterCullStats cull;
+    RasterStats raster;
+    uint64_t trianglesDrawn = 0;
+    double renderMs = 0.0;
+
+    // Dibujar una pose en fb (que queda resuelto)
+    void render(const std::vector<LevelGeometry>& levels, const BatchView& view, const BatchSettings& settings) {
+        const LevelGeometry& geometry = levels[view.lod];
+        glm::mat4 mvp = view.projection * view.mv;
+
+        // Cámara y luz en espacio del objeto, como en buildFrame
+        glm::mat3 inverseRotation = glm::transpose(glm::mat3(view.mv));
+        glm::vec3 objectEye = -(inverseRotation * glm::vec3(view.mv[3]));
+        ShadingUniforms uniforms;
+        uniforms.lightDir = glm::normalize(inverseRotation * view.lightDir);
+
+        fb.clear(settings.background);
+        RasterTarget target = framebufferTarget(fb, &raster);
+        RasterRect rect{0, 0, fb.width - 1, fb.height - 1};
+
+        // Descarte y transformación en este mismo hilo: el pool ya está
+        // repartiendo las poses
+        cullClusters(geometry.mesh, extractFrustum(mvp), objectEye, visible, clipMasks, cull);
+        size_t vertexCount = geometry.mesh.positions.size();
+        if (vertices.screen.size() < vertexCount) {
+            vertices.screen.resize(vertexCount);
+            vertices.view.resize(vertexCount);
+        }
+        transformClusterRanges(geometry.mesh, visible, makeVertexTransform(mvp, view.mv, view.viewport), vertices);
+
+        bool depthOnly = settings.mode == RenderMode::Wireframe;
+        switch (depthOnly ? ShadingMode::Flat : settings.shading) {
+            case ShadingMode::Gouraud:
+                drawShaded(geometry, view, objectEye, uniforms, gouraud, rect, target);
+                break;
+            case ShadingMode::Phong:
+                drawShaded(geometry, view, objectEye, uniforms, phong, rect, target);
+                break;
+            default:
+                drawFlat(geometry, view, objectEye, inverseRotation * view.lightDir, depthOnly, rect, target);
+                break;
+        }
+
+        // Aristas probadas contra esa profundidad
+        if (settings.mode != RenderMode::Filled) {
+            const FaceAttributes& attributes = geometry.attributes;
+            assembleClusterLines(geometry.mesh, visible, clipMasks, vertices, view.projection, view.viewport,
+                                 [&](uint32_t face) {
+                return depthOnly ? attributes.baseColor[face] : WIREFRAME_OVERLAY_COLOR;
+            }, lines);
+            for (const ScreenLine& line : lines) {
+                rasterizeLine(line.a, line.b, line.color, rect, target);
+            }
+        }
+        fb.resolve();
+    }
+
+    // Triángulos de un color por cara (o sólo profundidad), de adelante
+    // hacia atrás. objectLight no se normaliza, igual que en shadeTriangles.
+    void drawFlat(const LevelGeometry& geometry, const BatchView& view, const glm::vec3& objectEye,
+                  const glm::vec3& objectLight, bool depthOnly, const RasterRect& rect, const RasterTarget& target) {
+        const FaceAttributes& attributes = geometry.attributes;
+        triangles.clear();
+        depths.clear();
+        assembleClusterTriangles(geometry, visible, clipMasks, vertices, view.projection, view.viewport, objectEye,
+                                 cull, [&](const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2, uint32_t face) {
+            BatchTriangle tri;
+            tri.v0 = v0;
+            tri.v1 = v1;
+            tri.v2 = v2;
+            if (!depthOnly) {
+                float intensity = attributes.normalX[face] * objectLight.x +
+                                  attributes.normalY[face] * objectLight.y +
+                                  attributes.normalZ[face] * objectLight.z;
+                tri.color = shadeColor(attributes.baseColor[face], intensity);
+            }
+            triangles.push_back(tri);
+            depths.push_back((v0.z + v1.z + v2.z) / 3.0f);
+        });
+
+        sorter.sortFrontToBack(depths.data(), depths.size(), order);
+        for (uint32_t i : order) {
+            if (depthOnly) rasterizeTriangleDepth(triangles[i], rect, target);
+            else rasterizeTriangle(triangles[i], rect, target);
+        }
+        trianglesDrawn += triangles.size();
+    }
+
+    // Triángulos con el shader S y las constantes de esta pose
+    template <typename S>
+    void drawShaded(const LevelGeometry& geometry, const BatchView& view, const glm::vec3& objectEye,
+                    const ShadingUniforms& uniforms, std::vector<ShadedTriangle<S>>& out, const RasterRect& rect,
+                    const RasterTarget& target) {
+        out.clear();
+        depths.clear();
+        assembleClusterTriangles(geometry, visible, clipMasks, vertices, view.projection, view.viewport, objectEye,
+                                 cull, [&](const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2, uint32_t face,
+                                           const TriangleCorners& corners) {
+            ShadedTriangle<S> tri;
+            makeShadedTriangle(v0, v1, v2, geometry.attributes.baseColor[face], corners, geometry.normals,
+                               uniforms, tri);
+            out.push_back(tri);
+            depths.push_back((v0.z + v1.z + v2.z) / 3.0f);
+        });
+
+        sorter.sortFrontToBack(depths.data(), depths.size(), order);
+        for (uint32_t i : order) {
+            const ShadedTriangle<S>& tri = out[i];
+            ShaderPixels<S> pixels;
+            if (!pixels.planes.setup(tri.v0, tri.v1, tri.v2, tri.invW, tri.varyings)) continue;
+            pixels.base = tri.color;
+            pixels.uniforms = &uniforms;
+            rasterizeShaded(tri.v0, tri.v1, tri.v2, tri.color, rect, target, pixels);
+        }
+        trianglesDrawn += out.size();
+    }
+};
+
+// Un hilo de trabajo por hilo del pool, con framebuffers como format
+// (disposición, profundidad y borrado) a width x height
+void prepareBatchWorkers(std::vector<BatchWorker>& workers, int count, const Framebuffer& format, int width,
+                         int height) {
+    workers.resize(count);
+    for (BatchWorker& worker : workers) {
+        worker.fb = makeFramebuffer(width, height, format.layout, format.depthFormat);
+        worker.fb.lazyClear = format.lazyClear;
+        worker.cull = ClusterCullStats();
+        worker.raster = RasterStats();
+        worker.trianglesDrawn = 0;
+        worker.renderMs = 0.0;
+    }
+}
+
+// Dibujar todas las vistas repartidas entre los hilos del pool.
+// done(índice, fb, worker) recibe cada imagen terminada desde el hilo que
+// la dibujó, antes de que ese hilo empiece otra.
+template <typename DoneFn>
+void renderBatch(const std::vector<LevelGeometry>& levels, const std::vector<BatchView>& views,
+                 const BatchSettings& settings, std::vector<BatchWorker>& workers, DoneFn done) {
+    renderPool().parallelFor(static_cast<int>(views.size()), [&](int index, int w) {
+        BatchWorker& worker = workers[w];
+        auto start = std::chrono::steady_clock::now();
+        worker.render(levels, views[index], settings);
+        worker.renderMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        done(index, worker.fb, worker);
+    });
+}
@@ -0,0 +1,188 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "color.h"
+
+// Utilidades para medir frames y guardar imágenes sin ventana
+
+// Estadísticas de una serie de tiempos de frame (en milisegundos)
+struct FrameStats {
+    double averageMs = 0.0;
+    double p50Ms = 0.0;
+    double p99Ms = 0.0;
+    double minMs = 0.0;
+    double maxMs = 0.0;
+};
+
+// Percentil por el método del rango más cercano
+double percentile(std::vector<double> sorted, double p) {
+    if (sorted.empty()) return 0.0;
+    std::sort(sorted.begin(), sorted.end());
+    size_t rank = static_cast<size_t>(p / 100.0 * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(rank, sorted.size() - 1)];
+}
+
+FrameStats computeFrameStats(const std::vector<double>& frameMs) {
+    FrameStats stats;
+    if (frameMs.empty()) return stats;
+
+    double total = 0.0;
+    for (double ms : frameMs) total += ms;
+
+    stats.averageMs = total / frameMs.size();
+    stats.p50Ms = percentile(frameMs, 50.0);
+    stats.p99Ms = percentile(frameMs, 99.0);
+    stats.minMs = *std::min_element(frameMs.begin(), frameMs.end());
+    stats.maxMs = *std::max_element(frameMs.begin(), frameMs.end());
+    return stats;
+}
+
+void printFrameStats(const std::vector<double>& frameMs, uint64_t triangles) {
+    FrameStats stats = computeFrameStats(frameMs);
+
+    double totalSeconds = 0.0;
+    for (double ms : frameMs) totalSeconds += ms / 1000.0;
+
+    std::cout << "Frames: " << frameMs.size() << std::endl;
+    std::cout << "Promedio: " << stats.averageMs << " ms (" << 1000.0 / stats.averageMs << " fps)" << std::endl;
+    std::cout << "p50: " << stats.p50Ms << " ms" << std::endl;
+    std::cout << "p99: " << stats.p99Ms << " ms" << std::endl;
+    std::cout << "Min / Max: " << stats.minMs << " / " << stats.maxMs << " ms" << std::endl;
+    std::cout << "Triángulos dibujados: " << triangles << " ("
+              << (totalSeconds > 0.0 ? triangles / totalSeconds / 1e6 : 0.0) << " M/s)" << std::endl;
+}
+
+// ---------------------------------------------------------------------------
+// Escritura de imágenes
+// ---------------------------------------------------------------------------
+
+// PPM binario (P6)
+bool writePPM(const std::string& path, const Color* pixels, int width, int height, int stride) {
+    FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        std::cerr << "Error: No se pudo escribir " << path << std::endl;
+        return false;
+    }
+
+    std::fprintf(file, "P6\n%d %d\n255\n", width, height);
+    std::vector<unsigned char> row(width * 3);
+    for (int y = 0; y < height; y++) {
+        const Color* src = pixels + y * stride;
+        for (int x = 0; x < width; x++) {
+            row[x * 3 + 0] = src[x].r;
+            row[x * 3 + 1] = src[x].g;
+            row[x * 3 + 2] = src[x].b;
+        }
+        std::fwrite(row.data(), 1, row.size(), file);
+    }
+
+    std::fclose(file);
+    return true;
+}
+
+uint32_t crc32(const unsigned char* data, size_t size, uint32_t crc = 0) {
+    static const std::array<uint32_t, 256> table = [] {
+        std::array<uint32_t, 256> t{};
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            t[i] = c;
+        }
+        return t;
+    }();
+
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++) {
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+// PNG RGB de 8 bits sin compresión (bloques "stored" de deflate). No
+// necesita zlib y cualquier visor lo abre.
+bool writePNG(const std::string& path, const Color* pixels, int width, int height, int stride) {
+    // Datos crudos: un byte de filtro (0) por fila seguido de RGB
+    std::vector<unsigned char> raw;
+    raw.reserve(static_cast<size_t>(height) * (width * 3 + 1));
+    for (int y = 0; y < height; y++) {
+        raw.push_back(0);
+        const Color* src = pixels + y * stride;
+        for (int x = 0; x < width; x++) {
+            raw.push_back(src[x].r);
+            raw.push_back(src[x].g);
+            raw.push_back(src[x].b);
+        }
+    }
+
+    // Stream zlib con bloques stored de hasta 65535 bytes
+    std::vector<unsigned char> zlib = {0x78, 0x01};
+    size_t offset = 0;
+    do {
+        size_t size = std::min<size_t>(65535, raw.size() - offset);
+        bool last = offset + size == raw.size();
+        zlib.push_back(last ? 1 : 0);
+        zlib.push_back(size & 0xFF);
+        zlib.push_back((size >> 8) & 0xFF);
+        zlib.push_back(~size & 0xFF);
+        zlib.push_back((~size >> 8) & 0xFF);
+        zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + size);
+        offset += size;
+    } while (offset < raw.size());
+
+    uint32_t a = 1, b = 0;
+    for (unsigned char byte : raw) {
+        a = (a + byte) % 65521;
+        b = (b + a) % 65521;
+    }
+    uint32_t adler = (b << 16) | a;
+    for (int shift = 24; shift >= 0; shift -= 8) {
+        zlib.push_back((adler >> shift) & 0xFF);
+    }
+
+    FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        std::cerr << "Error: No se pudo escribir " << path << std::endl;
+        return false;
+    }
+
+    auto put32 = [](std::vector<unsigned char>& out, uint32_t value) {
+        for (int shift = 24; shift >= 0; shift -= 8) out.push_back((value >> shift) & 0xFF);
+    };
+    auto writeChunk = [&](const char* type, const std::vector<unsigned char>& data) {
+        std::vector<unsigned char> chunk;
+        put32(chunk, static_cast<uint32_t>(data.size()));
+        chunk.insert(chunk.end(), type, type + 4);
+        chunk.insert(chunk.end(), data.begin(), data.end());
+        put32(chunk, crc32(chunk.data() + 4, chunk.size() - 4));
+        std::fwrite(chunk.data(), 1, chunk.size(), file);
+    };
+
+    const unsigned char signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    std::fwrite(signature, 1, sizeof(signature), file);
+
+    std::vector<unsigned char> header;
+    put32(header, static_cast<uint32_t>(width));
+    put32(header, static_cast<uint32_t>(height));
+    header.insert(header.end(), {8, 2, 0, 0, 0});   // 8 bits, RGB
+    writeChunk("IHDR", header);
+    writeChunk("IDAT", zlib);
+    writeChunk("IEND", {});
+
+    std::fclose(file);
+    return true;
+}
+
+// Elegir el formato por la extensión del archivo (.png o .ppm)
+bool writeImage(const std::string& path, const Color* pixels, int width, int height, int stride) {
+    if (path.size() >= 4 && path.compare(path.size() - 4, 4, ".png") == 0) {
+        return writePNG(path, pixels, width, height, stride);
+    }
+    return writePPM(path, pixels, width, height, stride);
+}
@@ -0,0 +1,391 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include "objloader.h"
+#include "vertexstage.h"
+
+// Jerarquía de cajas (BVH) sobre primitivas con caja: las caras de un
+// nivel (para elegir con el mouse) o sus clusters (para descartar por
+// frustum subárboles enteros).
+//
+// Se construye al cargar con la heurística de área (SAH) evaluada en
+// BVH_SAH_BINS particiones por eje, y se guarda aplanada: nodos de 32
+// bytes en un solo arreglo, los dos hijos de un nodo juntos (el derecho
+// sigue al izquierdo) y las primitivas de cada hoja contiguas en
+// primitives. Los hermanos empiezan en índices pares, así que con el
+// arreglo alineado un par comparte una línea de caché.
+//
+// El recorrido es en profundidad y de izquierda a derecha, así que cada
+// subárbol cubre un rango contiguo de primitives.
+
+const int BVH_SAH_BINS = 16;
+
+// Costo de recorrer un nodo, relativo a probar una primitiva
+const float BVH_TRAVERSAL_COST = 1.0f;
+
+// Profundidad máxima: la pila del recorrido es de este tamaño
+const int BVH_MAX_DEPTH = 64;
+
+// Caras por hoja como máximo en el árbol de caras
+const int BVH_FACE_LEAF_SIZE = 4;
+
+struct BVHBox {
+    glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+    glm::vec3 max = glm::vec3(-std::numeric_limits<float>::max());
+
+    void grow(const glm::vec3& p) {
+        min = glm::min(min, p);
+        max = glm::max(max, p);
+    }
+
+    void grow(const BVHBox& box) {
+        min = glm::min(min, box.min);
+        max = glm::max(max, box.max);
+    }
+
+    // Media área de la superficie (la SAH sólo usa proporciones)
+    float area() const {
+        glm::vec3 e = max - min;
+        return e.x < 0.0f ? 0.0f : e.x * e.y + e.y * e.z + e.z * e.x;
+    }
+
+    glm::vec3 center() const {
+        return (min + max) * 0.5f;
+    }
+};
+
+struct alignas(32) BVHNode {
+    glm::vec3 boundsMin;
+    uint32_t first;         // Hoja: primera primitiva; interior: hijo izquierdo (el derecho es first + 1)
+    glm::vec3 boundsMax;
+    uint32_t count;         // Primitivas de la hoja; 0 = nodo interior
+
+    bool leaf() const {
+        return count > 0;
+    }
+};
+
+struct BVH {
+    std::vector<BVHNode> nodes;         // nodes[0] es la raíz; nodes[1] no se usa
+    std::vector<uint32_t> primitives;   // Índices de las primitivas, por hoja
+    int depth = 0;
+    int leaves = 0;
+
+    bool empty() const {
+        return nodes.empty();
+    }
+
+    // Rango [begin, end) de primitives debajo de un nodo: de la primera
+    // hoja de su rama izquierda a la última de la derecha
+    void subtreeRange(uint32_t node, uint32_t& begin, uint32_t& end) const {
+        uint32_t left = node;
+        while (!nodes[left].leaf()) left = nodes[left].first;
+        uint32_t right = node;
+        while (!nodes[right].leaf()) right = nodes[right].first + 1;
+        begin = nodes[left].first;
+        end = nodes[right].first + nodes[right].count;
+    }
+
+    // Costo SAH del árbol (primitivas probadas por rayo, en promedio sobre
+    // rayos que cruzan la raíz), para comparar construcciones
+    float sahCost() const {
+        if (nodes.empty()) return 0.0f;
+        BVHBox root;
+        root.min = nodes[0].boundsMin;
+        root.max = nodes[0].boundsMax;
+        float rootArea = std::max(root.area(), std::numeric_limits<float>::min());
+        float cost = 0.0f;
+        for (size_t i = 0; i < nodes.size(); i++) {
+            if (i == 1) continue;
+            BVHBox box;
+            box.min = nodes[i].boundsMin;
+            box.max = nodes[i].boundsMax;
+            float weight = box.area() / rootArea;
+            cost += weight * (nodes[i].leaf() ? static_cast<float>(nodes[i].count) : BVH_TRAVERSAL_COST);
+        }
+        return cost;
+    }
+};
+
+// Construir el árbol sobre boxes. Una hoja tiene a lo sumo maxLeafSize
+// primitivas salvo que estén todas en el mismo punto (o se llegue a
+// BVH_MAX_DEPTH); con menos se parte sólo si la SAH dice que conviene.
+void buildBVH(const std::vector<BVHBox>& boxes, int maxLeafSize, BVH& out) {
+    out.nodes.clear();
+    out.primitives.resize(boxes.size());
+    out.depth = 0;
+    out.leaves = 0;
+    if (boxes.empty()) return;
+
+    std::vector<glm::vec3> centers(boxes.size());
+    for (size_t i = 0; i < boxes.size(); i++) {
+        out.primitives[i] = static_cast<uint32_t>(i);
+        centers[i] = boxes[i].center();
+    }
+
+    out.nodes.reserve(boxes.size() * 2 / std::max(1, maxLeafSize / 2) + 2);
+    out.nodes.resize(2);
+    out.nodes[0].first = 0;
+    out.nodes[0].count = static_cast<uint32_t>(boxes.size());
+
+    struct Pending {
+        uint32_t node;
+        int depth;
+    };
+    std::vector<Pending> pending = {{0, 1}};
+    uint32_t* primitives = out.primitives.data();
+
+    while (!pending.empty()) {
+        Pending task = pending.back();
+        pending.pop_back();
+        uint32_t first = out.nodes[task.node].first;
+        uint32_t count = out.nodes[task.node].count;
+        out.depth = std::max(out.depth, task.depth);
+
+        BVHBox bounds, centroids;
+        for (uint32_t i = first; i < first + count; i++) {
+            bounds.grow(boxes[primitives[i]]);
+            centroids.grow(centers[primitives[i]]);
+        }
+        out.nodes[task.node].boundsMin = bounds.min;
+        out.nodes[task.node].boundsMax = bounds.max;
+
+        // La mejor partición entre los bordes de las cajas de los centros
+        float leafCost = static_cast<float>(count);
+        float area = std::max(bounds.area(), std::numeric_limits<float>::min());
+        float bestCost = std::numeric_limits<float>::max();
+        int bestAxis = -1;
+        int bestSplit = 0;
+        glm::vec3 extent = centroids.max - centroids.min;
+        if (count > 1) {
+            for (int axis = 0; axis < 3; axis++) {
+                if (!(extent[axis] > 0.0f)) continue;
+                BVHBox binBounds[BVH_SAH_BINS];
+                uint32_t binCounts[BVH_SAH_BINS] = {};
+                float scale = BVH_SAH_BINS / extent[axis];
+                for (uint32_t i = first; i < first + count; i++) {
+                    uint32_t p = primitives[i];
+                    int bin = std::min(BVH_SAH_BINS - 1, static_cast<int>((centers[p][axis] - centroids.min[axis]) * scale));
+                    binCounts[bin]++;
+                    binBounds[bin].grow(boxes[p]);
+                }
+
+                // Áreas y cantidades a la izquierda de cada corte, y luego a la derecha
+                float leftArea[BVH_SAH_BINS - 1];
+                uint32_t leftCount[BVH_SAH_BINS - 1];
+                BVHBox sweep;
+                uint32_t sweepCount = 0;
+                for (int b = 0; b < BVH_SAH_BINS - 1; b++) {
+                    sweep.grow(binBounds[b]);
+                    sweepCount += binCounts[b];
+                    leftArea[b] = sweep.area();
+                    leftCount[b] = sweepCount;
+                }
+                sweep = BVHBox();
+                sweepCount = 0;
+                for (int b = BVH_SAH_BINS - 1; b > 0; b--) {
+                    sweep.grow(binBounds[b]);
+                    sweepCount += binCounts[b];
+                    if (leftCount[b - 1] == 0 || sweepCount == 0) continue;
+                    float cost = BVH_TRAVERSAL_COST +
+                                 (leftArea[b - 1] * leftCount[b - 1] + sweep.area() * sweepCount) / area;
+                    if (cost < bestCost) {
+                        bestCost = cost;
+                        bestAxis = axis;
+                        bestSplit = b;
+                    }
+                }
+            }
+        }
+
+        // Sin corte posible (todos los centros en el mismo punto) queda hoja
+        bool mustSplit = count > static_cast<uint32_t>(maxLeafSize);
+        if (task.depth >= BVH_MAX_DEPTH || bestAxis < 0 || (!mustSplit && bestCost >= leafCost)) {
+            out.leaves++;
+            continue;
+        }
+
+        // Partir en su lugar
+        float scale = BVH_SAH_BINS / extent[bestAxis];
+        float minimum = centroids.min[bestAxis];
+        uint32_t* split = std::partition(primitives + first, primitives + first + count, [&](uint32_t p) {
+            int bin = std::min(BVH_SAH_BINS - 1, static_cast<int>((centers[p][bestAxis] - minimum) * scale));
+            return bin < bestSplit;
+        });
+        uint32_t middle = static_cast<uint32_t>(split - primitives);
+
+        uint32_t left = static_cast<uint32_t>(out.nodes.size());
+        out.nodes.resize(left + 2);
+        out.nodes[left].first = first;
+        out.nodes[left].count = middle - first;
+        out.nodes[left + 1].first = middle;
+        out.nodes[left + 1].count = first + count - middle;
+        out.nodes[task.node].first = left;
+        out.nodes[task.node].count = 0;
+
+        // El izquierdo se procesa primero; el orden no cambia el árbol
+        pending.push_back({left + 1, task.depth + 1});
+        pending.push_back({left, task.depth + 1});
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Rayos
+// ---------------------------------------------------------------------------
+
+struct BVHRay {
+    glm::vec3 origin;
+    glm::vec3 direction;        // Unitaria
+    glm::vec3 inverse;          // 1 / direction por componente
+};
+
+inline BVHRay makeRay(const glm::vec3& origin, const glm::vec3& direction) {
+    BVHRay ray;
+    ray.origin = origin;
+    ray.direction = glm::normalize(direction);
+    ray.inverse = 1.0f / ray.direction;
+    return ray;
+}
+
+// Rayo desde el plano cercano por el píxel (x, y). inverseScreen es la
+// inversa de viewport * projection * mv: el rayo queda en espacio del objeto.
+inline BVHRay rayThroughPixel(const glm::mat4& inverseScreen, float x, float y) {
+    glm::vec4 nearPoint = inverseScreen * glm::vec4(x, y, -1.0f, 1.0f);
+    glm::vec4 farPoint = inverseScreen * glm::vec4(x, y, 1.0f, 1.0f);
+    glm::vec3 origin = glm::vec3(nearPoint) / nearPoint.w;
+    return makeRay(origin, glm::vec3(farPoint) / farPoint.w - origin);
+}
+
+// Distancia a la que el rayo entra a la caja, o infinito si no la cruza
+// antes de tMax (prueba de placas). Los recorridos visitan una caja si
+// esta distancia es menor que la del impacto más cercano hasta ahora.
+inline float rayBoxDistance(const BVHRay& ray, const glm::vec3& boxMin, const glm::vec3& boxMax, float tMax) {
+    glm::vec3 t0 = (boxMin - ray.origin) * ray.inverse;
+    glm::vec3 t1 = (boxMax - ray.origin) * ray.inverse;
+    glm::vec3 nearT = glm::min(t0, t1);
+    glm::vec3 farT = glm::max(t0, t1);
+    float enter = std::max(std::max(nearT.x, nearT.y), std::max(nearT.z, 0.0f));
+    float exit = std::min(std::min(farT.x, farT.y), std::min(farT.z, tMax));
+    return enter <= exit ? enter : std::numeric_limits<float>::infinity();
+}
+
+// Visitar las hojas que cruza el rayo, la más cercana primero.
+// hit(primitiva, tMax) prueba una primitiva y acorta tMax si la alcanza.
+// Devuelve los nodos visitados.
+template <typename HitFn>
+int traceBVH(const BVH& bvh, const BVHRay& ray, float& tMax, HitFn hit) {
+    if (bvh.empty() || !(rayBoxDistance(ray, bvh.nodes[0].boundsMin, bvh.nodes[0].boundsMax, tMax) < tMax)) return 0;
+
+    uint32_t stack[BVH_MAX_DEPTH + 1];
+    int top = 0;
+    int visited = 0;
+    uint32_t node = 0;
+    while (true) {
+        const BVHNode& current = bvh.nodes[node];
+        visited++;
+        if (current.leaf()) {
+            for (uint32_t i = current.first; i < current.first + current.count; i++) {
+                hit(bvh.primitives[i], tMax);
+            }
+        } else {
+            // Los dos hijos están juntos: primero el más cercano
+            uint32_t near = current.first;
+            uint32_t far = current.first + 1;
+            float nearT = rayBoxDistance(ray, bvh.nodes[near].boundsMin, bvh.nodes[near].boundsMax, tMax);
+            float farT = rayBoxDistance(ray, bvh.nodes[far].boundsMin, bvh.nodes[far].boundsMax, tMax);
+            if (farT < nearT) {
+                std::swap(near, far);
+                std::swap(nearT, farT);
+            }
+            if (nearT < tMax) {
+                if (farT < tMax) stack[top++] = far;
+                node = near;
+                continue;
+            }
+        }
+
+        // Siguiente nodo pendiente que todavía puede estar antes del impacto
+        bool found = false;
+        while (top > 0 && !found) {
+            node = stack[--top];
+            found = rayBoxDistance(ray, bvh.nodes[node].boundsMin, bvh.nodes[node].boundsMax, tMax) < tMax;
+        }
+        if (!found) break;
+    }
+    return visited;
+}
+
+// Distancia a la que el rayo cruza el triángulo de frente (la misma
+// orientación que no descarta el dibujo), o infinito (Möller-Trumbore)
+inline float rayTriangleDistance(const BVHRay& ray, const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2) {
+    const float none = std::numeric_limits<float>::infinity();
+    glm::vec3 e1 = p1 - p0;
+    glm::vec3 e2 = p2 - p0;
+    glm::vec3 p = glm::cross(ray.direction, e2);
+    float det = glm::dot(e1, p);
+    if (!(det > 0.0f)) return none;
+
+    glm::vec3 s = ray.origin - p0;
+    float u = glm::dot(s, p);
+    if (u < 0.0f || u > det) return none;
+    glm::vec3 q = glm::cross(s, e1);
+    float v = glm::dot(ray.direction, q);
+    if (v < 0.0f || u + v > det) return none;
+    float t = glm::dot(e2, q) / det;
+    return t >= 0.0f ? t : none;
+}
+
+// ---------------------------------------------------------------------------
+// Caras
+// ---------------------------------------------------------------------------
+
+void buildFaceBVH(const VertexStreams& positions, const std::vector<Face>& faces, BVH& out) {
+    std::vector<BVHBox> boxes(faces.size());
+    for (size_t f = 0; f < faces.size(); f++) {
+        for (int index : faces[f].vertexIndices) boxes[f].grow(positions.get(index));
+    }
+    buildBVH(boxes, BVH_FACE_LEAF_SIZE, out);
+}
+
+// Resultado de elegir una cara con un rayo
+struct FacePickResult {
+    int face = -1;              // -1 = ninguna
+    float distance = std::numeric_limits<float>::infinity();
+    int nodes = 0;              // Nodos visitados
+    int triangles = 0;          // Triángulos probados
+};
+
+// La cara de frente más cercana que cruza el rayo
+FacePickResult pickFace(const BVH& bvh, const VertexStreams& positions, const std::vector<Face>& faces,
+                        const BVHRay& ray) {
+    FacePickResult result;
+    result.nodes = traceBVH(bvh, ray, result.distance, [&](uint32_t face, float& tMax) {
+        const auto& idx = faces[face].vertexIndices;
+        float t = rayTriangleDistance(ray, positions.get(idx[0]), positions.get(idx[1]), positions.get(idx[2]));
+        result.triangles++;
+        if (t < tMax) {
+            tMax = t;
+            result.face = static_cast<int>(face);
+        }
+    });
+    return result;
+}
+
+// Lo mismo probando todas las caras (referencia para medir y verificar)
+FacePickResult pickFaceLinear(const VertexStreams& positions, const std::vector<Face>& faces, const BVHRay& ray) {
+    FacePickResult result;
+    for (size_t f = 0; f < faces.size(); f++) {
+        const auto& idx = faces[f].vertexIndices;
+        float t = rayTriangleDistance(ray, positions.get(idx[0]), positions.get(idx[1]), positions.get(idx[2]));
+        if (t < result.distance) {
+            result.distance = t;
+            result.face = static_cast<int>(f);
+        }
+    }
+    result.triangles = static_cast<int>(faces.size());
+    return result;
+}
@@ -0,0 +1,129 @@
+#pragma once
+#include <glm/glm.hpp>
+#include "framebuffer.h"
+
+// Recorte en espacio de clip.
+//
+// Sólo el plano cercano se recorta siempre que hace falta: un vértice con
+// w <= 0 no tiene proyección válida. Contra los planos laterales se confía
+// en una banda de guarda: el rasterizador ya recorta cada triángulo a su
+// tile, así que los que se salen un poco de la pantalla no cuestan nada
+// extra. Sólo se recortan contra la banda los (muy raros) triángulos que
+// llegan más allá de CLIP_GUARD_BAND píxeles, para que sus coordenadas
+// sigan cabiendo en el punto fijo del rasterizador.
+
+// Píxeles de banda de guarda más allá de cada borde de la pantalla
+const float CLIP_GUARD_BAND = 8192.0f;
+
+// Un triángulo recortado contra 5 planos tiene a lo sumo 8 vértices
+const int CLIP_MAX_VERTICES = 8;
+
+enum ClipPlane {
+    CLIP_NEAR = 1,
+    CLIP_GUARD_LEFT = 2,
+    CLIP_GUARD_RIGHT = 4,
+    CLIP_GUARD_BOTTOM = 8,
+    CLIP_GUARD_TOP = 16
+};
+
+const int CLIP_PLANE_COUNT = 5;
+
+// Coeficientes de los planos en espacio de clip: un vértice v está adentro
+// si dot(plane, v) >= 0
+struct ClipPlanes {
+    glm::vec4 planes[CLIP_PLANE_COUNT];
+};
+
+ClipPlanes makeClipPlanes() {
+    // La banda en NDC: la pantalla ocupa [-1, 1], la banda la extiende.
+    // Se mide con el tamaño de la ventana: a menor resolución interna la
+    // misma banda en NDC son menos píxeles, así que sigue cabiendo.
+    float guardX = 1.0f + 2.0f * CLIP_GUARD_BAND / SCREEN_WIDTH;
+    float guardY = 1.0f + 2.0f * CLIP_GUARD_BAND / SCREEN_HEIGHT;
+
+    ClipPlanes p;
+    p.planes[0] = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);       // z >= -w
+    p.planes[1] = glm::vec4(1.0f, 0.0f, 0.0f, guardX);     // x >= -guardX * w
+    p.planes[2] = glm::vec4(-1.0f, 0.0f, 0.0f, guardX);    // x <= guardX * w
+    p.planes[3] = glm::vec4(0.0f, 1.0f, 0.0f, guardY);
+    p.planes[4] = glm::vec4(0.0f, -1.0f, 0.0f, guardY);
+    return p;
+}
+
+const ClipPlanes clipPlanes = makeClipPlanes();
+
+// Bits de los planos que el vértice tiene afuera
+inline int clipOutcode(const glm::vec4& v) {
+    int code = 0;
+    for (int i = 0; i < CLIP_PLANE_COUNT; i++) {
+        if (glm::dot(clipPlanes.planes[i], v) < 0.0f) code |= 1 << i;
+    }
+    return code;
+}
+
+// Recortar un triángulo (Sutherland-Hodgman) contra los planos de
+// planeMask. Devuelve el número de vértices del polígono resultante (0 si
+// quedó afuera). weights recibe los pesos de cada vértice del polígono sobre
+// los tres vértices de entrada, para interpolar sus atributos.
+int clipTriangle(const glm::vec4 in[3], int planeMask, glm::vec4 out[CLIP_MAX_VERTICES],
+                 glm::vec3 weights[CLIP_MAX_VERTICES]) {
+    glm::vec4 buffer[2][CLIP_MAX_VERTICES];
+    glm::vec3 weightBuffer[2][CLIP_MAX_VERTICES];
+    int count = 3;
+    for (int k = 0; k < 3; k++) {
+        buffer[0][k] = in[k];
+        weightBuffer[0][k] = glm::vec3(0.0f);
+        weightBuffer[0][k][k] = 1.0f;
+    }
+
+    int current = 0;
+    for (int i = 0; i < CLIP_PLANE_COUNT && count > 0; i++) {
+        if (!(planeMask & (1 << i))) continue;
+
+        const glm::vec4& plane = clipPlanes.planes[i];
+        const glm::vec4* src = buffer[current];
+        const glm::vec3* srcWeights = weightBuffer[current];
+        glm::vec4* dst = buffer[current ^ 1];
+        glm::vec3* dstWeights = weightBuffer[current ^ 1];
+        int written = 0;
+
+        for (int k = 0; k < count; k++) {
+            int next = (k + 1) % count;
+            const glm::vec4& a = src[k];
+            const glm::vec4& b = src[next];
+            float da = glm::dot(plane, a);
+            float db = glm::dot(plane, b);
+
+            if (da >= 0.0f) {
+                dstWeights[written] = srcWeights[k];
+                dst[written++] = a;
+            }
+            if ((da >= 0.0f) != (db >= 0.0f)) {
+                // Intersección siempre calculada desde el vértice de adentro
+                // para que aristas compartidas den el mismo punto
+                float t = da >= 0.0f ? da / (da - db) : db / (db - da);
+                int from = da >= 0.0f ? k : next;
+                int to = da >= 0.0f ? next : k;
+                dstWeights[written] = srcWeights[from] + (srcWeights[to] - srcWeights[from]) * t;
+                dst[written++] = src[from] + (src[to] - src[from]) * t;
+            }
+        }
+
+        count = written;
+        current ^= 1;
+    }
+
+    for (int k = 0; k < count; k++) {
+        out[k] = buffer[current][k];
+        weights[k] = weightBuffer[current][k];
+    }
+    return count;
+}
+
+// Dividir por w y llevar a pantalla con la matriz de viewport
+inline glm::vec3 clipToScreen(const glm::vec4& v, const glm::mat4& viewport) {
+    float invW = 1.0f / v.w;
+    return glm::vec3(viewport[0][0] * (v.x * invW) + viewport[3][0],
+                     viewport[1][1] * (v.y * invW) + viewport[3][1],
+                     v.z * invW);
+}
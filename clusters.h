@@ -0,0 +1,678 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+#include "bvh.h"
+#include "clipping.h"
+#include "faceattribs.h"
+#include "objloader.h"
+#include "threadpool.h"
+#include "vertexstage.h"
+
+// Clusters (meshlets): la malla se parte al cargar en grupos de hasta
+// CLUSTER_MAX_TRIANGLES caras vecinas. Cada cluster guarda una esfera que lo
+// contiene y un cono con la dirección de sus normales, así que en cada
+// frame se pueden descartar clusters enteros fuera del frustum o vistos por
+// detrás antes de transformar un solo vértice.
+//
+// Cada cluster tiene su propia copia contigua de los vértices que usa; los
+// vértices de los clusters visibles se transforman por rangos con los
+// mismos núcleos de la etapa de vértices. También guarda sus aristas sin
+// repetir, para dibujar la malla de alambre.
+//
+// Los clusters quedan en el orden de las hojas de un BVH sobre sus cajas:
+// el descarte recorre el árbol y acepta o descarta subárboles enteros, que
+// son rangos contiguos de clusters.
+
+const int CLUSTER_MAX_TRIANGLES = 128;
+const int CLUSTER_MAX_VERTICES = 128;
+
+// Clusters por hoja del BVH de clusters, como máximo
+const int CLUSTER_BVH_LEAF_SIZE = 4;
+
+// Clusters visibles que procesa cada tarea al transformar en paralelo
+const int CLUSTER_TRANSFORM_BATCH = 64;
+
+struct Cluster {
+    uint32_t faceBegin, faceCount;
+    uint32_t vertexBegin, vertexCount;
+    uint32_t edgeBegin, edgeCount;
+    glm::vec3 center;           // Esfera envolvente
+    float radius;
+    glm::vec3 coneAxis;         // Normal promedio
+    float coneCutoff;           // Seno de la apertura del cono; >= 1 = no descartable
+};
+
+// Arista de un cluster: sus dos vértices (índices en positions) y una cara
+// que la usa
+struct ClusterEdge {
+    uint32_t v0, v1;
+    uint32_t face;
+};
+
+struct ClusteredMesh {
+    VertexStreams positions;        // Vértices de cada cluster, contiguos
+    std::vector<uint32_t> sourceVertices;   // Índice de cada uno en la malla de entrada
+    std::vector<Face> faces;        // Índices en positions, agrupadas por cluster
+    std::vector<ClusterEdge> edges; // Aristas únicas de cada cluster, agrupadas por cluster
+    std::vector<Cluster> clusters;
+    BVH tree;                       // Sobre las cajas de los clusters; primitives es la identidad
+};
+
+// Geometría de un nivel de detalle lista para dibujar: clusters y
+// atributos de sus caras (en el orden de las caras de los clusters)
+struct LevelGeometry {
+    ClusteredMesh mesh;
+    FaceAttributes attributes;
+    VertexStreams normals;          // Normal suavizada de cada vértice de los clusters
+    BVH faceTree;                   // Sobre las caras de mesh, para elegir con el mouse
+};
+
+// Contadores de descarte de un frame
+struct ClusterCullStats {
+    uint64_t clusters = 0;
+    uint64_t frustumClusters = 0;       // Clusters fuera del frustum
+    uint64_t coneClusters = 0;          // Clusters vistos completamente por detrás
+    uint64_t triangles = 0;
+    uint64_t frustumTriangles = 0;
+    uint64_t coneTriangles = 0;
+    uint64_t backfaceTriangles = 0;     // Descartados uno a uno en clusters visibles
+    uint64_t clipTested = 0;            // Triángulos en clusters que cruzan un plano de recorte
+    uint64_t clipped = 0;               // Triángulos que hubo que recortar
+    uint64_t clipRejected = 0;          // Recortados que quedaron sin área visible
+
+    void add(const ClusterCullStats& other) {
+        clusters += other.clusters;
+        frustumClusters += other.frustumClusters;
+        coneClusters += other.coneClusters;
+        triangles += other.triangles;
+        frustumTriangles += other.frustumTriangles;
+        coneTriangles += other.coneTriangles;
+        backfaceTriangles += other.backfaceTriangles;
+        clipTested += other.clipTested;
+        clipped += other.clipped;
+        clipRejected += other.clipRejected;
+    }
+};
+
+// Cerrar un cluster: calcular esfera y cono
+void finishCluster(const VertexStreams& positions, const std::vector<Face>& faces, Cluster& cluster) {
+    glm::vec3 center(0.0f);
+    for (uint32_t v = 0; v < cluster.vertexCount; v++) {
+        center += positions.get(cluster.vertexBegin + v);
+    }
+    center /= static_cast<float>(std::max(1u, cluster.vertexCount));
+
+    float radius = 0.0f;
+    for (uint32_t v = 0; v < cluster.vertexCount; v++) {
+        radius = std::max(radius, glm::length(positions.get(cluster.vertexBegin + v) - center));
+    }
+    cluster.center = center;
+    cluster.radius = radius;
+
+    // Eje del cono: promedio de las normales unitarias de las caras
+    std::vector<glm::vec3> normals;
+    normals.reserve(cluster.faceCount);
+    glm::vec3 axis(0.0f);
+    for (uint32_t f = cluster.faceBegin; f < cluster.faceBegin + cluster.faceCount; f++) {
+        const auto& idx = faces[f].vertexIndices;
+        glm::vec3 p0 = positions.get(idx[0]);
+        glm::vec3 normal = glm::cross(positions.get(idx[1]) - p0, positions.get(idx[2]) - p0);
+        float length = glm::length(normal);
+        if (length <= 0.0f) continue;     // Sin área: nunca se dibuja, no limita el cono
+        normal /= length;
+        normals.push_back(normal);
+        axis += normal;
+    }
+
+    cluster.coneAxis = glm::vec3(0.0f);
+    cluster.coneCutoff = 1.0f;
+    float axisLength = glm::length(axis);
+    if (normals.empty() || axisLength <= 0.0f) return;
+    axis /= axisLength;
+
+    float minDot = 1.0f;
+    for (const glm::vec3& normal : normals) {
+        minDot = std::min(minDot, glm::dot(normal, axis));
+    }
+
+    // Con normales a más de ~84 grados del eje el cono no sirve para descartar
+    if (minDot <= 0.1f) return;
+    cluster.coneAxis = axis;
+    cluster.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+}
+
+// Agregar las aristas del cluster sin repetir las que comparten dos de sus
+// caras. Una arista en el borde entre dos clusters queda en los dos, así
+// que al descartar un cluster no se pierde ninguna arista de los visibles.
+void finishClusterEdges(const std::vector<Face>& faces, std::vector<ClusterEdge>& edges, Cluster& cluster) {
+    // Clave: los dos índices locales ordenados (< CLUSTER_MAX_VERTICES) y
+    // la cara en los 32 bits bajos, así el orden deja primero la de menor
+    // índice
+    std::vector<uint64_t> keys;
+    keys.reserve(cluster.faceCount * 3);
+    for (uint32_t f = cluster.faceBegin; f < cluster.faceBegin + cluster.faceCount; f++) {
+        const auto& idx = faces[f].vertexIndices;
+        for (int k = 0; k < 3; k++) {
+            uint32_t a = static_cast<uint32_t>(idx[k]) - cluster.vertexBegin;
+            uint32_t b = static_cast<uint32_t>(idx[(k + 1) % 3]) - cluster.vertexBegin;
+            uint64_t pair = std::min(a, b) * CLUSTER_MAX_VERTICES + std::max(a, b);
+            keys.push_back((pair << 32) | f);
+        }
+    }
+    std::sort(keys.begin(), keys.end());
+
+    cluster.edgeBegin = static_cast<uint32_t>(edges.size());
+    for (size_t i = 0; i < keys.size(); i++) {
+        uint64_t pair = keys[i] >> 32;
+        if (i > 0 && (keys[i - 1] >> 32) == pair) continue;
+        ClusterEdge edge;
+        edge.v0 = cluster.vertexBegin + static_cast<uint32_t>(pair / CLUSTER_MAX_VERTICES);
+        edge.v1 = cluster.vertexBegin + static_cast<uint32_t>(pair % CLUSTER_MAX_VERTICES);
+        edge.face = static_cast<uint32_t>(keys[i]);
+        edges.push_back(edge);
+    }
+    cluster.edgeCount = static_cast<uint32_t>(edges.size()) - cluster.edgeBegin;
+}
+
+// Armar el BVH de los clusters y reordenarlos como sus hojas. Las caras,
+// vértices y aristas no se mueven: cada cluster las sigue nombrando por
+// rango.
+void buildClusterBVH(ClusteredMesh& mesh) {
+    std::vector<BVHBox> boxes(mesh.clusters.size());
+    for (size_t c = 0; c < mesh.clusters.size(); c++) {
+        const Cluster& cluster = mesh.clusters[c];
+        for (uint32_t v = cluster.vertexBegin; v < cluster.vertexBegin + cluster.vertexCount; v++) {
+            boxes[c].grow(mesh.positions.get(v));
+        }
+    }
+    buildBVH(boxes, CLUSTER_BVH_LEAF_SIZE, mesh.tree);
+
+    std::vector<Cluster> ordered(mesh.clusters.size());
+    for (size_t i = 0; i < ordered.size(); i++) {
+        ordered[i] = mesh.clusters[mesh.tree.primitives[i]];
+        mesh.tree.primitives[i] = static_cast<uint32_t>(i);
+    }
+    mesh.clusters.swap(ordered);
+}
+
+// Partir la malla en clusters creciendo cada uno desde una cara semilla
+// por caras vecinas, prefiriendo las que agregan menos vértices nuevos y
+// luego las más cercanas a la semilla
+void buildClusters(const VertexStreams& vertices, const std::vector<Face>& faces, ClusteredMesh& out) {
+    out.positions.resize(0);
+    out.sourceVertices.clear();
+    out.faces.clear();
+    out.edges.clear();
+    out.clusters.clear();
+
+    size_t vertexCount = vertices.size();
+    std::vector<std::vector<uint32_t>> vertexFaces(vertexCount);
+    for (size_t f = 0; f < faces.size(); f++) {
+        for (int index : faces[f].vertexIndices) {
+            vertexFaces[index].push_back(static_cast<uint32_t>(f));
+        }
+    }
+
+    std::vector<uint8_t> assigned(faces.size(), 0);
+    std::vector<int> localIndex(vertexCount, -1);
+    std::vector<int> clusterVertices;
+    std::vector<uint32_t> candidates;
+    std::vector<glm::vec3> faceCenters(faces.size());
+    for (size_t f = 0; f < faces.size(); f++) {
+        const auto& idx = faces[f].vertexIndices;
+        glm::vec3 p0 = vertices.get(idx[0]);
+        glm::vec3 p1 = vertices.get(idx[1]);
+        glm::vec3 p2 = vertices.get(idx[2]);
+        faceCenters[f] = (p0 + p1 + p2) / 3.0f;
+
+        // Las caras sin área nunca cubren un píxel: no entran a ningún cluster
+        glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+        if (normal.x == 0.0f && normal.y == 0.0f && normal.z == 0.0f) assigned[f] = 1;
+    }
+
+    out.faces.reserve(faces.size());
+
+    for (size_t seed = 0; seed < faces.size(); seed++) {
+        if (assigned[seed]) continue;
+
+        Cluster cluster = {};
+        cluster.faceBegin = static_cast<uint32_t>(out.faces.size());
+        cluster.vertexBegin = static_cast<uint32_t>(out.positions.size());
+        clusterVertices.clear();
+        candidates.clear();
+        glm::vec3 seedCenter = faceCenters[seed];
+
+        uint32_t next = static_cast<uint32_t>(seed);
+        while (true) {
+            // Agregar la cara elegida con índices en la copia del cluster
+            assigned[next] = 1;
+            Face local;
+            for (int k = 0; k < 3; k++) {
+                int index = faces[next].vertexIndices[k];
+                if (localIndex[index] < 0) {
+                    localIndex[index] = static_cast<int>(clusterVertices.size());
+                    clusterVertices.push_back(index);
+                    for (uint32_t neighbor : vertexFaces[index]) {
+                        if (!assigned[neighbor]) candidates.push_back(neighbor);
+                    }
+                }
+                local.vertexIndices[k] = static_cast<int>(cluster.vertexBegin) + localIndex[index];
+            }
+            out.faces.push_back(local);
+            cluster.faceCount++;
+            if (cluster.faceCount >= static_cast<uint32_t>(CLUSTER_MAX_TRIANGLES)) break;
+
+            // Elegir la siguiente cara entre las vecinas sin asignar
+            int bestNew = 4;
+            float bestDistance = 0.0f;
+            size_t kept = 0;
+            for (size_t c = 0; c < candidates.size(); c++) {
+                uint32_t f = candidates[c];
+                if (assigned[f]) continue;
+                candidates[kept++] = f;
+
+                int newVertices = 0;
+                for (int index : faces[f].vertexIndices) {
+                    if (localIndex[index] < 0) newVertices++;
+                }
+                if (clusterVertices.size() + newVertices > static_cast<size_t>(CLUSTER_MAX_VERTICES)) continue;
+
+                glm::vec3 offset = faceCenters[f] - seedCenter;
+                float distance = glm::dot(offset, offset);
+                if (newVertices < bestNew || (newVertices == bestNew && distance < bestDistance)) {
+                    bestNew = newVertices;
+                    bestDistance = distance;
+                    next = f;
+                }
+            }
+            candidates.resize(kept);
+            if (bestNew > 3) break;
+        }
+
+        // Copiar los vértices del cluster y limpiar el mapa local
+        cluster.vertexCount = static_cast<uint32_t>(clusterVertices.size());
+        size_t base = out.positions.size();
+        out.positions.resize(base + clusterVertices.size());
+        out.sourceVertices.resize(base + clusterVertices.size());
+        for (size_t v = 0; v < clusterVertices.size(); v++) {
+            int index = clusterVertices[v];
+            out.positions.x[base + v] = vertices.x[index];
+            out.positions.y[base + v] = vertices.y[index];
+            out.positions.z[base + v] = vertices.z[index];
+            out.sourceVertices[base + v] = static_cast<uint32_t>(index);
+            localIndex[index] = -1;
+        }
+
+        finishCluster(out.positions, out.faces, cluster);
+        finishClusterEdges(out.faces, out.edges, cluster);
+        out.clusters.push_back(cluster);
+    }
+    buildClusterBVH(out);
+}
+
+// Copiar un atributo por vértice de la malla de entrada (source) a los
+// vértices de los clusters
+void gatherClusterVertices(const ClusteredMesh& mesh, const VertexStreams& source, VertexStreams& out) {
+    out.resize(mesh.sourceVertices.size());
+    for (size_t v = 0; v < mesh.sourceVertices.size(); v++) {
+        uint32_t index = mesh.sourceVertices[v];
+        out.x[v] = source.x[index];
+        out.y[v] = source.y[index];
+        out.z[v] = source.z[index];
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Descarte por frame
+// ---------------------------------------------------------------------------
+
+// Planos del frustum en espacio del objeto (a·x + b·y + c·z + d >= 0 adentro),
+// normalizados para medir distancias. Se agregan los planos de recorte
+// (cercano y banda de guarda) para saber qué clusters pueden necesitarlo.
+struct FrustumPlanes {
+    glm::vec4 planes[6];                    // Izquierda, derecha, abajo, arriba, cerca, lejos
+    glm::vec4 clip[CLIP_PLANE_COUNT];       // Los de clipPlanes
+};
+
+inline glm::vec4 normalizePlane(const glm::vec4& plane) {
+    float length = std::sqrt(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+    return length > 0.0f ? plane / length : plane;
+}
+
+FrustumPlanes extractFrustum(const glm::mat4& mvp) {
+    glm::vec4 rows[4];
+    for (int r = 0; r < 4; r++) {
+        rows[r] = glm::vec4(mvp[0][r], mvp[1][r], mvp[2][r], mvp[3][r]);
+    }
+
+    FrustumPlanes frustum;
+    for (int axis = 0; axis < 3; axis++) {
+        frustum.planes[axis * 2] = normalizePlane(rows[3] + rows[axis]);
+        frustum.planes[axis * 2 + 1] = normalizePlane(rows[3] - rows[axis]);
+    }
+
+    // Un plano p en espacio de clip es p·(mvp·v) = (p·filas)·v en el objeto
+    for (int i = 0; i < CLIP_PLANE_COUNT; i++) {
+        const glm::vec4& p = clipPlanes.planes[i];
+        frustum.clip[i] = normalizePlane(rows[0] * p.x + rows[1] * p.y + rows[2] * p.z + rows[3] * p.w);
+    }
+    return frustum;
+}
+
+inline float planeDistance(const glm::vec4& plane, const glm::vec3& p) {
+    return plane.x * p.x + plane.y * p.y + plane.z * p.z + plane.w;
+}
+
+inline bool sphereOutsideFrustum(const FrustumPlanes& frustum, const glm::vec3& center, float radius) {
+    for (const glm::vec4& plane : frustum.planes) {
+        if (planeDistance(plane, center) < -radius) return true;
+    }
+    return false;
+}
+
+// Planos de recorte que cruza la esfera (bits de ClipPlane)
+inline int sphereClipMask(const FrustumPlanes& frustum, const glm::vec3& center, float radius) {
+    int mask = 0;
+    for (int i = 0; i < CLIP_PLANE_COUNT; i++) {
+        if (planeDistance(frustum.clip[i], center) < radius) mask |= 1 << i;
+    }
+    return mask;
+}
+
+// Todas las caras del cluster miran en contra de la cámara. Prueba
+// conservadora del cono contra la esfera del cluster.
+inline bool clusterBackFacing(const Cluster& cluster, const glm::vec3& eye) {
+    if (cluster.coneCutoff >= 1.0f) return false;
+    glm::vec3 toCluster = cluster.center - eye;
+    return glm::dot(toCluster, cluster.coneAxis) >= cluster.coneCutoff * glm::length(toCluster) + cluster.radius;
+}
+
+// Dónde queda una caja respecto de count planos (adentro >= 0): -1 entera
+// afuera de alguno, 1 entera adentro de todos, 0 cruza alguno
+inline int classifyBox(const glm::vec4* planes, int count, const glm::vec3& boxMin, const glm::vec3& boxMax) {
+    int result = 1;
+    for (int i = 0; i < count; i++) {
+        const glm::vec4& p = planes[i];
+        // Las esquinas más adentro y más afuera según la normal del plano
+        glm::vec3 inner(p.x >= 0.0f ? boxMax.x : boxMin.x, p.y >= 0.0f ? boxMax.y : boxMin.y,
+                        p.z >= 0.0f ? boxMax.z : boxMin.z);
+        glm::vec3 outer(p.x >= 0.0f ? boxMin.x : boxMax.x, p.y >= 0.0f ? boxMin.y : boxMax.y,
+                        p.z >= 0.0f ? boxMin.z : boxMax.z);
+        if (planeDistance(p, inner) < 0.0f) return -1;
+        if (planeDistance(p, outer) < 0.0f) result = 0;
+    }
+    return result;
+}
+
+// Cluster que no está afuera del frustum: queda si no está de espaldas.
+// Con clipInside se sabe que no cruza ningún plano de recorte.
+inline void acceptCluster(const ClusteredMesh& mesh, uint32_t index, const FrustumPlanes& frustum,
+                          const glm::vec3& eye, bool clipInside, std::vector<uint32_t>& visible,
+                          std::vector<uint8_t>& clipMasks, ClusterCullStats& stats) {
+    const Cluster& cluster = mesh.clusters[index];
+    if (clusterBackFacing(cluster, eye)) {
+        stats.coneClusters++;
+        stats.coneTriangles += cluster.faceCount;
+        return;
+    }
+    visible.push_back(index);
+    clipMasks.push_back(clipInside ? 0 : static_cast<uint8_t>(sphereClipMask(frustum, cluster.center, cluster.radius)));
+}
+
+// Dejar en visible los índices de los clusters que sobreviven, probando
+// cada uno (sin el BVH). Ver cullClusters.
+void cullClustersLinear(const ClusteredMesh& mesh, const FrustumPlanes& frustum, const glm::vec3& eye,
+                        std::vector<uint32_t>& visible, std::vector<uint8_t>& clipMasks, ClusterCullStats& stats) {
+    visible.clear();
+    clipMasks.clear();
+    for (size_t i = 0; i < mesh.clusters.size(); i++) {
+        const Cluster& cluster = mesh.clusters[i];
+        stats.clusters++;
+        stats.triangles += cluster.faceCount;
+
+        if (sphereOutsideFrustum(frustum, cluster.center, cluster.radius)) {
+            stats.frustumClusters++;
+            stats.frustumTriangles += cluster.faceCount;
+        } else {
+            acceptCluster(mesh, static_cast<uint32_t>(i), frustum, eye, false, visible, clipMasks, stats);
+        }
+    }
+}
+
+// Dejar en visible los índices de los clusters que sobreviven y en
+// clipMasks los planos de recorte que cada uno puede cruzar (0 = ninguno,
+// sus triángulos no necesitan pruebas de recorte). eye es la posición de
+// la cámara en espacio del objeto.
+//
+// Recorre el BVH de los clusters: un nodo con la caja afuera del frustum
+// descarta su subárbol entero y uno con la caja adentro acepta el suyo sin
+// más pruebas de frustum (y sin recorte si la caja tampoco cruza los planos
+// de recorte). Sólo las hojas que cruzan el borde prueban cluster por
+// cluster. visible queda en orden creciente, como sin el árbol.
+void cullClusters(const ClusteredMesh& mesh, const FrustumPlanes& frustum, const glm::vec3& eye,
+                  std::vector<uint32_t>& visible, std::vector<uint8_t>& clipMasks, ClusterCullStats& stats) {
+    const BVH& tree = mesh.tree;
+    if (tree.empty()) {
+        cullClustersLinear(mesh, frustum, eye, visible, clipMasks, stats);
+        return;
+    }
+
+    visible.clear();
+    clipMasks.clear();
+    stats.clusters += mesh.clusters.size();
+    stats.triangles += mesh.faces.size();
+
+    uint32_t stack[BVH_MAX_DEPTH + 1];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        uint32_t index = stack[--top];
+        const BVHNode& node = tree.nodes[index];
+        int inFrustum = classifyBox(frustum.planes, 6, node.boundsMin, node.boundsMax);
+        if (inFrustum == 0 && !node.leaf()) {
+            stack[top++] = node.first + 1;
+            stack[top++] = node.first;
+            continue;
+        }
+
+        uint32_t begin, end;
+        tree.subtreeRange(index, begin, end);
+        if (inFrustum < 0) {
+            for (uint32_t c = begin; c < end; c++) {
+                stats.frustumClusters++;
+                stats.frustumTriangles += mesh.clusters[c].faceCount;
+            }
+        } else if (inFrustum > 0) {
+            bool clipInside = classifyBox(frustum.clip, CLIP_PLANE_COUNT, node.boundsMin, node.boundsMax) > 0;
+            for (uint32_t c = begin; c < end; c++) {
+                acceptCluster(mesh, c, frustum, eye, clipInside, visible, clipMasks, stats);
+            }
+        } else {
+            for (uint32_t c = begin; c < end; c++) {
+                const Cluster& cluster = mesh.clusters[c];
+                if (sphereOutsideFrustum(frustum, cluster.center, cluster.radius)) {
+                    stats.frustumClusters++;
+                    stats.frustumTriangles += cluster.faceCount;
+                } else {
+                    acceptCluster(mesh, c, frustum, eye, false, visible, clipMasks, stats);
+                }
+            }
+        }
+    }
+}
+
+// Transformar en el hilo actual los vértices de los clusters visibles
+inline void transformClusterRanges(const ClusteredMesh& mesh, const std::vector<uint32_t>& visible,
+                                   const VertexTransform& t, TransformedVertices& out) {
+    for (uint32_t c : visible) {
+        const Cluster& cluster = mesh.clusters[c];
+        transformRange(t, mesh.positions, out, cluster.vertexBegin, cluster.vertexBegin + cluster.vertexCount);
+    }
+}
+
+// Transformar sólo los vértices de los clusters visibles. Los rangos de los
+// demás quedan sin actualizar en out.
+void transformClusters(const ClusteredMesh& mesh, const std::vector<uint32_t>& visible,
+                       const glm::mat4& mvp, const glm::mat4& mv, const glm::mat4& viewport,
+                       TransformedVertices& out) {
+    size_t count = mesh.positions.size();
+    out.screen.resize(count);
+    out.view.resize(count);
+
+    VertexTransform t = makeVertexTransform(mvp, mv, viewport);
+
+    size_t visibleVertices = 0;
+    for (uint32_t c : visible) visibleVertices += mesh.clusters[c].vertexCount;
+
+    if (visibleVertices < VERTEX_PARALLEL_THRESHOLD) {
+        transformClusterRanges(mesh, visible, t, out);
+        return;
+    }
+
+    int batches = static_cast<int>((visible.size() + CLUSTER_TRANSFORM_BATCH - 1) / CLUSTER_TRANSFORM_BATCH);
+    renderPool().parallelFor(batches, [&](int batch, int) {
+        size_t first = static_cast<size_t>(batch) * CLUSTER_TRANSFORM_BATCH;
+        size_t last = std::min(visible.size(), first + CLUSTER_TRANSFORM_BATCH);
+        for (size_t i = first; i < last; i++) {
+            const Cluster& cluster = mesh.clusters[visible[i]];
+            transformRange(t, mesh.positions, out, cluster.vertexBegin, cluster.vertexBegin + cluster.vertexCount);
+        }
+    });
+}
+
+// Origen de los vértices de un triángulo armado, para interpolar atributos
+// por vértice: los tres vértices de la cara, y para cada esquina su w de
+// clip y sus pesos sobre esos tres vértices (la identidad si la cara no se
+// recortó)
+struct TriangleCorners {
+    uint32_t vertices[3];
+    float w[3];
+    glm::vec3 weights[3];
+};
+
+// emit acepta las esquinas como quinto parámetro
+template <typename EmitFn>
+constexpr bool emitWantsCorners() {
+    return std::is_invocable<EmitFn&, glm::vec3, glm::vec3, glm::vec3, uint32_t, const TriangleCorners&>::value;
+}
+
+// Entregar un triángulo a emit, con sus esquinas sólo si emit las acepta
+template <typename EmitFn>
+inline void emitTriangle(EmitFn& emit, const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2,
+                         uint32_t face, const TriangleCorners& corners) {
+    if constexpr (emitWantsCorners<EmitFn>()) {
+        emit(v0, v1, v2, face, corners);
+    } else {
+        emit(v0, v1, v2, face);
+    }
+}
+
+// Recortar un triángulo en espacio de clip y entregar el polígono que queda
+// como abanico de triángulos de la misma cara
+template <typename EmitFn>
+void emitClippedTriangle(const glm::vec4 clip[3], int planeMask, const glm::mat4& viewport, uint32_t face,
+                         const Face& source, ClusterCullStats& stats, EmitFn& emit) {
+    glm::vec4 polygon[CLIP_MAX_VERTICES];
+    glm::vec3 weights[CLIP_MAX_VERTICES];
+    int count = clipTriangle(clip, planeMask, polygon, weights);
+    if (count < 3) {
+        stats.clipRejected++;
+        return;
+    }
+    stats.clipped++;
+
+    glm::vec3 screen[CLIP_MAX_VERTICES];
+    for (int k = 0; k < count; k++) {
+        screen[k] = clipToScreen(polygon[k], viewport);
+    }
+
+    TriangleCorners corners;
+    for (int v = 0; v < 3; v++) corners.vertices[v] = static_cast<uint32_t>(source.vertexIndices[v]);
+    for (int k = 1; k + 1 < count; k++) {
+        const int fan[3] = {0, k, k + 1};
+        for (int v = 0; v < 3; v++) {
+            corners.w[v] = polygon[fan[v]].w;
+            corners.weights[v] = weights[fan[v]];
+        }
+        emitTriangle(emit, screen[0], screen[k], screen[k + 1], face, corners);
+    }
+}
+
+// Armar los triángulos de los clusters visibles ya transformados: test de
+// cara trasera en espacio del objeto (eye es la cámara en ese espacio) y
+// recorte en espacio de clip sólo en los clusters que pueden necesitarlo.
+// emit(v0, v1, v2, cara) recibe cada triángulo en pantalla; si acepta un
+// quinto parámetro recibe además sus TriangleCorners.
+template <typename EmitFn>
+void assembleClusterTriangles(const LevelGeometry& geometry, const std::vector<uint32_t>& visible,
+                              const std::vector<uint8_t>& clipMasks, const TransformedVertices& vertices,
+                              const glm::mat4& projection, const glm::mat4& viewport, const glm::vec3& eye,
+                              ClusterCullStats& stats, EmitFn emit) {
+    const ClusteredMesh& mesh = geometry.mesh;
+    const FaceAttributes& attributes = geometry.attributes;
+    const VertexStreams& screenPos = vertices.screen;
+    const VertexStreams& viewPos = vertices.view;
+
+    // w de clip a partir de la posición en vista (fila 3 de la proyección)
+    const glm::vec4 wRow(projection[0][3], projection[1][3], projection[2][3], projection[3][3]);
+
+    for (size_t k = 0; k < visible.size(); k++) {
+        const Cluster& cluster = mesh.clusters[visible[k]];
+        int clusterClipMask = clipMasks[k];
+        for (uint32_t i = cluster.faceBegin; i < cluster.faceBegin + cluster.faceCount; i++) {
+            // Backface culling
+            float facing = attributes.normalX[i] * (eye.x - attributes.centerX[i]) +
+                           attributes.normalY[i] * (eye.y - attributes.centerY[i]) +
+                           attributes.normalZ[i] * (eye.z - attributes.centerZ[i]);
+            if (!(facing > 0.0f)) {
+                stats.backfaceTriangles++;
+                continue;
+            }
+
+            const auto& face = mesh.faces[i];
+
+            // Sólo los clusters que cruzan el plano cercano o la banda de
+            // guarda necesitan revisar sus triángulos en espacio de clip
+            if (clusterClipMask) {
+                stats.clipTested++;
+                glm::vec4 clip[3];
+                int outcodeAll = ~0;
+                int outcodeAny = 0;
+                for (int v = 0; v < 3; v++) {
+                    clip[v] = projection * glm::vec4(viewPos.get(face.vertexIndices[v]), 1.0f);
+                    int outcode = clipOutcode(clip[v]) & clusterClipMask;
+                    outcodeAll &= outcode;
+                    outcodeAny |= outcode;
+                }
+                if (outcodeAll) {
+                    stats.clipRejected++;
+                    continue;
+                }
+                if (outcodeAny) {
+                    emitClippedTriangle(clip, outcodeAny, viewport, i, face, stats, emit);
+                    continue;
+                }
+            }
+
+            if constexpr (emitWantsCorners<EmitFn>()) {
+                TriangleCorners corners;
+                for (int v = 0; v < 3; v++) {
+                    uint32_t index = static_cast<uint32_t>(face.vertexIndices[v]);
+                    corners.vertices[v] = index;
+                    corners.w[v] = glm::dot(wRow, glm::vec4(viewPos.get(index), 1.0f));
+                    corners.weights[v] = glm::vec3(0.0f);
+                    corners.weights[v][v] = 1.0f;
+                }
+                emit(screenPos.get(face.vertexIndices[0]), screenPos.get(face.vertexIndices[1]),
+                     screenPos.get(face.vertexIndices[2]), i, corners);
+            } else {
+                emit(screenPos.get(face.vertexIndices[0]), screenPos.get(face.vertexIndices[1]),
+                     screenPos.get(face.vertexIndices[2]), i);
+            }
+        }
+    }
+}
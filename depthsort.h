@@ -0,0 +1,74 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Orden de dibujo por profundidad sin mover los triángulos: se ordenan
+// índices de 32 bits con radix sort LSD sobre una llave de 32 bits derivada
+// de la profundidad. Es estable y su costo es lineal en el número de
+// triángulos, en vez de n log n intercambios de estructuras completas.
+
+const int DEPTH_SORT_RADIX_BITS = 11;
+const int DEPTH_SORT_BUCKETS = 1 << DEPTH_SORT_RADIX_BITS;
+const int DEPTH_SORT_PASSES = (32 + DEPTH_SORT_RADIX_BITS - 1) / DEPTH_SORT_RADIX_BITS;
+
+// Llave sin signo que ordena igual que el float: los positivos se marcan
+// con el bit alto y a los negativos se les invierten todos los bits
+inline uint32_t depthSortKey(float depth) {
+    uint32_t bits;
+    std::memcpy(&bits, &depth, sizeof(bits));
+    return (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+}
+
+// Buffers reutilizados entre frames
+struct DepthSorter {
+    std::vector<uint32_t> keys, tempKeys;
+    std::vector<uint32_t> tempOrder;
+
+    // Dejar en order los índices 0..count-1 de menor a mayor profundidad
+    // (de adelante hacia atrás). A igual profundidad se conserva el orden
+    // original.
+    void sortFrontToBack(const float* depths, size_t count, std::vector<uint32_t>& order) {
+        order.resize(count);
+        keys.resize(count);
+        tempKeys.resize(count);
+        tempOrder.resize(count);
+
+        // Histogramas de todas las pasadas en un solo recorrido
+        std::vector<uint32_t> histograms(DEPTH_SORT_PASSES * DEPTH_SORT_BUCKETS, 0);
+        for (size_t i = 0; i < count; i++) {
+            uint32_t key = depthSortKey(depths[i]);
+            keys[i] = key;
+            order[i] = static_cast<uint32_t>(i);
+            for (int pass = 0; pass < DEPTH_SORT_PASSES; pass++) {
+                uint32_t digit = (key >> (pass * DEPTH_SORT_RADIX_BITS)) & (DEPTH_SORT_BUCKETS - 1);
+                histograms[pass * DEPTH_SORT_BUCKETS + digit]++;
+            }
+        }
+
+        for (int pass = 0; pass < DEPTH_SORT_PASSES; pass++) {
+            uint32_t* histogram = &histograms[pass * DEPTH_SORT_BUCKETS];
+
+            // Si todas las llaves comparten este dígito la pasada no cambia nada
+            uint32_t firstDigit = count ? (keys[0] >> (pass * DEPTH_SORT_RADIX_BITS)) & (DEPTH_SORT_BUCKETS - 1) : 0;
+            if (histogram[firstDigit] == count) continue;
+
+            uint32_t offset = 0;
+            for (int bucket = 0; bucket < DEPTH_SORT_BUCKETS; bucket++) {
+                uint32_t size = histogram[bucket];
+                histogram[bucket] = offset;
+                offset += size;
+            }
+
+            for (size_t i = 0; i < count; i++) {
+                uint32_t key = keys[i];
+                uint32_t digit = (key >> (pass * DEPTH_SORT_RADIX_BITS)) & (DEPTH_SORT_BUCKETS - 1);
+                uint32_t slot = histogram[digit]++;
+                tempKeys[slot] = key;
+                tempOrder[slot] = order[i];
+            }
+            keys.swap(tempKeys);
+            order.swap(tempOrder);
+        }
+    }
+};
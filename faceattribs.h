@@ -0,0 +1,94 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+#include "color.h"
+#include "objloader.h"
+#include "vertexstage.h"
+
+// Datos de cada cara que no dependen de la cámara: color base, normal y
+// centroide en espacio del objeto. Se calculan una vez al cargar; por frame
+// sólo queda el test de cara trasera y un producto punto con la luz, ambos
+// en espacio del objeto.
+
+struct FaceAttributes {
+    std::vector<Color> baseColor;
+    std::vector<float> normalX, normalY, normalZ;
+    std::vector<float> centerX, centerY, centerZ;
+
+    size_t size() const {
+        return baseColor.size();
+    }
+
+    void resize(size_t n) {
+        baseColor.resize(n);
+        normalX.resize(n);
+        normalY.resize(n);
+        normalZ.resize(n);
+        centerX.resize(n);
+        centerY.resize(n);
+        centerZ.resize(n);
+    }
+};
+
+// Calcular los atributos de cada cara a partir de las posiciones centradas
+// y escaladas del modelo. baseColorOf(centro) decide el color por región.
+//
+// La normal es el producto cruz escalado por un factor positivo, así que el
+// test de cara trasera da lo mismo que con el producto cruz sin normalizar,
+// por chica que sea la cara. Sólo las caras sin área (producto cruz cero)
+// quedan con normal cero y ese test las descarta.
+template <typename BaseColorFn>
+void buildFaceAttributes(const VertexStreams& positions, const std::vector<Face>& faces,
+                         BaseColorFn baseColorOf, FaceAttributes& out) {
+    out.resize(faces.size());
+    for (size_t i = 0; i < faces.size(); i++) {
+        const auto& idx = faces[i].vertexIndices;
+        glm::vec3 p0 = positions.get(idx[0]);
+        glm::vec3 p1 = positions.get(idx[1]);
+        glm::vec3 p2 = positions.get(idx[2]);
+
+        glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+        // Llevar la mayor componente a 1 antes de normalizar: en caras muy
+        // chicas la longitud al cuadrado se iría a cero en float
+        float largest = std::max(std::abs(normal.x), std::max(std::abs(normal.y), std::abs(normal.z)));
+        if (largest > 0.0f) {
+            normal /= largest;
+            normal /= glm::length(normal);
+        }
+
+        glm::vec3 center = (p0 + p1 + p2) / 3.0f;
+
+        out.baseColor[i] = baseColorOf(center);
+        out.normalX[i] = normal.x;
+        out.normalY[i] = normal.y;
+        out.normalZ[i] = normal.z;
+        out.centerX[i] = center.x;
+        out.centerY[i] = center.y;
+        out.centerZ[i] = center.z;
+    }
+}
+
+// Normales por vértice para el sombreado suave: promedio de las normales de
+// las caras que lo usan, pesadas por su área. Los vértices sin caras quedan
+// con normal cero.
+void buildVertexNormals(const VertexStreams& positions, const std::vector<Face>& faces, VertexStreams& out) {
+    std::vector<glm::vec3> sums(positions.size(), glm::vec3(0.0f));
+    for (const Face& face : faces) {
+        const auto& idx = face.vertexIndices;
+        glm::vec3 p0 = positions.get(idx[0]);
+        glm::vec3 weighted = glm::cross(positions.get(idx[1]) - p0, positions.get(idx[2]) - p0);
+        for (int index : idx) sums[index] += weighted;
+    }
+
+    out.resize(positions.size());
+    for (size_t v = 0; v < sums.size(); v++) {
+        float length = glm::length(sums[v]);
+        glm::vec3 normal = length > 0.0f ? sums[v] / length : glm::vec3(0.0f);
+        out.x[v] = normal.x;
+        out.y[v] = normal.y;
+        out.z[v] = normal.z;
+    }
+}
@@ -2,71 +2,622 @@
 #include <SDL2/SDL.h>
 #include <vector>
 #include <algorithm>
+#include <cmath>
 #include <limits>
+#include <new>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
 #include "color.h"
+#include "profiler.h"
+#include "threadpool.h"
 
-// Dimensiones de la pantalla
+// Dimensiones de la ventana, que son también las máximas del render
 const int SCREEN_WIDTH = 800;
 const int SCREEN_HEIGHT = 600;
 
-// Buffer de píxeles
-std::vector<Color> framebuffer(SCREEN_WIDTH * SCREEN_HEIGHT);
+// Resolución interna del render. Puede bajar en tiempo de ejecución (ver
+// ResolutionController); al presentar se escala al tamaño de la ventana.
+int renderWidth = SCREEN_WIDTH;
+int renderHeight = SCREEN_HEIGHT;
 
-// Z-buffer para manejo de profundidad
-std::vector<float> zbuffer(SCREEN_WIDTH * SCREEN_HEIGHT);
+// Bloques de 8x8 píxeles: unidad del Hi-Z, del borrado diferido y de la
+// disposición por bloques. El rasterizador lee y escribe bloques enteros,
+// así que los buffers se rellenan hasta completar bloques.
+const int HIZ_BLOCK = 8;
+const int HIZ_BLOCK_PIXELS = HIZ_BLOCK * HIZ_BLOCK;
+
+// Las filas (o bloques) empiezan en una línea de caché
+const size_t FRAMEBUFFER_ALIGNMENT = 64;
+
+// Reservar memoria alineada a FRAMEBUFFER_ALIGNMENT para std::vector
+template <typename T>
+struct AlignedAllocator {
+    using value_type = T;
+
+    AlignedAllocator() = default;
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U>&) {}
+
+    T* allocate(size_t n) {
+        return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(FRAMEBUFFER_ALIGNMENT)));
+    }
+
+    void deallocate(T* p, size_t) {
+        ::operator delete(p, std::align_val_t(FRAMEBUFFER_ALIGNMENT));
+    }
+
+    template <typename U>
+    bool operator==(const AlignedAllocator<U>&) const { return true; }
+    template <typename U>
+    bool operator!=(const AlignedAllocator<U>&) const { return false; }
+};
+
+template <typename T>
+using AlignedVector = std::vector<T, AlignedAllocator<T>>;
+
+// Orden de los píxeles en memoria
+enum class FramebufferLayout {
+    Linear,     // Fila por fila
+    Tiled       // Bloque de 8x8 por bloque (64 píxeles contiguos), fila por fila dentro del bloque
+};
+
+// Formato del z-buffer
+enum class DepthFormat {
+    Float32,
+    Unorm24,    // Entero de 24 bits en 32 bits
+    Unorm16
+};
+
+FramebufferLayout parseFramebufferLayout(const std::string& name) {
+    return name == "tiled" ? FramebufferLayout::Tiled : FramebufferLayout::Linear;
+}
+
+const char* framebufferLayoutName(FramebufferLayout layout) {
+    return layout == FramebufferLayout::Tiled ? "tiled" : "linear";
+}
+
+DepthFormat parseDepthFormat(const std::string& bits) {
+    if (bits == "16") return DepthFormat::Unorm16;
+    if (bits == "24") return DepthFormat::Unorm24;
+    return DepthFormat::Float32;
+}
+
+const char* depthFormatName(DepthFormat format) {
+    switch (format) {
+        case DepthFormat::Unorm24: return "24 bits";
+        case DepthFormat::Unorm16: return "16 bits";
+        default: return "float";
+    }
+}
+
+// Posición del píxel (x, y) en un buffer con la disposición dada. En Tiled,
+// stride es el ancho en píxeles de una fila de bloques.
+inline size_t pixelOffset(FramebufferLayout layout, int stride, int x, int y) {
+    if (layout == FramebufferLayout::Tiled) {
+        size_t block = static_cast<size_t>(y / HIZ_BLOCK) * (stride / HIZ_BLOCK) + x / HIZ_BLOCK;
+        return block * HIZ_BLOCK_PIXELS + (y % HIZ_BLOCK) * HIZ_BLOCK + x % HIZ_BLOCK;
+    }
+    return static_cast<size_t>(y) * stride + x;
+}
+
+// Codificación de la profundidad de cada formato. z es la profundidad en
+// NDC ([-1, 1] entre los planos cercano y lejano). hizBound da una cota que
+// el Hi-Z puede usar: una profundidad mayor o igual nunca pasa el test
+// contra un valor guardado menor o igual a stored.
+struct DepthF32 {
+    using Type = float;
+    static Type clearValue() { return std::numeric_limits<float>::max(); }
+    static Type encode(float z) { return z; }
+    static float hizBound(Type stored) { return stored; }
+};
+
+// Entero sin signo de BITS bits: [-1, 1] se lleva a [0, MAX] truncando.
+// Las profundidades fuera del rango se saturan.
+template <int BITS, typename T>
+struct DepthUnorm {
+    using Type = T;
+    static constexpr uint32_t MAX = (1u << BITS) - 1;
+    static constexpr float SCALE = 0.5f * MAX;
+
+    static Type clearValue() { return static_cast<Type>(MAX); }
+
+    static Type encode(float z) {
+        float d = z * SCALE + SCALE;
+        d = std::min(std::max(d, 0.0f), static_cast<float>(MAX));
+        return static_cast<Type>(d);
+    }
+
+    // encode trunca, así que todo z >= (stored + 1) / SCALE - 1 se codifica
+    // como stored + 1 o más
+    static float hizBound(Type stored) {
+        return (static_cast<float>(stored) + 1.0f) / SCALE - 1.0f;
+    }
+};
+
+using DepthU24 = DepthUnorm<24, uint32_t>;
+using DepthU16 = DepthUnorm<16, uint16_t>;
+
+// Buffers de color y profundidad de un render.
+//
+// La memoria se reserva una sola vez para el tamaño máximo, alineada a
+// línea de caché y con las filas rellenas hasta bloques de 8x8 completos;
+// cambiar el tamaño lógico (resize) no vuelve a pedir memoria.
+//
+// El borrado es diferido: clear() sólo avanza un contador de generación y
+// reinicia el Hi-Z. Cada bloque de 8x8 recuerda en qué generación se borró
+// por última vez y se borra la primera vez que alguien lo toca (el
+// rasterizador llama a ensureBlock). resolve() borra los que nadie tocó
+// antes de leer la imagen.
+struct Framebuffer {
+    int width = 0, height = 0;              // Tamaño lógico
+    int maxWidth = 0, maxHeight = 0;
+    int stride = 0;                         // Píxeles por fila (Linear) o por fila de bloques / 8 (Tiled)
+    int blocksX = 0, blocksY = 0;
+    FramebufferLayout layout = FramebufferLayout::Linear;
+    DepthFormat depthFormat = DepthFormat::Float32;
+    bool lazyClear = true;
+
+    AlignedVector<Color> color;
+    AlignedVector<unsigned char> depth;     // Valores de depthFormat
+    size_t depthBytes = sizeof(float);      // Por píxel
+
+    // Hi-Z: cota superior de la profundidad de cada bloque (blocksX por
+    // fila). Un triángulo que en todo el bloque queda detrás de esa cota no
+    // puede pasar el test de profundidad en ningún píxel del bloque.
+    std::vector<float> hiz;
+
+    std::vector<uint32_t> blockGeneration;
+    uint32_t generation = 1;
+    Color clearColor;
+
+    // Posición del píxel (x, y) en color y depth
+    inline size_t offset(int x, int y) const {
+        return pixelOffset(layout, stride, x, y);
+    }
+
+    template <typename D>
+    typename D::Type* depthAs() {
+        return reinterpret_cast<typename D::Type*>(depth.data());
+    }
+
+    // Cambiar el tamaño lógico (hasta maxWidth x maxHeight). El contenido
+    // queda indefinido hasta el siguiente clear().
+    void resize(int newWidth, int newHeight) {
+        width = std::clamp(newWidth, 1, maxWidth);
+        height = std::clamp(newHeight, 1, maxHeight);
+        blocksX = (width + HIZ_BLOCK - 1) / HIZ_BLOCK;
+        blocksY = (height + HIZ_BLOCK - 1) / HIZ_BLOCK;
+
+        // Filas de un múltiplo de 16 píxeles: 64 bytes de color
+        int lineAlign = static_cast<int>(FRAMEBUFFER_ALIGNMENT / sizeof(Color));
+        stride = layout == FramebufferLayout::Tiled
+                     ? blocksX * HIZ_BLOCK
+                     : (width + lineAlign - 1) / lineAlign * lineAlign;
+
+        std::fill(blockGeneration.begin(), blockGeneration.end(), 0);
+        std::fill(hiz.begin(), hiz.end(), std::numeric_limits<float>::max());
+    }
+
+    // Borrar un bloque (índice en blocksX x blocksY) con el color y la
+    // profundidad de clear
+    void clearBlock(int block) {
+        int bx = (block % blocksX) * HIZ_BLOCK;
+        int by = (block / blocksX) * HIZ_BLOCK;
+        for (int r = 0; r < HIZ_BLOCK; r++) {
+            size_t row = offset(bx, by + r);
+            std::fill(color.begin() + row, color.begin() + row + HIZ_BLOCK, clearColor);
+            switch (depthFormat) {
+                case DepthFormat::Unorm24:
+                    std::fill_n(depthAs<DepthU24>() + row, HIZ_BLOCK, DepthU24::clearValue());
+                    break;
+                case DepthFormat::Unorm16:
+                    std::fill_n(depthAs<DepthU16>() + row, HIZ_BLOCK, DepthU16::clearValue());
+                    break;
+                default:
+                    std::fill_n(depthAs<DepthF32>() + row, HIZ_BLOCK, DepthF32::clearValue());
+                    break;
+            }
+        }
+        blockGeneration[block] = generation;
+    }
+
+    // Borrar el bloque (bx, by) si todavía tiene el contenido de un frame
+    // anterior. Sólo el hilo dueño del bloque debe llamarla.
+    inline void ensureBlock(int bx, int by) {
+        int block = by * blocksX + bx;
+        if (blockGeneration[block] != generation) clearBlock(block);
+    }
+
+    void clear(const Color& newColor) {
+        PROFILE_SCOPE(PROFILE_CLEAR);
+        PROFILE_COUNT(COUNTER_PIXELS_SCREEN, static_cast<uint64_t>(width) * height);
+        clearColor = newColor;
+        generation++;
+        if (generation == 0) {
+            // Dio la vuelta: ningún bloque debe parecer ya borrado
+            std::fill(blockGeneration.begin(), blockGeneration.end(), 0);
+            generation = 1;
+        }
+        std::fill(hiz.begin(), hiz.begin() + blocksX * blocksY, std::numeric_limits<float>::max());
+        if (!lazyClear) clearStaleBlocks();
+    }
+
+    // Borrar los bloques que nadie tocó desde el último clear()
+    void clearStaleBlocks() {
+        int blocks = blocksX * blocksY;
+        for (int block = 0; block < blocks; block++) {
+            if (blockGeneration[block] != generation) clearBlock(block);
+        }
+    }
+
+    // Lo mismo, medido como etapa propia del frame
+    void resolve() {
+        PROFILE_SCOPE(PROFILE_RESOLVE);
+        clearStaleBlocks();
+    }
+
+    // Escribir un píxel con test de profundidad, sin verificar límites. Para
+    // quien ya recortó a [0, width) x [0, height).
+    inline void writeUnchecked(int x, int y, float z, const Color& c) {
+        ensureBlock(x / HIZ_BLOCK, y / HIZ_BLOCK);
+        size_t index = offset(x, y);
+        bool pass;
+        switch (depthFormat) {
+            case DepthFormat::Unorm24: {
+                DepthU24::Type d = DepthU24::encode(z);
+                pass = d < depthAs<DepthU24>()[index];
+                if (pass) depthAs<DepthU24>()[index] = d;
+                break;
+            }
+            case DepthFormat::Unorm16: {
+                DepthU16::Type d = DepthU16::encode(z);
+                pass = d < depthAs<DepthU16>()[index];
+                if (pass) depthAs<DepthU16>()[index] = d;
+                break;
+            }
+            default:
+                pass = z < depthAs<DepthF32>()[index];
+                if (pass) depthAs<DepthF32>()[index] = z;
+                break;
+        }
+        // Una escritura sólo baja la profundidad: el Hi-Z sigue siendo una
+        // cota superior válida
+        if (pass) color[index] = c;
+    }
+
+    // Lo mismo verificando que el punto esté dentro del buffer
+    inline bool point(int x, int y, float z, const Color& c) {
+        if (x < 0 || x >= width || y < 0 || y >= height) return false;
+        writeUnchecked(x, y, z, c);
+        return true;
+    }
+
+    // Imagen en orden fila por fila (ya resuelta). En Linear devuelve el
+    // buffer mismo; en Tiled la copia a staging.
+    const Color* linearColor(std::vector<Color>& staging, int& rowStride) {
+        resolve();
+        if (layout == FramebufferLayout::Linear) {
+            rowStride = stride;
+            return color.data();
+        }
+        staging.resize(static_cast<size_t>(width) * height);
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x += HIZ_BLOCK) {
+                int count = std::min(HIZ_BLOCK, width - x);
+                std::memcpy(&staging[static_cast<size_t>(y) * width + x], &color[offset(x, y)], count * sizeof(Color));
+            }
+        }
+        rowStride = width;
+        return staging.data();
+    }
+};
+
+// Crear un framebuffer para hasta maxWidth x maxHeight píxeles
+Framebuffer makeFramebuffer(int maxWidth, int maxHeight, FramebufferLayout layout, DepthFormat depthFormat) {
+    Framebuffer fb;
+    fb.layout = layout;
+    fb.depthFormat = depthFormat;
+    fb.depthBytes = depthFormat == DepthFormat::Unorm16 ? sizeof(uint16_t)
+                  : depthFormat == DepthFormat::Unorm24 ? sizeof(uint32_t) : sizeof(float);
+    fb.maxWidth = maxWidth;
+    fb.maxHeight = maxHeight;
+
+    // Lo más grande que puede ocupar: filas alineadas y bloques completos
+    int lineAlign = static_cast<int>(FRAMEBUFFER_ALIGNMENT / sizeof(Color));
+    size_t maxBlocksX = (maxWidth + HIZ_BLOCK - 1) / HIZ_BLOCK;
+    size_t maxBlocksY = (maxHeight + HIZ_BLOCK - 1) / HIZ_BLOCK;
+    size_t maxStride = std::max<size_t>(maxBlocksX * HIZ_BLOCK, (maxWidth + lineAlign - 1) / lineAlign * lineAlign);
+    size_t pixels = maxStride * maxBlocksY * HIZ_BLOCK;
+
+    fb.color.resize(pixels);
+    fb.depth.resize(pixels * fb.depthBytes);
+    fb.hiz.resize(maxBlocksX * maxBlocksY);
+    fb.blockGeneration.resize(maxBlocksX * maxBlocksY);
+    fb.resize(maxWidth, maxHeight);
+    return fb;
+}
+
+// Buffers del render en pantalla
+Framebuffer framebuffer = makeFramebuffer(SCREEN_WIDTH, SCREEN_HEIGHT, FramebufferLayout::Linear, DepthFormat::Float32);
+
+// Cambiar la resolución interna. Los buffers se reservaron para la
+// resolución de la ventana, así que achicarlos o agrandarlos hasta ese
+// tamaño nunca vuelve a pedir memoria. El contenido queda indefinido hasta
+// el siguiente clear().
+void setRenderResolution(int width, int height) {
+    framebuffer.resize(width, height);
+    renderWidth = framebuffer.width;
+    renderHeight = framebuffer.height;
+}
+
+// Resolución interna como fracción del tamaño de la ventana
+void setRenderScale(float scale) {
+    setRenderResolution(static_cast<int>(std::lround(SCREEN_WIDTH * scale)),
+                        static_cast<int>(std::lround(SCREEN_HEIGHT * scale)));
+}
+
+// Si setRenderScale(scale) cambiaría la resolución interna
+bool renderScaleChanges(float scale) {
+    return static_cast<int>(std::lround(SCREEN_WIDTH * scale)) != renderWidth ||
+           static_cast<int>(std::lround(SCREEN_HEIGHT * scale)) != renderHeight;
+}
 
 // Limpiar el framebuffer con un color específico
 void clear(const Color& clearColor = Color(0, 0, 0)) {
-    std::fill(framebuffer.begin(), framebuffer.end(), clearColor);
-    std::fill(zbuffer.begin(), zbuffer.end(), std::numeric_limits<float>::max());
+    framebuffer.clear(clearColor);
 }
 
 // Colocar un punto (píxel) en el framebuffer con verificación de profundidad
 void point(int x, int y, float depth, const Color& color) {
-    // Verificar que el punto esté dentro de los límites de la pantalla
-    if (x >= 0 && x < SCREEN_WIDTH && y >= 0 && y < SCREEN_HEIGHT) {
-        int index = y * SCREEN_WIDTH + x;
-        
-        // Solo dibujar si este píxel está más cerca que el anterior
-        if (depth < zbuffer[index]) {
-            zbuffer[index] = depth;
-            framebuffer[index] = color;
+    framebuffer.point(x, y, depth, color);
+}
+
+// Hash FNV-1a del color y la profundidad visibles, para comparar dos
+// renders. No depende de la disposición en memoria.
+uint64_t framebufferChecksum() {
+    uint64_t hash = 1469598103934665603ull;
+    auto mix = [&hash](const void* data, size_t size) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; i++) {
+            hash = (hash ^ bytes[i]) * 1099511628211ull;
         }
+    };
+
+    Framebuffer& fb = framebuffer;
+    fb.resolve();
+    for (int y = 0; y < fb.height; y++) {
+        for (int x = 0; x < fb.width; x++) mix(&fb.color[fb.offset(x, y)], sizeof(Color));
     }
+    for (int y = 0; y < fb.height; y++) {
+        for (int x = 0; x < fb.width; x++) mix(&fb.depth[fb.offset(x, y) * fb.depthBytes], fb.depthBytes);
+    }
+    return hash;
 }
 
-// Renderizar el framebuffer en la ventana de SDL
-void renderBuffer(SDL_Renderer* renderer) {
-    // Crear una textura para el framebuffer
-    SDL_Texture* texture = SDL_CreateTexture(
-        renderer,
-        SDL_PIXELFORMAT_RGBA8888,
-        SDL_TEXTUREACCESS_STREAMING,
-        SCREEN_WIDTH,
-        SCREEN_HEIGHT
-    );
+// Textura persistente donde se sube el framebuffer cada frame. Usa
+// SDL_PIXELFORMAT_RGBA32, cuyo orden de bytes en memoria (r, g, b, a) es
+// el mismo que el de Color, así que subir el frame es una sola copia sin
+// reempaquetar píxeles. Tiene el tamaño de la ventana; un frame de menor
+// resolución ocupa sólo su esquina superior izquierda.
+SDL_Texture* frameTexture = nullptr;
+
+static_assert(sizeof(Color) == 4, "Color debe ocupar 32 bits para copiarse directo a la textura");
 
-    // Bloquear la textura para escribir en ella
-    void* texturePixels;
-    int texturePitch;
-    SDL_LockTexture(texture, NULL, &texturePixels, &texturePitch);
+// Cómo se lleva un frame de menor resolución al tamaño de la ventana
+enum UpscaleMode {
+    UPSCALE_SDL,        // El renderer de SDL escala al copiar la textura (filtro lineal)
+    UPSCALE_BILINEAR    // Pasada bilineal en CPU antes de subir la textura
+};
 
-    // Copiar el framebuffer a la textura
-    Uint32* pixelPtr = static_cast<Uint32*>(texturePixels);
-    for (int i = 0; i < SCREEN_WIDTH * SCREEN_HEIGHT; i++) {
-        // Formato RGBA8888: combinar los componentes en un Uint32
-        pixelPtr[i] = (framebuffer[i].r << 24) | 
-              (framebuffer[i].g << 16) | 
-              (framebuffer[i].b << 8) | 
-              framebuffer[i].a;
+UpscaleMode upscaleMode = UPSCALE_SDL;
+
+UpscaleMode parseUpscaleMode(const std::string& name) {
+    return name == "bilinear" ? UPSCALE_BILINEAR : UPSCALE_SDL;
+}
+
+// Parte de la textura con el último frame subido
+SDL_Rect presentedRect = {0, 0, SCREEN_WIDTH, SCREEN_HEIGHT};
+
+// Frame escalado al tamaño de la ventana (sólo UPSCALE_BILINEAR) y copia
+// fila por fila del framebuffer cuando está por bloques
+std::vector<Color> upscaleBuffer;
+std::vector<Color> linearStaging;
+
+// Filas de salida que escala cada tarea
+const int UPSCALE_ROWS_PER_TASK = 32;
+
+// Escalar src (srcWidth x srcHeight, srcStride píxeles por fila) a dst
+// (dstWidth x dstHeight) con interpolación bilineal en punto fijo de 8 bits
+void upscaleBilinear(const Color* src, int srcWidth, int srcHeight, int srcStride,
+                     Color* dst, int dstWidth, int dstHeight) {
+    // Columna de origen y peso de cada columna de salida (centros de píxel alineados)
+    std::vector<int> columns(dstWidth);
+    std::vector<int> columnWeights(dstWidth);
+    for (int x = 0; x < dstWidth; x++) {
+        float sx = std::max(0.0f, (x + 0.5f) * srcWidth / dstWidth - 0.5f);
+        int x0 = std::min(static_cast<int>(sx), srcWidth - 1);
+        columns[x] = x0;
+        columnWeights[x] = x0 + 1 < srcWidth ? static_cast<int>((sx - x0) * 256.0f) : 0;
     }
 
-    SDL_UnlockTexture(texture);
+    int tasks = (dstHeight + UPSCALE_ROWS_PER_TASK - 1) / UPSCALE_ROWS_PER_TASK;
+    renderPool().parallelFor(tasks, [&](int task, int) {
+        int firstRow = task * UPSCALE_ROWS_PER_TASK;
+        int lastRow = std::min(dstHeight, firstRow + UPSCALE_ROWS_PER_TASK);
+        for (int y = firstRow; y < lastRow; y++) {
+            float sy = std::max(0.0f, (y + 0.5f) * srcHeight / dstHeight - 0.5f);
+            int y0 = std::min(static_cast<int>(sy), srcHeight - 1);
+            int y1 = std::min(y0 + 1, srcHeight - 1);
+            int wy = static_cast<int>((sy - y0) * 256.0f);
+            const Color* row0 = src + static_cast<size_t>(y0) * srcStride;
+            const Color* row1 = src + static_cast<size_t>(y1) * srcStride;
+            Color* out = dst + static_cast<size_t>(y) * dstWidth;
+
+            for (int x = 0; x < dstWidth; x++) {
+                int x0 = columns[x];
+                int x1 = columnWeights[x] ? x0 + 1 : x0;
+                int wx = columnWeights[x];
+                const Color& a = row0[x0];
+                const Color& b = row0[x1];
+                const Color& c = row1[x0];
+                const Color& d = row1[x1];
+                auto mix = [wx, wy](int p, int q, int r, int t) {
+                    int top = p * 256 + (q - p) * wx;
+                    int bottom = r * 256 + (t - r) * wx;
+                    return (top * 256 + (bottom - top) * wy + 32768) >> 16;
+                };
+                out[x] = Color(mix(a.r, b.r, c.r, d.r), mix(a.g, b.g, c.g, d.g),
+                               mix(a.b, b.b, c.b, d.b), mix(a.a, b.a, c.a, d.a));
+            }
+        }
+    });
+}
+
+// Dejar el frame de fb (ya resuelto) listo para subir a la textura: pasar
+// a filas si está por bloques y, con UPSCALE_BILINEAR y menor resolución,
+// escalar al tamaño de la ventana. width, height y stride describen la
+// imagen devuelta.
+const Color* packFrame(Framebuffer& fb, int& width, int& height, int& stride) {
+    const Color* pixels = fb.linearColor(linearStaging, stride);
+    width = fb.width;
+    height = fb.height;
+
+    bool fullSize = fb.width == SCREEN_WIDTH && fb.height == SCREEN_HEIGHT;
+    if (fullSize || upscaleMode == UPSCALE_SDL) return pixels;
+
+    upscaleBuffer.resize(SCREEN_WIDTH * SCREEN_HEIGHT);
+    upscaleBilinear(pixels, fb.width, fb.height, stride,
+                    upscaleBuffer.data(), SCREEN_WIDTH, SCREEN_HEIGHT);
+    width = SCREEN_WIDTH;
+    height = SCREEN_HEIGHT;
+    stride = SCREEN_WIDTH;
+    return upscaleBuffer.data();
+}
+
+// Renderizar fb en la ventana de SDL
+void renderBuffer(SDL_Renderer* renderer, Framebuffer& fb = framebuffer) {
+    if (!frameTexture) {
+        // El filtro lineal sólo aplica a texturas creadas después de pedirlo
+        SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "linear");
+        frameTexture = SDL_CreateTexture(
+            renderer,
+            SDL_PIXELFORMAT_RGBA32,
+            SDL_TEXTUREACCESS_STREAMING,
+            SCREEN_WIDTH,
+            SCREEN_HEIGHT
+        );
+    }
+
+    fb.resolve();
+    PROFILE_SCOPE(PROFILE_PRESENT);
+    int width = 0, height = 0, stride = 0;
+    const Color* pixels = packFrame(fb, width, height, stride);
+    presentedRect = SDL_Rect{0, 0, width, height};
+    SDL_UpdateTexture(frameTexture, &presentedRect, pixels, stride * sizeof(Color));
 
     // Renderizar la textura en la ventana
-    SDL_RenderCopy(renderer, texture, NULL, NULL);
+    SDL_RenderCopy(renderer, frameTexture, &presentedRect, NULL);
     SDL_RenderPresent(renderer);
+}
+
+// Volver a presentar el último frame subido (por ejemplo, cuando la ventana
+// se expone de nuevo) sin copiar el framebuffer otra vez
+void presentLastFrame(SDL_Renderer* renderer) {
+    if (!frameTexture) {
+        renderBuffer(renderer);
+        return;
+    }
+    SDL_RenderCopy(renderer, frameTexture, &presentedRect, NULL);
+    SDL_RenderPresent(renderer);
+}
+
+// Liberar la textura al cerrar
+void destroyFrameTexture() {
+    if (frameTexture) {
+        SDL_DestroyTexture(frameTexture);
+        frameTexture = nullptr;
+    }
+}
 
-    // Liberar la textura
-    SDL_DestroyTexture(texture);
-}
\ No newline at end of file
+// Ritmo de frames. Si el renderer tiene vsync, SDL_RenderPresent ya espera
+// al monitor y no hace falta dormir. Si no, se duerme sólo lo que falta
+// hasta el siguiente plazo de 1/60 s, descontando lo que tardó el frame.
+struct FramePacer {
+    bool vsync = false;
+    Uint64 frequency = 0;
+    Uint64 interval = 0;
+    Uint64 deadline = 0;
+
+    void start(bool hasVsync, double targetFps = 60.0) {
+        vsync = hasVsync;
+        frequency = SDL_GetPerformanceFrequency();
+        interval = static_cast<Uint64>(frequency / targetFps);
+        deadline = SDL_GetPerformanceCounter() + interval;
+    }
+
+    // Llamar después de presentar cada frame
+    void wait() {
+        if (vsync) return;
+
+        Uint64 now = SDL_GetPerformanceCounter();
+        if (now < deadline) {
+            Uint64 remainingMs = (deadline - now) * 1000 / frequency;
+            if (remainingMs > 1) {
+                // Despertar un poco antes y esperar activamente el resto
+                SDL_Delay(static_cast<Uint32>(remainingMs - 1));
+            }
+            while (SDL_GetPerformanceCounter() < deadline) {
+            }
+            deadline += interval;
+        } else {
+            // Frame atrasado: no intentar recuperar los frames perdidos
+            deadline = now + interval;
+        }
+    }
+};
+
+// Resolución dinámica: ajusta la escala de la resolución interna para que
+// el tiempo de render (sin presentar ni esperar) quede cerca de targetMs.
+// El costo es más o menos proporcional a los píxeles, es decir al cuadrado
+// de la escala. Baja de golpe lo necesario cuando el frame se pasa y sube
+// de a un paso cuando sobra tiempo; después de cada cambio espera unos
+// frames para medir la nueva resolución antes de volver a decidir.
+struct ResolutionController {
+    static constexpr float SCALE_STEP = 0.05f;     // Múltiplos de 40x30 píxeles en 800x600
+    static constexpr int SETTLE_FRAMES = 6;
+
+    bool enabled = false;
+    float targetMs = 16.0f;
+    float minScale = 0.5f;
+    float maxScale = 1.0f;
+    float scale = 1.0f;
+    double averageMs = 0.0;     // Promedio móvil del tiempo de render
+    int settle = 0;
+
+    // Registrar el tiempo del último frame. Devuelve true si cambió scale.
+    bool update(double frameMs) {
+        if (!enabled) return false;
+        averageMs = averageMs > 0.0 ? averageMs * 0.75 + frameMs * 0.25 : frameMs;
+        if (settle > 0) {
+            settle--;
+            return false;
+        }
+
+        float wanted = scale;
+        if (averageMs > targetMs * 1.05) {
+            wanted = std::min(scale - SCALE_STEP, scale * static_cast<float>(std::sqrt(targetMs / averageMs)));
+        } else if (averageMs < targetMs * 0.8) {
+            wanted = scale + SCALE_STEP;
+        }
+        wanted = std::round(wanted / SCALE_STEP) * SCALE_STEP;
+        wanted = std::clamp(wanted, minScale, maxScale);
+        if (std::fabs(wanted - scale) < SCALE_STEP * 0.5f) return false;
+
+        scale = wanted;
+        averageMs = 0.0;
+        settle = SETTLE_FRAMES;
+        return true;
+    }
+};
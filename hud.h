@@ -0,0 +1,193 @@
+#pragma once
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "color.h"
+#include "framebuffer.h"
+#include "profiler.h"
+
+// Panel de estadísticas dibujado directo en el framebuffer, encima de la
+// escena y sin test de profundidad. Muestra los tiempos por etapa y los
+// contadores del último frame completo del perfilador.
+//
+// El texto usa una fuente de mapa de bits de 5x7 con mayúsculas, dígitos y
+// algunos signos; el resto de los caracteres se dibuja como espacio.
+
+const int HUD_GLYPH_WIDTH = 5;
+const int HUD_GLYPH_HEIGHT = 7;
+const int HUD_MARGIN = 4;
+
+struct HudGlyph {
+    char c;
+    uint8_t rows[HUD_GLYPH_HEIGHT];     // Bit 4 = columna izquierda
+};
+
+const HudGlyph HUD_FONT[] = {
+    {'A', {0x0E, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11}},
+    {'B', {0x1E, 0x11, 0x11, 0x1E, 0x11, 0x11, 0x1E}},
+    {'C', {0x0E, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0E}},
+    {'D', {0x1E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x1E}},
+    {'E', {0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x1F}},
+    {'F', {0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x10}},
+    {'G', {0x0E, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0F}},
+    {'H', {0x11, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11}},
+    {'I', {0x0E, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E}},
+    {'J', {0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0C}},
+    {'K', {0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11}},
+    {'L', {0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1F}},
+    {'M', {0x11, 0x1B, 0x15, 0x15, 0x11, 0x11, 0x11}},
+    {'N', {0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11}},
+    {'O', {0x0E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E}},
+    {'P', {0x1E, 0x11, 0x11, 0x1E, 0x10, 0x10, 0x10}},
+    {'Q', {0x0E, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0D}},
+    {'R', {0x1E, 0x11, 0x11, 0x1E, 0x14, 0x12, 0x11}},
+    {'S', {0x0F, 0x10, 0x10, 0x0E, 0x01, 0x01, 0x1E}},
+    {'T', {0x1F, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04}},
+    {'U', {0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E}},
+    {'V', {0x11, 0x11, 0x11, 0x11, 0x11, 0x0A, 0x04}},
+    {'W', {0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0A}},
+    {'X', {0x11, 0x11, 0x0A, 0x04, 0x0A, 0x11, 0x11}},
+    {'Y', {0x11, 0x11, 0x0A, 0x04, 0x04, 0x04, 0x04}},
+    {'Z', {0x1F, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1F}},
+    {'0', {0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E}},
+    {'1', {0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E}},
+    {'2', {0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F}},
+    {'3', {0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E}},
+    {'4', {0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02}},
+    {'5', {0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E}},
+    {'6', {0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E}},
+    {'7', {0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08}},
+    {'8', {0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E}},
+    {'9', {0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C}},
+    {'.', {0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C}},
+    {',', {0x00, 0x00, 0x00, 0x00, 0x0C, 0x04, 0x08}},
+    {':', {0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x0C, 0x00}},
+    {'/', {0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00}},
+    {'%', {0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03}},
+    {'-', {0x00, 0x00, 0x00, 0x1F, 0x00, 0x00, 0x00}},
+    {'=', {0x00, 0x00, 0x1F, 0x00, 0x1F, 0x00, 0x00}},
+    {'(', {0x02, 0x04, 0x08, 0x08, 0x08, 0x04, 0x02}},
+    {')', {0x08, 0x04, 0x02, 0x02, 0x02, 0x04, 0x08}},
+    {'#', {0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F}},   // Bloque lleno, para barras
+};
+
+// Filas del carácter c, o nullptr si no está en la fuente
+const uint8_t* hudGlyph(char c) {
+    char upper = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+    for (const HudGlyph& glyph : HUD_FONT) {
+        if (glyph.c == upper) return glyph.rows;
+    }
+    return nullptr;
+}
+
+// Escribir un color sin test de profundidad (recortado al framebuffer)
+inline void hudPixel(Framebuffer& fb, int x, int y, const Color& c) {
+    if (x < 0 || x >= fb.width || y < 0 || y >= fb.height) return;
+    fb.ensureBlock(x / HIZ_BLOCK, y / HIZ_BLOCK);
+    fb.color[fb.offset(x, y)] = c;
+}
+
+// Oscurecer un rectángulo para que el texto se lea sobre cualquier fondo
+void hudPanel(Framebuffer& fb, int x0, int y0, int width, int height) {
+    int x1 = std::min(x0 + width, fb.width);
+    int y1 = std::min(y0 + height, fb.height);
+    for (int y = std::max(y0, 0); y < y1; y++) {
+        // De a un tramo de bloque por vez: dentro de él la fila es contigua
+        // en las dos disposiciones
+        for (int x = std::max(x0, 0); x < x1; x = (x / HIZ_BLOCK + 1) * HIZ_BLOCK) {
+            fb.ensureBlock(x / HIZ_BLOCK, y / HIZ_BLOCK);
+            Color* row = &fb.color[fb.offset(x, y)];
+            int count = std::min(x1, (x / HIZ_BLOCK + 1) * HIZ_BLOCK) - x;
+            for (int i = 0; i < count; i++) {
+                row[i] = Color(row[i].r * 3 / 10, row[i].g * 3 / 10, row[i].b * 3 / 10, row[i].a);
+            }
+        }
+    }
+}
+
+// Dibujar text con la esquina superior izquierda en (x, y). Cada píxel de
+// la fuente ocupa scale x scale píxeles.
+void hudText(Framebuffer& fb, int x, int y, const std::string& text, const Color& c, int scale) {
+    for (char ch : text) {
+        const uint8_t* rows = hudGlyph(ch);
+        if (rows) {
+            for (int gy = 0; gy < HUD_GLYPH_HEIGHT; gy++) {
+                for (int gx = 0; gx < HUD_GLYPH_WIDTH; gx++) {
+                    if (!(rows[gy] & (0x10 >> gx))) continue;
+                    for (int sy = 0; sy < scale; sy++) {
+                        for (int sx = 0; sx < scale; sx++) {
+                            hudPixel(fb, x + gx * scale + sx, y + gy * scale + sy, c);
+                        }
+                    }
+                }
+            }
+        }
+        x += (HUD_GLYPH_WIDTH + 1) * scale;
+    }
+}
+
+// Líneas del panel a partir del último frame del perfilador
+std::vector<std::string> profilerHudLines() {
+    std::vector<std::string> lines;
+    char line[96];
+
+    if (!RENDERER_PROFILING) {
+        lines.push_back("SIN PERFILADO (RENDERER_NO_PROFILING)");
+        return lines;
+    }
+
+    const Profiler& p = profiler;
+    std::snprintf(line, sizeof(line), "FRAME %.2f MS (%.0f FPS)", p.smoothedFrameMs,
+                  p.smoothedFrameMs > 0.0 ? 1000.0 / p.smoothedFrameMs : 0.0);
+    lines.push_back(line);
+
+    // Una barra de hasta 20 bloques por etapa, proporcional al frame
+    for (int i = 0; i < PROFILE_STAGE_COUNT; i++) {
+        double ms = p.lastStageMs[i];
+        if (ms <= 0.0) continue;
+        int bar = p.lastFrameMs > 0.0 ? static_cast<int>(20.0 * ms / p.lastFrameMs + 0.5) : 0;
+        std::snprintf(line, sizeof(line), "%-9s %7.3f %s", PROFILE_STAGE_NAMES[i], ms,
+                      std::string(std::min(bar, 20), '#').c_str());
+        lines.push_back(line);
+    }
+
+    const uint64_t* c = p.lastCounters;
+    std::snprintf(line, sizeof(line), "TRI %llu ENVIADOS, %llu DESCARTADOS, %llu DIBUJADOS, %llu HI-Z",
+                  static_cast<unsigned long long>(c[COUNTER_TRIANGLES_SUBMITTED]),
+                  static_cast<unsigned long long>(c[COUNTER_TRIANGLES_CULLED]),
+                  static_cast<unsigned long long>(c[COUNTER_TRIANGLES_DRAWN]),
+                  static_cast<unsigned long long>(c[COUNTER_TRIANGLES_HIZ]));
+    lines.push_back(line);
+    std::snprintf(line, sizeof(line), "PIX %llu PROBADOS, %llu ESCRITOS",
+                  static_cast<unsigned long long>(c[COUNTER_PIXELS_TESTED]),
+                  static_cast<unsigned long long>(c[COUNTER_PIXELS_WRITTEN]));
+    lines.push_back(line);
+    std::snprintf(line, sizeof(line), "OVERDRAW %.2f", Profiler::overdraw(c));
+    lines.push_back(line);
+    return lines;
+}
+
+// Dibujar el panel con las líneas del perfilador seguidas de extra en la
+// esquina superior izquierda de fb
+void drawStatsHud(const std::vector<std::string>& extra, Framebuffer& fb = framebuffer) {
+    PROFILE_SCOPE(PROFILE_HUD);
+    std::vector<std::string> lines = profilerHudLines();
+    lines.insert(lines.end(), extra.begin(), extra.end());
+
+    int scale = fb.width >= 1200 ? 2 : 1;
+    int advance = (HUD_GLYPH_WIDTH + 1) * scale;
+    int lineHeight = (HUD_GLYPH_HEIGHT + 3) * scale;
+
+    size_t columns = 0;
+    for (const std::string& line : lines) columns = std::max(columns, line.size());
+
+    hudPanel(fb, HUD_MARGIN, HUD_MARGIN, static_cast<int>(columns) * advance + 2 * HUD_MARGIN,
+             static_cast<int>(lines.size()) * lineHeight + 2 * HUD_MARGIN);
+    for (size_t i = 0; i < lines.size(); i++) {
+        hudText(fb, 2 * HUD_MARGIN, 2 * HUD_MARGIN + static_cast<int>(i) * lineHeight, lines[i],
+                Color(230, 230, 140), scale);
+    }
+}
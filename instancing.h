@@ -0,0 +1,274 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "clusters.h"
+#include "color.h"
+#include "depthsort.h"
+#include "lod.h"
+#include "threadpool.h"
+#include "tiles.h"
+#include "vertexstage.h"
+
+// Instancias: muchas copias de una misma malla, cada una con su
+// transformación y un color que tiñe su sombreado. Los niveles de detalle y
+// sus clusters se comparten; por instancia sólo se guarda una matriz, un
+// color y el nivel de detalle que usó en el último frame.
+//
+// Por frame cada instancia se descarta primero con la esfera envolvente de
+// la malla. Las visibles se procesan por lotes en paralelo (nivel de
+// detalle, descarte de clusters, transformación y armado de triángulos) y
+// todos sus triángulos terminan en una sola lista que se ordena, reparte en
+// tiles y rasteriza de una vez. Así el costo crece con los triángulos
+// visibles y no con la cantidad de instancias.
+//
+// Las transformaciones deben ser rotación, escala uniforme y traslación:
+// las normales precalculadas de las caras no sirven con escala no uniforme.
+
+// Instancias que procesa cada tarea
+const int INSTANCE_BATCH = 256;
+
+// Malla compartida por las instancias
+struct InstancedMesh {
+    const LODChain* lods = nullptr;                     // nullptr = sólo el nivel 0
+    const std::vector<LevelGeometry>* levels = nullptr;
+    glm::vec3 center = glm::vec3(0.0f);                 // Esfera envolvente en espacio del objeto
+    float radius = 0.0f;
+    float unitScale = 1.0f;                             // Unidades del objeto por unidad del .obj
+};
+
+// Esfera que contiene todos los clusters de la malla
+void meshBoundingSphere(const ClusteredMesh& mesh, glm::vec3& center, float& radius) {
+    if (mesh.clusters.empty()) {
+        center = glm::vec3(0.0f);
+        radius = 0.0f;
+        return;
+    }
+
+    glm::vec3 low = mesh.clusters[0].center;
+    glm::vec3 high = low;
+    for (const Cluster& cluster : mesh.clusters) {
+        low = glm::min(low, cluster.center - glm::vec3(cluster.radius));
+        high = glm::max(high, cluster.center + glm::vec3(cluster.radius));
+    }
+    center = (low + high) * 0.5f;
+
+    radius = 0.0f;
+    for (const Cluster& cluster : mesh.clusters) {
+        radius = std::max(radius, glm::length(cluster.center - center) + cluster.radius);
+    }
+}
+
+// Transformaciones y colores de las instancias (SoA)
+struct InstanceBuffer {
+    std::vector<glm::mat4> transforms;      // Objeto a mundo
+    std::vector<Color> tints;
+    std::vector<uint8_t> lodLevels;         // Nivel del último frame (histéresis)
+
+    size_t size() const {
+        return transforms.size();
+    }
+
+    void clear() {
+        transforms.clear();
+        tints.clear();
+        lodLevels.clear();
+    }
+
+    void add(const glm::mat4& transform, const Color& tint) {
+        transforms.push_back(transform);
+        tints.push_back(tint);
+        lodLevels.push_back(0);
+    }
+};
+
+// Contadores de un frame de instancias
+struct InstanceStats {
+    uint64_t instances = 0;
+    uint64_t culledInstances = 0;       // Fuera del frustum por su esfera
+    uint64_t triangles = 0;             // Enviados al rasterizador
+    ClusterCullStats clusters;
+    std::vector<uint64_t> lodInstances; // Instancias visibles por nivel
+
+    void add(const InstanceStats& other) {
+        instances += other.instances;
+        culledInstances += other.culledInstances;
+        triangles += other.triangles;
+        clusters.add(other.clusters);
+        if (lodInstances.size() < other.lodInstances.size()) lodInstances.resize(other.lodInstances.size(), 0);
+        for (size_t i = 0; i < other.lodInstances.size(); i++) lodInstances[i] += other.lodInstances[i];
+    }
+};
+
+// Cámara con la que se dibujan las instancias. lightDir está en espacio de
+// vista, como la luz del modelo único.
+struct InstanceCamera {
+    glm::mat4 view, projection, viewport;
+    glm::vec3 lightDir;
+};
+
+struct InstanceTriangle {
+    glm::vec3 v0, v1, v2;
+    Color color;
+};
+
+// Color base teñido por el color de la instancia
+inline Color tintColor(const Color& base, const Color& tint) {
+    return Color(base.r * tint.r / 255, base.g * tint.g / 255, base.b * tint.b / 255, base.a);
+}
+
+// Buffers reutilizados entre frames
+struct InstanceRenderer {
+    // Salida de cada lote, en el orden de las instancias para que la imagen
+    // no dependa del reparto entre hilos
+    struct Batch {
+        std::vector<InstanceTriangle> triangles;
+        std::vector<float> depths;
+        InstanceStats stats;
+    };
+
+    // Memoria de trabajo de cada hilo
+    struct Scratch {
+        TransformedVertices vertices;
+        std::vector<uint32_t> visible;
+        std::vector<uint8_t> clipMasks;
+    };
+
+    std::vector<Batch> batches;
+    std::vector<Scratch> scratch;
+    std::vector<InstanceTriangle> triangles;    // Triángulos del último frame
+    std::vector<float> depths;
+    std::vector<uint32_t> order;
+    DepthSorter sorter;
+
+    // Procesar las instancias [first, last) y dejar sus triángulos en batch
+    template <typename ShadeFn>
+    void processBatch(const InstancedMesh& mesh, InstanceBuffer& instances, const InstanceCamera& camera,
+                      const FrustumPlanes& worldFrustum, float focal, size_t first, size_t last,
+                      ShadeFn& shade, Batch& batch, Scratch& work) {
+        int levelCount = mesh.lods ? std::min<int>(mesh.lods->levelCount(), static_cast<int>(mesh.levels->size())) : 1;
+        batch.triangles.clear();
+        batch.depths.clear();
+        batch.stats = InstanceStats();
+        batch.stats.lodInstances.assign(levelCount, 0);
+
+        for (size_t i = first; i < last; i++) {
+            const glm::mat4& model = instances.transforms[i];
+            batch.stats.instances++;
+
+            float scale = glm::length(glm::vec3(model[0]));
+            glm::vec3 center = glm::vec3(model * glm::vec4(mesh.center, 1.0f));
+            float radius = mesh.radius * scale;
+            if (sphereOutsideFrustum(worldFrustum, center, radius)) {
+                batch.stats.culledInstances++;
+                continue;
+            }
+
+            glm::mat4 mv = camera.view * model;
+            glm::mat4 mvp = camera.projection * mv;
+
+            // Nivel de detalle por el tamaño en pantalla de la parte más
+            // cercana de la esfera
+            int level = 0;
+            if (levelCount > 1) {
+                float depth = std::max(-(mv * glm::vec4(mesh.center, 1.0f)).z - radius, 0.1f);
+                float pixelsPerUnit = focal * mesh.unitScale * scale / depth;
+                level = std::min(selectLOD(*mesh.lods, pixelsPerUnit, instances.lodLevels[i]), levelCount - 1);
+                instances.lodLevels[i] = static_cast<uint8_t>(level);
+            }
+            batch.stats.lodInstances[level]++;
+            const LevelGeometry& geometry = (*mesh.levels)[level];
+
+            // Cámara y luz en espacio del objeto
+            glm::mat3 inverseLinear = glm::inverse(glm::mat3(mv));
+            glm::vec3 objectEye = -(inverseLinear * glm::vec3(mv[3]));
+            glm::vec3 objectLight = glm::normalize(inverseLinear * camera.lightDir);
+
+            cullClusters(geometry.mesh, extractFrustum(mvp), objectEye, work.visible, work.clipMasks,
+                         batch.stats.clusters);
+            if (work.visible.empty()) continue;
+
+            size_t vertexCount = geometry.mesh.positions.size();
+            if (work.vertices.screen.size() < vertexCount) {
+                work.vertices.screen.resize(vertexCount);
+                work.vertices.view.resize(vertexCount);
+            }
+            transformClusterRanges(geometry.mesh, work.visible, makeVertexTransform(mvp, mv, camera.viewport),
+                                   work.vertices);
+
+            const FaceAttributes& attributes = geometry.attributes;
+            const Color& tint = instances.tints[i];
+            assembleClusterTriangles(geometry, work.visible, work.clipMasks, work.vertices, camera.projection,
+                                     camera.viewport, objectEye, batch.stats.clusters,
+                                     [&](const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2, uint32_t face) {
+                float intensity = attributes.normalX[face] * objectLight.x +
+                                  attributes.normalY[face] * objectLight.y +
+                                  attributes.normalZ[face] * objectLight.z;
+                InstanceTriangle tri;
+                tri.v0 = v0;
+                tri.v1 = v1;
+                tri.v2 = v2;
+                tri.color = shade(tintColor(attributes.baseColor[face], tint), intensity);
+                batch.triangles.push_back(tri);
+                batch.depths.push_back((v0.z + v1.z + v2.z) / 3.0f);
+            });
+        }
+        batch.stats.triangles = batch.triangles.size();
+    }
+
+    // Dibujar todas las instancias en el framebuffer. shade(base, intensidad)
+    // calcula el color de cada cara. Los contadores se suman a stats.
+    template <typename ShadeFn>
+    void render(const InstancedMesh& mesh, InstanceBuffer& instances, const InstanceCamera& camera,
+                ShadeFn shade, InstanceStats& stats) {
+        FrustumPlanes worldFrustum = extractFrustum(camera.projection * camera.view);
+
+        // Píxeles por unidad a distancia 1 del ojo
+        float focal = camera.projection[1][1] * camera.viewport[1][1];
+
+        int batchCount = static_cast<int>((instances.size() + INSTANCE_BATCH - 1) / INSTANCE_BATCH);
+        batches.resize(batchCount);
+        scratch.resize(renderPool().size());
+
+        {
+            PROFILE_SCOPE(PROFILE_INSTANCES);
+            renderPool().parallelFor(batchCount, [&](int b, int worker) {
+                size_t first = static_cast<size_t>(b) * INSTANCE_BATCH;
+                size_t last = std::min(instances.size(), first + INSTANCE_BATCH);
+                processBatch(mesh, instances, camera, worldFrustum, focal, first, last, shade, batches[b], scratch[worker]);
+            });
+        }
+
+        // Juntar los lotes en una sola lista
+        size_t total = 0;
+        for (int b = 0; b < batchCount; b++) total += batches[b].triangles.size();
+        triangles.resize(total);
+        depths.resize(total);
+
+        size_t offset = 0;
+        for (int b = 0; b < batchCount; b++) {
+            const Batch& batch = batches[b];
+            size_t count = batch.triangles.size();
+            std::copy(batch.triangles.begin(), batch.triangles.end(), triangles.begin() + offset);
+            if (count) std::memcpy(&depths[offset], batch.depths.data(), count * sizeof(float));
+            offset += count;
+            stats.add(batch.stats);
+
+            PROFILE_COUNT(COUNTER_TRIANGLES_SUBMITTED, batch.stats.clusters.triangles);
+            PROFILE_COUNT(COUNTER_TRIANGLES_CULLED, batch.stats.clusters.frustumTriangles +
+                                                    batch.stats.clusters.coneTriangles +
+                                                    batch.stats.clusters.backfaceTriangles +
+                                                    batch.stats.clusters.clipRejected);
+        }
+        PROFILE_COUNT(COUNTER_TRIANGLES_DRAWN, total);
+
+        // Un solo orden, reparto en tiles y rasterizado para toda la flota
+        {
+            PROFILE_SCOPE(PROFILE_SORT);
+            sorter.sortFrontToBack(depths.data(), depths.size(), order);
+        }
+        rasterizeTiled(triangles, order);
+    }
+};
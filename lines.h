@@ -0,0 +1,159 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include "color.h"
+#include "framebuffer.h"
+#include "rasterizer.h"
+
+// Líneas con profundidad.
+//
+// El segmento se recorta primero al viewport con Cohen–Sutherland, así que
+// el bucle por píxel no revisa límites. Luego se recorre su eje mayor de a
+// un píxel: en cada columna (o fila) se evalúa el eje menor y la
+// profundidad en el centro del píxel a partir de los extremos, no por
+// acumulación, así que el mismo segmento dibujado por partes en distintos
+// rectángulos da exactamente los mismos píxeles que de una vez.
+//
+// La profundidad de la línea es lineal en pantalla (como la de los
+// triángulos) y se prueba contra el z-buffer sin escribirlo, con un pequeño
+// margen para que las aristas ganen sobre las caras que bordean.
+
+// Margen de profundidad (NDC) a favor de las líneas
+const float LINE_DEPTH_BIAS = 2e-4f;
+
+// Regiones de Cohen–Sutherland
+enum LineOutcode {
+    LINE_INSIDE = 0,
+    LINE_LEFT = 1,
+    LINE_RIGHT = 2,
+    LINE_TOP = 4,
+    LINE_BOTTOM = 8
+};
+
+inline int lineOutcode(float x, float y, float minX, float minY, float maxX, float maxY) {
+    int code = LINE_INSIDE;
+    if (x < minX) code |= LINE_LEFT;
+    else if (x > maxX) code |= LINE_RIGHT;
+    if (y < minY) code |= LINE_TOP;
+    else if (y > maxY) code |= LINE_BOTTOM;
+    return code;
+}
+
+// Recortar el segmento a [minX, maxX] x [minY, maxY] (Cohen–Sutherland),
+// interpolando también z. Devuelve false si no queda nada adentro.
+bool clipLine(glm::vec3& a, glm::vec3& b, float minX, float minY, float maxX, float maxY) {
+    // También descarta coordenadas NaN
+    if (!(a.x == a.x && a.y == a.y && b.x == b.x && b.y == b.y)) return false;
+
+    int codeA = lineOutcode(a.x, a.y, minX, minY, maxX, maxY);
+    int codeB = lineOutcode(b.x, b.y, minX, minY, maxX, maxY);
+
+    while (true) {
+        if (!(codeA | codeB)) return true;
+        if (codeA & codeB) return false;
+
+        // Mover el extremo de afuera al borde que cruza
+        int code = codeA ? codeA : codeB;
+        glm::vec3 p = codeA ? a : b;
+        glm::vec3 q = codeA ? b : a;
+        float t;
+        if (code & LINE_LEFT) {
+            t = (minX - p.x) / (q.x - p.x);
+        } else if (code & LINE_RIGHT) {
+            t = (maxX - p.x) / (q.x - p.x);
+        } else if (code & LINE_TOP) {
+            t = (minY - p.y) / (q.y - p.y);
+        } else {
+            t = (maxY - p.y) / (q.y - p.y);
+        }
+        glm::vec3 moved = p + (q - p) * t;
+
+        // Fijar la coordenada del borde exacta para no quedar afuera por redondeo
+        if (code & LINE_LEFT) moved.x = minX;
+        else if (code & LINE_RIGHT) moved.x = maxX;
+        else if (code & LINE_TOP) moved.y = minY;
+        else moved.y = maxY;
+
+        if (codeA) {
+            a = moved;
+            codeA = lineOutcode(a.x, a.y, minX, minY, maxX, maxY);
+        } else {
+            b = moved;
+            codeB = lineOutcode(b.x, b.y, minX, minY, maxX, maxY);
+        }
+    }
+}
+
+// Recortar al viewport de la resolución interna
+inline bool clipLineToScreen(glm::vec3& a, glm::vec3& b) {
+    return clipLine(a, b, 0.0f, 0.0f, static_cast<float>(renderWidth), static_cast<float>(renderHeight));
+}
+
+// Dibujar los píxeles de un segmento ya recortado al viewport que caen en
+// clip. Devuelve la cantidad de píxeles escritos.
+template <typename D>
+int rasterLineSetup(const glm::vec3& a, const glm::vec3& b, const Color& color, const RasterRect& clip,
+                    const RasterTarget& t) {
+    const typename D::Type* zbuf = static_cast<const typename D::Type*>(t.depth);
+    float dx = b.x - a.x;
+    float dy = b.y - a.y;
+    bool xMajor = std::abs(dx) >= std::abs(dy);
+
+    // Eje mayor (u) y menor (v) del segmento
+    float u0 = xMajor ? a.x : a.y;
+    float u1 = xMajor ? b.x : b.y;
+    float v0 = xMajor ? a.y : a.x;
+    float du = u1 - u0;
+    if (du == 0.0f) return 0;
+    float slope = (xMajor ? dy : dx) / du;
+    float dzdu = (b.z - a.z) / du;
+
+    // Píxeles cuyo centro cae dentro del segmento, limitados a clip
+    int first = static_cast<int>(std::ceil(std::min(u0, u1) - 0.5f));
+    int last = static_cast<int>(std::floor(std::max(u0, u1) - 0.5f));
+    int minU = xMajor ? clip.minX : clip.minY;
+    int maxU = xMajor ? clip.maxX : clip.maxY;
+    int minV = xMajor ? clip.minY : clip.minX;
+    int maxV = xMajor ? clip.maxY : clip.maxX;
+    first = std::max(first, minU);
+    last = std::min(last, maxU);
+
+    int tested = 0;
+    int written = 0;
+    for (int u = first; u <= last; u++) {
+        float offset = (static_cast<float>(u) + 0.5f) - u0;
+        int v = static_cast<int>(std::floor(v0 + slope * offset));
+        if (v < minV || v > maxV) continue;
+
+        int x = xMajor ? u : v;
+        int y = xMajor ? v : u;
+        if (t.lazy) t.lazy->ensureBlock(x / RASTER_BLOCK, y / RASTER_BLOCK);
+        size_t index = t.offset(x, y);
+        tested++;
+        if (D::encode(a.z + dzdu * offset - LINE_DEPTH_BIAS) < zbuf[index]) {
+            t.color[index] = color;
+            written++;
+        }
+    }
+
+    t.stats->pixelsTested += tested;
+    t.stats->pixelsWritten += written;
+    return written;
+}
+
+// Dibujar la parte de un segmento ya recortado al viewport que cae en clip
+int rasterizeLine(const glm::vec3& a, const glm::vec3& b, const Color& color, const RasterRect& clip,
+                  const RasterTarget& t) {
+    switch (t.depthFormat) {
+        case DepthFormat::Unorm24: return rasterLineSetup<DepthU24>(a, b, color, clip, t);
+        case DepthFormat::Unorm16: return rasterLineSetup<DepthU16>(a, b, color, clip, t);
+        default: return rasterLineSetup<DepthF32>(a, b, color, clip, t);
+    }
+}
+
+// Recortar y dibujar un segmento en pantalla con test de profundidad
+void depthLine(glm::vec3 a, glm::vec3 b, const Color& color) {
+    if (!clipLineToScreen(a, b)) return;
+    rasterizeLine(a, b, color, screenRect(), screenTarget());
+}
@@ -0,0 +1,444 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <queue>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "meshopt.h"
+#include "objloader.h"
+
+// Niveles de detalle (LOD) generados al cargar el modelo.
+//
+// La malla se simplifica colapsando aristas en orden de error cuadrático
+// (QEM, Garland y Heckbert): cada vértice acumula los planos de sus caras y
+// el costo de colapsar una arista es la suma de distancias al cuadrado del
+// punto resultante a esos planos. Los colapsos mueven un vértice sobre el
+// otro, así que todos los niveles comparten el arreglo de vértices original
+// y cada nivel es sólo una lista de caras.
+//
+// Cada nivel guarda su error geométrico; en cada frame se elige el nivel más
+// simple cuyo error proyectado en pantalla no supere LOD_PIXEL_ERROR, con
+// una banda de histéresis para no alternar entre dos niveles.
+//
+// La cadena se guarda junto al .obj (<archivo>.obj.lodcache) y se regenera
+// sólo si cambia el .obj.
+
+const float LOD_LEVEL_RATIO = 0.5f;         // Triángulos de un nivel respecto al anterior
+const size_t LOD_MIN_TRIANGLES = 64;        // No generar niveles más pequeños que esto
+const int LOD_MAX_LEVELS = 8;               // Niveles simplificados (sin contar el original)
+const double LOD_BOUNDARY_WEIGHT = 10.0;    // Peso de los planos que protegen los bordes abiertos
+const double LOD_MIN_NORMAL_DOT = 0.2;      // Rechazar colapsos que giren tanto una cara
+const float LOD_PIXEL_ERROR = 1.0f;         // Error proyectado tolerado (píxeles)
+const float LOD_HYSTERESIS = 0.25f;         // Banda relativa alrededor de LOD_PIXEL_ERROR
+
+struct LODLevel {
+    std::vector<Face> faces;
+    float error;            // Error geométrico estimado, en unidades del modelo
+};
+
+// Niveles simplificados; el nivel 0 es la malla original y no se copia
+struct LODChain {
+    std::vector<LODLevel> levels;
+
+    int levelCount() const {
+        return static_cast<int>(levels.size()) + 1;
+    }
+};
+
+const std::vector<Face>& lodFaces(const LODChain& chain, const std::vector<Face>& fullFaces, int level) {
+    return level <= 0 ? fullFaces : chain.levels[level - 1].faces;
+}
+
+float lodError(const LODChain& chain, int level) {
+    return level <= 0 ? 0.0f : chain.levels[level - 1].error;
+}
+
+// ---------------------------------------------------------------------------
+// Simplificación
+// ---------------------------------------------------------------------------
+
+// Matriz simétrica de 4x4 (10 coeficientes) de la suma de planos
+struct Quadric {
+    double xx = 0, xy = 0, xz = 0, xw = 0;
+    double yy = 0, yz = 0, yw = 0;
+    double zz = 0, zw = 0;
+    double ww = 0;
+
+    // Plano n·p + d = 0 con n unitario
+    void addPlane(const glm::dvec3& n, double d, double weight) {
+        xx += weight * n.x * n.x; xy += weight * n.x * n.y; xz += weight * n.x * n.z; xw += weight * n.x * d;
+        yy += weight * n.y * n.y; yz += weight * n.y * n.z; yw += weight * n.y * d;
+        zz += weight * n.z * n.z; zw += weight * n.z * d;
+        ww += weight * d * d;
+    }
+
+    void add(const Quadric& q) {
+        xx += q.xx; xy += q.xy; xz += q.xz; xw += q.xw;
+        yy += q.yy; yz += q.yz; yw += q.yw;
+        zz += q.zz; zw += q.zw;
+        ww += q.ww;
+    }
+
+    double evaluate(const glm::vec3& p) const {
+        double x = p.x, y = p.y, z = p.z;
+        double error = xx * x * x + 2.0 * xy * x * y + 2.0 * xz * x * z + 2.0 * xw * x
+                     + yy * y * y + 2.0 * yz * y * z + 2.0 * yw * y
+                     + zz * z * z + 2.0 * zw * z
+                     + ww;
+        return std::max(0.0, error);
+    }
+};
+
+// Colapso candidato: mover from sobre to. Los sellos invalidan entradas
+// viejas de la cola cuando cambia la cuádrica de alguno de los dos vértices.
+struct LODCollapse {
+    double cost;
+    int from, to;
+    uint32_t fromStamp, toStamp;
+
+    bool operator<(const LODCollapse& other) const {
+        return cost > other.cost;   // priority_queue saca primero el menor costo
+    }
+};
+
+inline uint64_t lodEdgeKey(int a, int b) {
+    if (a > b) std::swap(a, b);
+    return (static_cast<uint64_t>(static_cast<uint32_t>(a)) << 32) | static_cast<uint32_t>(b);
+}
+
+inline bool faceUses(const Face& face, int vertex) {
+    return face.vertexIndices[0] == vertex || face.vertexIndices[1] == vertex || face.vertexIndices[2] == vertex;
+}
+
+glm::dvec3 faceCross(const std::vector<glm::vec3>& vertices, const Face& face) {
+    glm::dvec3 p0 = vertices[face.vertexIndices[0]];
+    glm::dvec3 p1 = vertices[face.vertexIndices[1]];
+    glm::dvec3 p2 = vertices[face.vertexIndices[2]];
+    return glm::cross(p1 - p0, p2 - p0);
+}
+
+// Generar los niveles simplificados de una malla
+void buildLODChain(const std::vector<glm::vec3>& vertices, const std::vector<Face>& faces, LODChain& chain) {
+    chain.levels.clear();
+    size_t vertexCount = vertices.size();
+
+    std::vector<Face> work = faces;
+    std::vector<int> welded = weldVertices(vertices);
+    for (Face& face : work) {
+        for (int& index : face.vertexIndices) index = welded[index];
+    }
+    std::vector<uint8_t> faceAlive(work.size(), 1);
+    std::vector<Quadric> quadrics(vertexCount);
+    std::vector<std::vector<uint32_t>> vertexFaces(vertexCount);
+    std::unordered_map<uint64_t, int> edgeUses;
+    size_t aliveCount = 0;
+
+    // Cuádricas iniciales y caras de cada vértice
+    for (size_t f = 0; f < work.size(); f++) {
+        const auto& idx = work[f].vertexIndices;
+        glm::dvec3 cross = faceCross(vertices, work[f]);
+        double length = glm::length(cross);
+        if (idx[0] == idx[1] || idx[1] == idx[2] || idx[0] == idx[2] || length <= 0.0) {
+            faceAlive[f] = 0;
+            continue;
+        }
+        aliveCount++;
+
+        glm::dvec3 normal = cross / length;
+        double d = -glm::dot(normal, glm::dvec3(vertices[idx[0]]));
+        for (int k = 0; k < 3; k++) {
+            quadrics[idx[k]].addPlane(normal, d, 1.0);
+            vertexFaces[idx[k]].push_back(static_cast<uint32_t>(f));
+            edgeUses[lodEdgeKey(idx[k], idx[(k + 1) % 3])]++;
+        }
+    }
+
+    // Planos perpendiculares a los bordes abiertos para que no se encojan
+    for (size_t f = 0; f < work.size(); f++) {
+        if (!faceAlive[f]) continue;
+        const auto& idx = work[f].vertexIndices;
+        glm::dvec3 normal = glm::normalize(faceCross(vertices, work[f]));
+        for (int k = 0; k < 3; k++) {
+            int a = idx[k], b = idx[(k + 1) % 3];
+            if (edgeUses[lodEdgeKey(a, b)] != 1) continue;
+
+            glm::dvec3 edge = glm::dvec3(vertices[b]) - glm::dvec3(vertices[a]);
+            glm::dvec3 side = glm::cross(edge, normal);
+            double length = glm::length(side);
+            if (length <= 0.0) continue;
+            side /= length;
+            double d = -glm::dot(side, glm::dvec3(vertices[a]));
+            quadrics[a].addPlane(side, d, LOD_BOUNDARY_WEIGHT);
+            quadrics[b].addPlane(side, d, LOD_BOUNDARY_WEIGHT);
+        }
+    }
+
+    std::vector<uint32_t> stamps(vertexCount, 0);
+    std::vector<uint8_t> removed(vertexCount, 0);
+    std::priority_queue<LODCollapse> queue;
+
+    // Encolar la arista a-b en la dirección más barata
+    auto pushEdge = [&](int a, int b) {
+        Quadric q = quadrics[a];
+        q.add(quadrics[b]);
+        double costAB = q.evaluate(vertices[b]);
+        double costBA = q.evaluate(vertices[a]);
+        if (costAB <= costBA) {
+            queue.push(LODCollapse{costAB, a, b, stamps[a], stamps[b]});
+        } else {
+            queue.push(LODCollapse{costBA, b, a, stamps[b], stamps[a]});
+        }
+    };
+
+    for (const auto& entry : edgeUses) {
+        pushEdge(static_cast<int>(entry.first >> 32), static_cast<int>(entry.first & 0xFFFFFFFFu));
+    }
+    edgeUses.clear();
+
+    auto snapshot = [&](double maxCost) {
+        LODLevel level;
+        level.faces.reserve(aliveCount);
+        for (size_t f = 0; f < work.size(); f++) {
+            if (faceAlive[f]) level.faces.push_back(work[f]);
+        }
+        level.error = static_cast<float>(std::sqrt(maxCost));
+        chain.levels.push_back(std::move(level));
+    };
+
+    size_t target = static_cast<size_t>(aliveCount * LOD_LEVEL_RATIO);
+    size_t lastCount = aliveCount;
+    double maxCost = 0.0;
+
+    while (!queue.empty() && target >= LOD_MIN_TRIANGLES &&
+           static_cast<int>(chain.levels.size()) < LOD_MAX_LEVELS) {
+        LODCollapse c = queue.top();
+        queue.pop();
+        if (removed[c.from] || removed[c.to]) continue;
+        if (stamps[c.from] != c.fromStamp || stamps[c.to] != c.toStamp) continue;
+
+        // La arista debe seguir existiendo y ninguna cara que sobreviva
+        // puede darse vuelta ni quedar sin área
+        bool connected = false;
+        bool valid = true;
+        for (uint32_t f : vertexFaces[c.from]) {
+            if (!faceAlive[f]) continue;
+            if (faceUses(work[f], c.to)) {
+                connected = true;
+                continue;
+            }
+
+            Face moved = work[f];
+            for (int& index : moved.vertexIndices) {
+                if (index == c.from) index = c.to;
+            }
+            glm::dvec3 before = faceCross(vertices, work[f]);
+            glm::dvec3 after = faceCross(vertices, moved);
+            double beforeLength = glm::length(before);
+            double afterLength = glm::length(after);
+            if (afterLength <= 1e-12 * std::max(1.0, beforeLength) ||
+                glm::dot(before, after) < LOD_MIN_NORMAL_DOT * beforeLength * afterLength) {
+                valid = false;
+                break;
+            }
+        }
+        if (!connected || !valid) continue;
+
+        // Aplicar el colapso
+        maxCost = std::max(maxCost, c.cost);
+        quadrics[c.to].add(quadrics[c.from]);
+        removed[c.from] = 1;
+        stamps[c.to]++;
+
+        for (uint32_t f : vertexFaces[c.from]) {
+            if (!faceAlive[f]) continue;
+            auto& idx = work[f].vertexIndices;
+            for (int& index : idx) {
+                if (index == c.from) index = c.to;
+            }
+            if (idx[0] == idx[1] || idx[1] == idx[2] || idx[0] == idx[2]) {
+                faceAlive[f] = 0;
+                aliveCount--;
+            } else {
+                vertexFaces[c.to].push_back(f);
+            }
+        }
+        std::vector<uint32_t>().swap(vertexFaces[c.from]);
+
+        auto& around = vertexFaces[c.to];
+        around.erase(std::remove_if(around.begin(), around.end(),
+                                    [&](uint32_t f) { return !faceAlive[f]; }),
+                     around.end());
+
+        // Reencolar las aristas del vértice que cambió
+        for (uint32_t f : around) {
+            for (int index : work[f].vertexIndices) {
+                if (index != c.to) pushEdge(c.to, index);
+            }
+        }
+
+        if (aliveCount <= target) {
+            snapshot(maxCost);
+            lastCount = aliveCount;
+            target = static_cast<size_t>(aliveCount * LOD_LEVEL_RATIO);
+        }
+    }
+
+    // Si la cola se agotó antes del objetivo, guardar lo que se alcanzó
+    // cuando la reducción todavía vale la pena
+    if (static_cast<int>(chain.levels.size()) < LOD_MAX_LEVELS &&
+        aliveCount >= LOD_MIN_TRIANGLES / 2 && aliveCount < lastCount * 0.8) {
+        snapshot(maxCost);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Selección
+// ---------------------------------------------------------------------------
+
+// Nivel más simple cuyo error proyectado no supera maxPixels. pixelsPerUnit
+// convierte unidades del modelo a píxeles a la distancia actual.
+int coarsestLODWithin(const LODChain& chain, float pixelsPerUnit, float maxPixels) {
+    int level = 0;
+    for (int i = 1; i < chain.levelCount(); i++) {
+        if (lodError(chain, i) * pixelsPerUnit > maxPixels) break;
+        level = i;
+    }
+    return level;
+}
+
+// Elegir el nivel del frame. Sólo se pasa a un nivel más simple cuando su
+// error queda claramente por debajo del umbral, y sólo se vuelve a uno más
+// detallado cuando el actual lo supera claramente.
+int selectLOD(const LODChain& chain, float pixelsPerUnit, int current) {
+    int safe = coarsestLODWithin(chain, pixelsPerUnit, LOD_PIXEL_ERROR * (1.0f - LOD_HYSTERESIS));
+    int tolerated = coarsestLODWithin(chain, pixelsPerUnit, LOD_PIXEL_ERROR * (1.0f + LOD_HYSTERESIS));
+    return std::clamp(current, safe, tolerated);
+}
+
+// ---------------------------------------------------------------------------
+// Caché
+// ---------------------------------------------------------------------------
+
+// Subir la versión si cambian los parámetros de simplificación
+const char LOD_CACHE_MAGIC[8] = {'M', 'E', 'S', 'H', 'L', 'O', 'D', 'S'};
+const uint32_t LOD_CACHE_VERSION = 2;
+
+struct LODCacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t levelCount;
+    uint64_t sourceSize;
+    int64_t sourceTime;
+    uint64_t vertexCount;
+    uint64_t faceCount;
+};
+
+struct LODCacheLevel {
+    uint64_t faceCount;
+    float error;
+    uint32_t reserved;
+};
+
+std::string lodCachePath(const std::string& path) {
+    return path + ".lodcache";
+}
+
+bool readLODCache(const std::string& path, size_t vertexCount, size_t faceCount, LODChain& chain) {
+    uint64_t sourceSize;
+    int64_t sourceTime;
+    if (!sourceFileStamp(path, sourceSize, sourceTime)) return false;
+
+    FILE* file = std::fopen(lodCachePath(path).c_str(), "rb");
+    if (!file) return false;
+
+    LODCacheHeader header;
+    bool ok = std::fread(&header, sizeof(header), 1, file) == 1 &&
+              std::memcmp(header.magic, LOD_CACHE_MAGIC, sizeof(header.magic)) == 0 &&
+              header.version == LOD_CACHE_VERSION &&
+              header.sourceSize == sourceSize &&
+              header.sourceTime == sourceTime &&
+              header.vertexCount == vertexCount &&
+              header.faceCount == faceCount &&
+              header.levelCount <= static_cast<uint32_t>(LOD_MAX_LEVELS);
+
+    LODChain cached;
+    for (uint32_t i = 0; ok && i < header.levelCount; i++) {
+        LODCacheLevel info;
+        ok = std::fread(&info, sizeof(info), 1, file) == 1 && info.faceCount <= faceCount;
+        if (!ok) break;
+
+        LODLevel level;
+        level.error = info.error;
+        level.faces.resize(info.faceCount);
+        ok = std::fread(level.faces.data(), sizeof(Face), level.faces.size(), file) == level.faces.size();
+        for (const Face& face : level.faces) {
+            for (int index : face.vertexIndices) {
+                if (index < 0 || static_cast<uint64_t>(index) >= vertexCount) ok = false;
+            }
+        }
+        cached.levels.push_back(std::move(level));
+    }
+
+    std::fclose(file);
+    if (ok) chain = std::move(cached);
+    return ok;
+}
+
+void writeLODCache(const std::string& path, size_t vertexCount, size_t faceCount, const LODChain& chain) {
+    LODCacheHeader header = {};
+    std::memcpy(header.magic, LOD_CACHE_MAGIC, sizeof(header.magic));
+    header.version = LOD_CACHE_VERSION;
+    header.levelCount = static_cast<uint32_t>(chain.levels.size());
+    header.vertexCount = vertexCount;
+    header.faceCount = faceCount;
+    if (!sourceFileStamp(path, header.sourceSize, header.sourceTime)) return;
+
+    std::string cachePath = lodCachePath(path);
+    std::string tempPath = cachePath + ".tmp";
+    FILE* file = std::fopen(tempPath.c_str(), "wb");
+    if (!file) {
+        std::cerr << "Aviso: No se pudo escribir la caché " << cachePath << std::endl;
+        return;
+    }
+
+    bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1;
+    for (const LODLevel& level : chain.levels) {
+        LODCacheLevel info = {level.faces.size(), level.error, 0};
+        ok = ok && std::fwrite(&info, sizeof(info), 1, file) == 1 &&
+             std::fwrite(level.faces.data(), sizeof(Face), level.faces.size(), file) == level.faces.size();
+    }
+    ok = std::fclose(file) == 0 && ok;
+
+    std::error_code error;
+    if (ok) std::filesystem::rename(tempPath, cachePath, error);
+    if (!ok || error) {
+        std::filesystem::remove(tempPath, error);
+        std::cerr << "Aviso: No se pudo escribir la caché " << cachePath << std::endl;
+    }
+}
+
+// Leer los LOD de la caché o generarlos (y guardarlos)
+void loadLODs(const std::string& path, const std::vector<glm::vec3>& vertices, const std::vector<Face>& faces,
+              LODChain& chain, bool useCache = true) {
+    auto start = std::chrono::steady_clock::now();
+    bool fromCache = useCache && readLODCache(path, vertices.size(), faces.size(), chain);
+    if (!fromCache) {
+        buildLODChain(vertices, faces, chain);
+        if (useCache) writeLODCache(path, vertices.size(), faces.size(), chain);
+    }
+
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "LOD: " << faces.size();
+    for (const LODLevel& level : chain.levels) {
+        std::cout << " -> " << level.faces.size();
+    }
+    std::cout << " triángulos (" << ms << " ms" << (fromCache ? ", desde caché" : "") << ")" << std::endl;
+}
@@ -5,10 +5,32 @@
 #include <vector>
 #include <cmath>
 #include <algorithm>
+#include <string>
+#include <chrono>
+#include <cstdlib>
+#include <cstdio>
+#include <atomic>
 #include "color.h"
 #include "framebuffer.h"
 #include "triangle.h"
 #include "objloader.h"
+#include "tiles.h"
+#include "vertexstage.h"
+#include "bench.h"
+#include "depthsort.h"
+#include "lod.h"
+#include "faceattribs.h"
+#include "clusters.h"
+#include "instancing.h"
+#include "shading.h"
+#include "profiler.h"
+#include "hud.h"
+#include "wireframe.h"
+#include "pipeline.h"
+#include "visbuffer.h"
+#include "batch.h"
+#include "streaming.h"
+#include "bvh.h"
 
 SDL_Window* window = nullptr;
 SDL_Renderer* renderer = nullptr;
@@ -17,6 +39,10 @@ SDL_Renderer* renderer = nullptr;
 std::vector<glm::vec3> vertices;
 std::vector<Face> faces;
 
+// Vértices centrados y escalados (SoA) y su transformación del frame actual
+VertexStreams modelVertices;
+TransformedVertices frameVertices;
+
 // Variables de cámara
 float cameraAngleX = 0.3f;  // Ángulo inicial para ver mejor la nave
 float cameraAngleY = 0.0f;
@@ -30,14 +56,119 @@ float modelRotationY = 0.0f;  // Rotación Y del modelo (Q/E)
 // Luz direccional
 glm::vec3 lightDir = glm::normalize(glm::vec3(0.5f, -0.3f, 1.0f));
 
-// Estructura para almacenar un triángulo con su profundidad promedio
+// Versión de la malla; se incrementa cada vez que cambian vertices o faces
+uint64_t meshVersion = 0;
+
+// Todo lo que afecta la imagen. Si no cambió desde el último frame no hace
+// falta volver a dibujar.
+struct ViewState {
+    float cameraAngleX, cameraAngleY, cameraDistance;
+    float modelRotationY;
+    glm::vec3 lightDir;
+    uint64_t meshVersion;
+    ShadingMode shading;
+    RenderMode mode;
+    bool visibility;
+    bool hud;
+
+    // Cambios que obligan a transformar y rasterizar de nuevo
+    bool sameGeometry(const ViewState& other) const {
+        return cameraAngleX == other.cameraAngleX && cameraAngleY == other.cameraAngleY &&
+               cameraDistance == other.cameraDistance && modelRotationY == other.modelRotationY &&
+               meshVersion == other.meshVersion && shading == other.shading && mode == other.mode &&
+               visibility == other.visibility;
+    }
+
+    bool sameLight(const ViewState& other) const {
+        return lightDir.x == other.lightDir.x && lightDir.y == other.lightDir.y && lightDir.z == other.lightDir.z;
+    }
+
+    bool sameOverlay(const ViewState& other) const {
+        return hud == other.hud;
+    }
+};
+
+// Panel de estadísticas encima del frame (--hud, tecla H)
+bool hudVisible = false;
+
+// Sombreado del modelo (--shading, tecla M)
+ShadingMode shadingMode = ShadingMode::Flat;
+
+// Relleno, alambre o ambos (--render-mode, tecla F)
+RenderMode renderMode = RenderMode::Filled;
+
+ViewState currentViewState() {
+    return ViewState{cameraAngleX, cameraAngleY, cameraDistance, modelRotationY, lightDir, meshVersion,
+                     shadingMode, renderMode, visibilityBuffer, hudVisible};
+}
+
+// Niveles de detalle del modelo
+LODChain modelLODs;
+std::vector<LevelGeometry> lodGeometry;
+
+// Clusters que pasaron el descarte en el último frame y contadores
+// acumulados (quien mide decide cuándo reiniciarlos)
+std::vector<uint32_t> visibleClusters;
+std::vector<uint8_t> visibleClipMasks;
+ClusterCullStats cullStats;
+bool lodEnabled = true;
+int forcedLOD = -1;         // >= 0 fija el nivel (para pruebas)
+int currentLOD = 0;
+
+// Dibujar todos los frames aunque nada haya cambiado (para medir)
+bool continuousRender = false;
+
+// Triángulos enviados al rasterizador en el último frame armado
+size_t frameTriangles = 0;
+
+// Resolución interna dinámica (--target-ms)
+ResolutionController resolution;
+
+// Triángulo listo para rasterizar
 struct TriangleData {
     glm::vec3 v0, v1, v2;
     Color color;
-    float avgDepth;
 };
 
-void init() {
+// Lo que deja armado la primera etapa de un frame (nivel de detalle,
+// descarte, transformación, armado, color y orden) para rasterizarlo
+struct FrameGeometry {
+    // Triángulos con la cara de origen y la profundidad promedio de cada
+    // uno, y su orden de dibujo
+    std::vector<TriangleData> triangles;
+    std::vector<uint32_t> faces;
+    std::vector<float> depths;
+    std::vector<uint32_t> order;
+
+    // Los mismos triángulos con atributos por vértice, en los modos suaves
+    std::vector<ShadedTriangle<GouraudShader>> gouraud;
+    std::vector<ShadedTriangle<PhongShader>> phong;
+
+    // Aristas en los modos de alambre
+    std::vector<ScreenLine> lines;
+
+    // Rotación de espacio de vista a espacio del objeto
+    glm::mat3 inverseRotation = glm::mat3(1.0f);
+    ShadingUniforms uniforms;
+    ShadingMode shading = ShadingMode::Flat;
+    RenderMode mode = RenderMode::Filled;
+    bool visibility = false;        // Dibujar por el buffer de visibilidad
+    int lod = 0;
+};
+
+// Último frame armado y, con el pipeline, el que se está rasterizando
+FrameGeometry frameGeometry;
+FrameGeometry pipelinedGeometry;
+DepthSorter depthSorter;
+
+// Con el pipeline el frame se rasteriza en framebuffer y se presenta desde
+// aquí, mientras el siguiente ya se está rasterizando
+Framebuffer presentFramebuffer;
+bool frameInFlight = false;
+double inFlightBuildMs = 0.0;
+double pipelinedFrameMs = 0.0;      // Armado + rasterización del último frame terminado
+
+void init(bool vsync) {
     SDL_Init(SDL_INIT_VIDEO);
     window = SDL_CreateWindow("Software Renderer - Spaceship", 
                                SDL_WINDOWPOS_CENTERED, 
@@ -45,7 +176,16 @@ void init() {
                                SCREEN_WIDTH, 
                                SCREEN_HEIGHT, 
                                SDL_WINDOW_SHOWN);
-    renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
+    Uint32 flags = SDL_RENDERER_ACCELERATED;
+    if (vsync) flags |= SDL_RENDERER_PRESENTVSYNC;
+    renderer = SDL_CreateRenderer(window, -1, flags);
+}
+
+// Saber si el renderer realmente quedó con vsync
+bool rendererHasVsync() {
+    SDL_RendererInfo info;
+    if (SDL_GetRendererInfo(renderer, &info) != 0) return false;
+    return (info.flags & SDL_RENDERER_PRESENTVSYNC) != 0;
 }
 
 // Calcular el bounding box del modelo y normalizarlo
@@ -78,10 +218,12 @@ void calculateModelBounds() {
     std::cout << "Tamaño del modelo: " << modelSize.x << " x " << modelSize.y << " x " << modelSize.z << std::endl;
     std::cout << "Centro del modelo: " << modelCenter.x << ", " << modelCenter.y << ", " << modelCenter.z << std::endl;
     std::cout << "Escala del modelo: " << modelScale << std::endl;
+    
+    loadVertexStreams(vertices, modelCenter, modelScale, modelVertices);
 }
 
 // Crear matriz de modelo con rotación inicial para corregir orientación
-glm::mat4 createModelMatrix() {
+glm::mat4 createModelMatrix(float rotationY = modelRotationY) {
     glm::mat4 model = glm::mat4(1.0f);
     
     // Rotar 180 grados en Y para voltear la nave
@@ -91,16 +233,17 @@ glm::mat4 createModelMatrix() {
     model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
     
     // Aplicar rotación controlada por el usuario en el eje Y (Q/E)
-    model = glm::rotate(model, modelRotationY, glm::vec3(0.0f, 1.0f, 0.0f));
+    model = glm::rotate(model, rotationY, glm::vec3(0.0f, 1.0f, 0.0f));
     
     return model;
 }
 
 // Crear matriz de vista
-glm::mat4 createViewMatrix() {
-    float x = cameraDistance * sin(cameraAngleY) * cos(cameraAngleX);
-    float y = cameraDistance * sin(cameraAngleX);
-    float z = cameraDistance * cos(cameraAngleY) * cos(cameraAngleX);
+glm::mat4 createViewMatrix(float angleX = cameraAngleX, float angleY = cameraAngleY,
+                           float distance = cameraDistance) {
+    float x = distance * sin(angleY) * cos(angleX);
+    float y = distance * sin(angleX);
+    float z = distance * cos(angleY) * cos(angleX);
     
     glm::vec3 eye = glm::vec3(x, y, z);
     glm::vec3 center = glm::vec3(0.0f, 0.0f, 0.0f);
@@ -109,9 +252,12 @@ glm::mat4 createViewMatrix() {
     return glm::lookAt(eye, center, up);
 }
 
+// Campo de visión vertical
+const float CAMERA_FOV_DEGREES = 45.0f;
+
 // Crear matriz de proyección en perspectiva
 glm::mat4 createProjectionMatrix() {
-    float fov = glm::radians(45.0f);
+    float fov = glm::radians(CAMERA_FOV_DEGREES);
     float aspect = static_cast<float>(SCREEN_WIDTH) / static_cast<float>(SCREEN_HEIGHT);
     float near = 0.1f;
     float far = 100.0f;
@@ -123,49 +269,28 @@ glm::mat4 createProjectionMatrix() {
 glm::mat4 createViewportMatrix() {
     glm::mat4 viewport = glm::mat4(1.0f);
     
-    viewport[0][0] = SCREEN_WIDTH / 2.0f;
-    viewport[1][1] = SCREEN_HEIGHT / 2.0f;
+    viewport[0][0] = renderWidth / 2.0f;
+    viewport[1][1] = renderHeight / 2.0f;
     viewport[2][2] = 1.0f;
     
-    viewport[3][0] = SCREEN_WIDTH / 2.0f;
-    viewport[3][1] = SCREEN_HEIGHT / 2.0f;
+    viewport[3][0] = renderWidth / 2.0f;
+    viewport[3][1] = renderHeight / 2.0f;
     viewport[3][2] = 0.0f;
     
     return viewport;
 }
 
-// Transformar vértice con matrices
-glm::vec3 transformVertex(const glm::vec3& vertex, const glm::mat4& mvp, const glm::mat4& viewport) {
-    glm::vec3 centered = (vertex - modelCenter) * modelScale;
-    glm::vec4 v = glm::vec4(centered, 1.0f);
-    
-    glm::vec4 transformed = mvp * v;
-    
-    if (transformed.w != 0.0f) {
-        transformed /= transformed.w;
-    }
-    
-    glm::vec4 screen = viewport * transformed;
-    
-    return glm::vec3(screen.x, screen.y, transformed.z);
-}
-
-// Calcular la normal de un triángulo
-glm::vec3 calculateNormal(const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2) {
-    glm::vec3 edge1 = v1 - v0;
-    glm::vec3 edge2 = v2 - v0;
-    glm::vec3 normal = glm::cross(edge1, edge2);
-    
-    float length = glm::length(normal);
-    if (length > 0.0001f) {
-        normal = normal / length;
-    }
-    
-    return normal;
+// Píxeles que ocupa una unidad del modelo (del .obj) a la distancia actual.
+// Se mide en la parte del modelo más cercana a la cámara, que tras
+// normalizar queda a lo sumo a una unidad del centro.
+float modelPixelsPerUnit(float distance = cameraDistance) {
+    float focal = (renderHeight / 2.0f) / std::tan(glm::radians(CAMERA_FOV_DEGREES) / 2.0f);
+    float depth = std::max(distance - 1.0f, 0.1f);
+    return focal * modelScale / depth;
 }
 
-// Generar color tipo transbordador espacial basado en posición
-Color generateSpaceshipColor(const glm::vec3& worldPos, const glm::vec3& normal, float lightIntensity) {
+// Color base tipo transbordador espacial según la región del modelo
+Color spaceshipBaseColor(const glm::vec3& worldPos) {
     Color baseColor;
     float lateralDistance = abs(worldPos.x);
 
@@ -196,23 +321,80 @@ Color generateSpaceshipColor(const glm::vec3& worldPos, const glm::vec3& normal,
         baseColor = Color(78, 120, 122);  // Azul-verde metálico
     }
 
-    // === Iluminación ambiental + difusa ===
-    float ambientLight = 0.4f;
-    float diffuseLight = 0.6f * std::max(0.0f, lightIntensity);
-    float finalIntensity = ambientLight + diffuseLight;
-    finalIntensity = std::clamp(finalIntensity, 0.0f, 1.0f);
+    return baseColor;
+}
+
+// Partir cada nivel de detalle en clusters y precalcular los atributos de
+// sus caras
+void buildModelGeometry() {
+    auto start = std::chrono::steady_clock::now();
+    size_t clusterCount = 0;
+    double treeMs = 0.0;
+    VertexStreams levelNormals;
+
+    lodGeometry.resize(modelLODs.levelCount());
+    for (int level = 0; level < modelLODs.levelCount(); level++) {
+        LevelGeometry& geometry = lodGeometry[level];
+        buildClusters(modelVertices, lodFaces(modelLODs, faces, level), geometry.mesh);
+        buildFaceAttributes(geometry.mesh.positions, geometry.mesh.faces, spaceshipBaseColor, geometry.attributes);
+        buildVertexNormals(modelVertices, lodFaces(modelLODs, faces, level), levelNormals);
+        gatherClusterVertices(geometry.mesh, levelNormals, geometry.normals);
+        clusterCount += geometry.mesh.clusters.size();
 
-    // Aplicar la iluminación al color final
-    return Color(
-        static_cast<int>(baseColor.r * finalIntensity),
-        static_cast<int>(baseColor.g * finalIntensity),
-        static_cast<int>(baseColor.b * finalIntensity)
-    );
+        auto treeStart = std::chrono::steady_clock::now();
+        buildFaceBVH(geometry.mesh.positions, geometry.mesh.faces, geometry.faceTree);
+        treeMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - treeStart).count();
+    }
+
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Clusters: " << lodGeometry[0].mesh.clusters.size() << " en el nivel 0, "
+              << clusterCount << " en total (" << ms << " ms)" << std::endl;
+    std::cout << "Aristas: " << lodGeometry[0].mesh.edges.size() << " en el nivel 0 (de "
+              << lodGeometry[0].mesh.faces.size() * 3 << " lados de caras)" << std::endl;
+    std::cout << "BVH de caras: " << lodGeometry[0].faceTree.nodes.size() << " nodos, profundidad "
+              << lodGeometry[0].faceTree.depth << " en el nivel 0 (" << treeMs << " ms todos los niveles)" << std::endl;
 }
 
+// Calcular el color de los triángulos del frame con la luz actual: un
+// producto punto en espacio del objeto por triángulo
+void shadeTriangles(FrameGeometry& frame) {
+    PROFILE_SCOPE(PROFILE_SHADE);
+    const FaceAttributes& attributes = lodGeometry[frame.lod].attributes;
+    glm::vec3 objectLight = frame.inverseRotation * lightDir;
+    
+    for (size_t t = 0; t < frame.triangles.size(); t++) {
+        uint32_t i = frame.faces[t];
+        float intensity = attributes.normalX[i] * objectLight.x +
+                          attributes.normalY[i] * objectLight.y +
+                          attributes.normalZ[i] * objectLight.z;
+        frame.triangles[t].color = shadeColor(attributes.baseColor[i], intensity);
+    }
+}
 
+// Armar los triángulos visibles del frame con los atributos por vértice
+// del shader S (los clusters ya están descartados y transformados)
+template <typename S>
+void assembleShadedTriangles(const LevelGeometry& geometry, const glm::mat4& projection, const glm::mat4& viewport,
+                             const glm::vec3& objectEye, const ShadingUniforms& uniforms, ClusterCullStats& stats,
+                             std::vector<float>& depths, std::vector<ShadedTriangle<S>>& out) {
+    out.clear();
+    assembleClusterTriangles(geometry, visibleClusters, visibleClipMasks, frameVertices, projection, viewport,
+                             objectEye, stats,
+                             [&](const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2, uint32_t face,
+                                 const TriangleCorners& corners) {
+        ShadedTriangle<S> tri;
+        makeShadedTriangle(v0, v1, v2, geometry.attributes.baseColor[face], corners, geometry.normals,
+                           uniforms, tri);
+        out.push_back(tri);
+        depths.push_back((v0.z + v1.z + v2.z) / 3.0f);
+    });
+}
 
-void render() {
+// Primera etapa del frame: nivel de detalle, descarte, transformación,
+// armado de triángulos y aristas, color y orden de dibujo. No toca el
+// framebuffer, así que con el pipeline corre mientras se rasteriza el
+// frame anterior.
+void buildFrame(FrameGeometry& frame) {
     // Crear matrices de transformación
     glm::mat4 model = createModelMatrix();
     glm::mat4 view = createViewMatrix();
@@ -221,71 +403,222 @@ void render() {
     glm::mat4 mvp = projection * view * model;
     glm::mat4 mv = view * model;
     
-    // Vector para almacenar todos los triángulos
-    std::vector<TriangleData> triangles;
-    triangles.reserve(faces.size());
+    // Nivel de detalle según el tamaño en pantalla
+    ClusterCullStats frameCull;
+    {
+        PROFILE_SCOPE(PROFILE_CULL);
+        if (!lodEnabled) {
+            currentLOD = 0;
+        } else if (forcedLOD >= 0) {
+            currentLOD = std::min(forcedLOD, modelLODs.levelCount() - 1);
+        } else {
+            currentLOD = selectLOD(modelLODs, modelPixelsPerUnit(), currentLOD);
+        }
+    }
+    frame.lod = currentLOD;
+    const LevelGeometry& geometry = lodGeometry[currentLOD];
     
-    // Transformar todos los triángulos
-    for (size_t i = 0; i < faces.size(); i++) {
-        const auto& face = faces[i];
-        
-        if (face.vertexIndices.size() >= 3) {
-            glm::vec3 v0_original = vertices[face.vertexIndices[0]];
-            glm::vec3 v1_original = vertices[face.vertexIndices[1]];
-            glm::vec3 v2_original = vertices[face.vertexIndices[2]];
-            
-            // Transformar vértices
-            glm::vec3 v0 = transformVertex(v0_original, mvp, viewport);
-            glm::vec3 v1 = transformVertex(v1_original, mvp, viewport);
-            glm::vec3 v2 = transformVertex(v2_original, mvp, viewport);
-            
-            // Calcular normal en espacio de vista
-            glm::vec3 v0_centered = (v0_original - modelCenter) * modelScale;
-            glm::vec3 v1_centered = (v1_original - modelCenter) * modelScale;
-            glm::vec3 v2_centered = (v2_original - modelCenter) * modelScale;
-            
-            glm::vec3 v0_view = glm::vec3(mv * glm::vec4(v0_centered, 1.0f));
-            glm::vec3 v1_view = glm::vec3(mv * glm::vec4(v1_centered, 1.0f));
-            glm::vec3 v2_view = glm::vec3(mv * glm::vec4(v2_centered, 1.0f));
-            
-            glm::vec3 normal = calculateNormal(v0_view, v1_view, v2_view);
-            
-            // Backface culling
-            glm::vec3 faceCenter = (v0_view + v1_view + v2_view) / 3.0f;
-            glm::vec3 viewDir = glm::normalize(-faceCenter);
-            
-            if (glm::dot(normal, viewDir) > 0.0f) {
-                float avgDepth = (v0.z + v1.z + v2.z) / 3.0f;
-                
-                // Calcular posición promedio en espacio mundo para determinar color
-                glm::vec3 worldPos = (v0_centered + v1_centered + v2_centered) / 3.0f;
-                
-                // Calcular intensidad de luz
-                float intensity = glm::dot(normal, lightDir);
-                
-                // Generar color tipo transbordador
-                Color color = generateSpaceshipColor(worldPos, normal, intensity);
-                
-                TriangleData tri;
-                tri.v0 = v0;
-                tri.v1 = v1;
-                tri.v2 = v2;
-                tri.color = color;
-                tri.avgDepth = avgDepth;
-                triangles.push_back(tri);
-            }
+    // Cámara en espacio del objeto. mv es una rotación más una traslación,
+    // así que su inversa es la transpuesta.
+    frame.inverseRotation = glm::transpose(glm::mat3(mv));
+    glm::vec3 objectEye = -(frame.inverseRotation * glm::vec3(mv[3]));
+    
+    // Descartar clusters fuera del frustum o de espaldas y transformar sólo
+    // los vértices de los que quedan
+    {
+        PROFILE_SCOPE(PROFILE_CULL);
+        cullClusters(geometry.mesh, extractFrustum(mvp), objectEye, visibleClusters, visibleClipMasks, frameCull);
+    }
+    {
+        PROFILE_SCOPE(PROFILE_TRANSFORM);
+        transformClusters(geometry.mesh, visibleClusters, mvp, mv, viewport, frameVertices);
+    }
+    
+    frame.triangles.clear();
+    frame.faces.clear();
+    frame.depths.clear();
+    frame.uniforms.lightDir = glm::normalize(frame.inverseRotation * lightDir);
+    
+    // En el modo de alambre los triángulos sólo dejan su profundidad: no
+    // hace falta sombrearlos
+    frame.mode = renderMode;
+    bool depthOnly = renderMode == RenderMode::Wireframe;
+    frame.shading = depthOnly ? ShadingMode::Flat : shadingMode;
+    frame.visibility = visibilityBuffer && !depthOnly;
+    
+    // Armar los triángulos a partir de los vértices transformados
+    {
+        PROFILE_SCOPE(PROFILE_ASSEMBLE);
+        switch (frame.shading) {
+            case ShadingMode::Gouraud:
+                assembleShadedTriangles(geometry, projection, viewport, objectEye, frame.uniforms, frameCull,
+                                        frame.depths, frame.gouraud);
+                break;
+            case ShadingMode::Phong:
+                assembleShadedTriangles(geometry, projection, viewport, objectEye, frame.uniforms, frameCull,
+                                        frame.depths, frame.phong);
+                break;
+            default:
+                assembleClusterTriangles(geometry, visibleClusters, visibleClipMasks, frameVertices, projection,
+                                         viewport, objectEye, frameCull,
+                                         [&](const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2, uint32_t face) {
+                    TriangleData tri;
+                    tri.v0 = v0;
+                    tri.v1 = v1;
+                    tri.v2 = v2;
+                    frame.triangles.push_back(tri);
+                    frame.faces.push_back(face);
+                    frame.depths.push_back((v0.z + v1.z + v2.z) / 3.0f);
+                });
+                break;
         }
     }
+    frameTriangles = frame.depths.size();
+    cullStats.add(frameCull);
+    PROFILE_COUNT(COUNTER_TRIANGLES_SUBMITTED, frameCull.triangles);
+    PROFILE_COUNT(COUNTER_TRIANGLES_CULLED, frameCull.frustumTriangles + frameCull.coneTriangles +
+                                            frameCull.backfaceTriangles + frameCull.clipRejected);
+    PROFILE_COUNT(COUNTER_TRIANGLES_DRAWN, frameTriangles);
+    if (frame.shading == ShadingMode::Flat && !depthOnly) shadeTriangles(frame);
     
-    // Ordenar por profundidad
-    std::sort(triangles.begin(), triangles.end(), 
-              [](const TriangleData& a, const TriangleData& b) {
-                  return a.avgDepth > b.avgDepth;
-              });
+    // Ordenar de adelante hacia atrás para que el Hi-Z descarte lo tapado
+    {
+        PROFILE_SCOPE(PROFILE_SORT);
+        depthSorter.sortFrontToBack(frame.depths.data(), frame.depths.size(), frame.order);
+    }
     
-    // Renderizar
-    for (const auto& tri : triangles) {
-        triangle(tri.v0, tri.v1, tri.v2, tri.color);
+    // Aristas de los clusters visibles
+    if (renderMode != RenderMode::Filled) {
+        PROFILE_SCOPE(PROFILE_ASSEMBLE);
+        const FaceAttributes& attributes = geometry.attributes;
+        assembleClusterLines(geometry.mesh, visibleClusters, visibleClipMasks, frameVertices, projection,
+                             viewport, [&](uint32_t face) {
+            return depthOnly ? attributes.baseColor[face] : WIREFRAME_OVERLAY_COLOR;
+        }, frame.lines);
+    } else {
+        frame.lines.clear();
+    }
+}
+
+// Segunda etapa: rasterizar el frame armado en framebuffer (ya borrado)
+// Dibujar los triángulos del frame por tiles en paralelo: directamente o
+// por el buffer de visibilidad
+void drawFrameTriangles(const FrameGeometry& frame) {
+    if (frame.visibility) {
+        switch (frame.shading) {
+            case ShadingMode::Gouraud: drawVisibility(frame.gouraud, frame.order, gouraudVisibility); break;
+            case ShadingMode::Phong: drawVisibility(frame.phong, frame.order, phongVisibility); break;
+            default: drawVisibility(frame.triangles, frame.order); break;
+        }
+        return;
+    }
+
+    bool depthOnly = frame.mode == RenderMode::Wireframe;
+    switch (frame.shading) {
+        case ShadingMode::Gouraud: rasterizeTiled(frame.gouraud, frame.order); break;
+        case ShadingMode::Phong: rasterizeTiled(frame.phong, frame.order); break;
+        default: rasterizeTiled(frame.triangles, frame.order, depthOnly); break;
+    }
+}
+
+void rasterizeFrame(const FrameGeometry& frame) {
+    shadingUniforms = frame.uniforms;
+    drawFrameTriangles(frame);
+    
+    // Aristas probadas contra esa profundidad
+    if (frame.mode != RenderMode::Filled) rasterizeLinesTiled(frame.lines);
+}
+
+void render() {
+    buildFrame(frameGeometry);
+    rasterizeFrame(frameGeometry);
+}
+
+// Volver a dibujar el último frame con otra luz. La geometría, el nivel de
+// detalle, el orden y el reparto en tiles no cambian, así que sólo se
+// recalcula el color de cada triángulo y se rasteriza de nuevo.
+void reshade() {
+    FrameGeometry& frame = frameGeometry;
+    if (frame.mode == RenderMode::Wireframe) {
+        // Las aristas no dependen de la luz: repetir la profundidad y las líneas
+        rasterizeBinned(frame.triangles, true);
+        rasterizeLinesTiled(frame.lines);
+        return;
+    }
+
+    switch (frame.shading) {
+        case ShadingMode::Gouraud:
+            // La luz está en los atributos de los vértices: armar de nuevo
+            // (con las aristas, si van encima)
+            render();
+            return;
+        case ShadingMode::Phong:
+            // La luz sólo la usa el shader de píxeles
+            frame.uniforms.lightDir = glm::normalize(frame.inverseRotation * lightDir);
+            shadingUniforms = frame.uniforms;
+            if (frame.visibility) drawFrameTriangles(frame);
+            else rasterizeBinned(frame.phong);
+            break;
+        default:
+            shadeTriangles(frame);
+            if (frame.visibility) drawFrameTriangles(frame);
+            else rasterizeBinned(frame.triangles);
+            break;
+    }
+    if (frame.mode == RenderMode::Overlay) rasterizeLinesTiled(frame.lines);
+}
+
+// Cara elegida con el clic izquierdo. Se resalta cambiando su color base
+// en su nivel de detalle, así que sólo se ve mientras se dibuja ese nivel.
+struct FacePick {
+    int level = -1;             // -1 = ninguna
+    uint32_t face = 0;
+    Color baseColor;            // Color original de la cara
+};
+
+FacePick pickedFace;
+const Color PICK_HIGHLIGHT_COLOR(255, 140, 0);
+
+// Rayo por el píxel (x, y) de la ventana con la cámara actual, en espacio
+// del objeto
+BVHRay pickRay(int x, int y) {
+    glm::mat4 screen = createViewportMatrix() * createProjectionMatrix() * createViewMatrix() * createModelMatrix();
+    float px = (x + 0.5f) * renderWidth / SCREEN_WIDTH;
+    float py = (y + 0.5f) * renderHeight / SCREEN_HEIGHT;
+    return rayThroughPixel(glm::inverse(screen), px, py);
+}
+
+// Resaltar face del nivel level (-1 = ninguna) y devolver su color a la anterior
+void highlightFace(int level, int face) {
+    if (pickedFace.level >= 0) {
+        lodGeometry[pickedFace.level].attributes.baseColor[pickedFace.face] = pickedFace.baseColor;
+        pickedFace.level = -1;
+    }
+    if (face >= 0) {
+        Color& color = lodGeometry[level].attributes.baseColor[face];
+        pickedFace.level = level;
+        pickedFace.face = static_cast<uint32_t>(face);
+        pickedFace.baseColor = color;
+        color = PICK_HIGHLIGHT_COLOR;
+    }
+    meshVersion++;
+}
+
+// Elegir la cara bajo el cursor en el nivel del último frame armado
+void pickAt(int x, int y) {
+    int level = frameGeometry.lod;
+    const LevelGeometry& geometry = lodGeometry[level];
+    auto start = std::chrono::steady_clock::now();
+    FacePickResult hit = pickFace(geometry.faceTree, geometry.mesh.positions, geometry.mesh.faces, pickRay(x, y));
+    double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+    highlightFace(level, hit.face);
+    if (hit.face < 0) {
+        std::cout << "Selección: ninguna cara (" << us << " µs)" << std::endl;
+    } else {
+        std::cout << "Selección: cara " << hit.face << " del nivel " << level << " a " << hit.distance
+                  << " unidades (" << us << " µs, " << hit.nodes << " nodos y " << hit.triangles
+                  << " triángulos probados)" << std::endl;
     }
 }
 
@@ -297,6 +630,10 @@ void handleInput(SDL_Event& event, bool& running) {
     if (event.type == SDL_QUIT) {
         running = false;
     }
+
+    if (event.type == SDL_MOUSEBUTTONDOWN && event.button.button == SDL_BUTTON_LEFT) {
+        pickAt(event.button.x, event.button.y);
+    }
     
     if (event.type == SDL_KEYDOWN) {
         switch (event.key.keysym.sym) {
@@ -370,46 +707,1070 @@ void handleInput(SDL_Event& event, bool& running) {
                 lightDir = glm::normalize(glm::vec3(0.0f, -1.0f, 0.5f));
                 std::cout << "Luz: Inferior" << std::endl;
                 break;
+
+            // Panel de estadísticas
+            case SDLK_h:
+                hudVisible = !hudVisible;
+                break;
+
+            // Sombreado: plano, Gouraud, Phong
+            case SDLK_m:
+                shadingMode = static_cast<ShadingMode>((static_cast<int>(shadingMode) + 1) % 3);
+                std::cout << "Sombreado: " << shadingModeName(shadingMode) << std::endl;
+                break;
+
+            // Relleno, alambre, alambre encima del relleno
+            case SDLK_f:
+                renderMode = static_cast<RenderMode>((static_cast<int>(renderMode) + 1) % 3);
+                std::cout << "Modo: " << renderModeName(renderMode) << std::endl;
+                break;
+
+            // Camino directo o buffer de visibilidad
+            case SDLK_v:
+                visibilityBuffer = !visibilityBuffer;
+                std::cout << "Buffer de visibilidad: " << (visibilityBuffer ? "sí" : "no") << std::endl;
+                break;
+        }
+    }
+}
+
+// Guardar el frame de fb como imagen
+bool saveFrame(const std::string& path, Framebuffer& fb = framebuffer) {
+    int stride = 0;
+    const Color* pixels = fb.linearColor(linearStaging, stride);
+    return writeImage(path, pixels, fb.width, fb.height, stride);
+}
+
+void printFramebufferFormat() {
+    std::cout << "Framebuffer: " << framebufferLayoutName(framebuffer.layout) << ", profundidad "
+              << depthFormatName(framebuffer.depthFormat) << ", borrado "
+              << (framebuffer.lazyClear ? "diferido" : "inmediato") << std::endl;
+}
+
+// Dibujar en fb el panel de estadísticas con el estado del modelo único
+// (el de frameGeometry, que es el frame que está en fb)
+void drawModelHud(Framebuffer& fb = framebuffer) {
+    const FrameGeometry& frame = frameGeometry;
+    char line[96];
+    std::snprintf(line, sizeof(line), "RES %dX%d  LOD %d  %s  %s  %s%s%s", fb.width, fb.height, frame.lod,
+                  rasterPathName(rasterPath), shadingModeName(shadingMode), renderModeName(frame.mode),
+                  frame.visibility ? "  VISBUFFER" : "", framePipelining ? "  PIPELINE" : "");
+    std::vector<std::string> lines = {line};
+    if (frame.mode != RenderMode::Filled) {
+        std::snprintf(line, sizeof(line), "ARISTAS %zu", frame.lines.size());
+        lines.push_back(line);
+    }
+    drawStatsHud(lines, fb);
+}
+
+// Mostrar fb en la ventana con el panel de estadísticas (el del frame
+// anterior, que es el último medido completo)
+void showFrame(Framebuffer& fb) {
+    if (hudVisible) drawModelHud(fb);
+    renderBuffer(renderer, fb);
+}
+
+// Terminar el frame en la ventana
+void presentFrame() {
+    showFrame(framebuffer);
+    PROFILE_END_FRAME();
+}
+
+// Enviar a la rasterización el frame recién armado en frameGeometry. Antes
+// se espera el frame anterior, si lo había: queda en presentFramebuffer, y
+// su geometría en frameGeometry, para presentarlo mientras se rasteriza el
+// nuevo. Devuelve si había uno.
+bool pipelineFrame(double buildMs) {
+    bool finished = frameInFlight;
+    FrameStageThread& stage = rasterStage();
+    if (frameInFlight) {
+        stage.wait();
+        PROFILE_MERGE_PIPELINE();
+        std::swap(framebuffer, presentFramebuffer);
+        pipelinedFrameMs = inFlightBuildMs + stage.lastMs();
+    }
+    std::swap(frameGeometry, pipelinedGeometry);
+
+    // El framebuffer que vuelve pudo quedar de otra resolución
+    if (framebuffer.width != renderWidth || framebuffer.height != renderHeight) {
+        framebuffer.resize(renderWidth, renderHeight);
+    }
+    inFlightBuildMs = buildMs;
+    frameInFlight = true;
+    stage.submit([] {
+        clear(Color(10, 10, 15));
+        rasterizeFrame(pipelinedGeometry);
+        framebuffer.resolve();
+    });
+    return finished;
+}
+
+// Esperar el frame en vuelo. Queda en framebuffer y frameGeometry, igual
+// que si se hubiera dibujado sin pipeline. Devuelve false si no había.
+bool drainPipeline() {
+    if (!frameInFlight) return false;
+    FrameStageThread& stage = rasterStage();
+    stage.wait();
+    PROFILE_MERGE_PIPELINE();
+    pipelinedFrameMs = inFlightBuildMs + stage.lastMs();
+    std::swap(frameGeometry, pipelinedGeometry);
+    frameInFlight = false;
+    return true;
+}
+
+// Lo mismo en la ventana, presentando el frame que estaba en vuelo
+void finishPipelinedFrame() {
+    if (drainPipeline()) showFrame(framebuffer);
+}
+
+// Guardar la traza de --trace, si se pidió
+void writeTrace(const std::string& path) {
+    if (path.empty()) return;
+    if (!RENDERER_PROFILING) {
+        std::cerr << "Error: --trace necesita compilar sin RENDERER_NO_PROFILING" << std::endl;
+        return;
+    }
+    if (profiler.writeChromeTrace(path)) {
+        std::cout << "Traza guardada en " << path << " (" << profiler.events.size() << " eventos)" << std::endl;
+    }
+}
+
+// Medir cómo escala el render de 1 a maxThreads hilos. Además verifica que
+// todas las cantidades de hilos produzcan exactamente la misma imagen.
+void runScalingReport(int maxThreads, int frames) {
+    std::cout << "\n=== ESCALADO (" << frames << " frames por prueba) ===" << std::endl;
+
+    double baseMs = 0.0;
+    uint64_t baseChecksum = 0;
+
+    for (int threads = 1; threads <= maxThreads; threads++) {
+        renderThreads = threads;
+        renderPool();
+
+        uint64_t checksum = 0;
+        double totalMs = 0.0;
+        for (int frame = 0; frame < frames; frame++) {
+            // Cámara en movimiento para no medir siempre el mismo frame
+            cameraAngleY = frame * 0.05f;
+
+            auto start = std::chrono::steady_clock::now();
+            clear(Color(10, 10, 15));
+            render();
+            framebuffer.resolve();
+            auto end = std::chrono::steady_clock::now();
+            totalMs += std::chrono::duration<double, std::milli>(end - start).count();
+
+            checksum ^= framebufferChecksum() + frame;
         }
+        double ms = totalMs / frames;
+
+        if (threads == 1) {
+            baseMs = ms;
+            baseChecksum = checksum;
+        }
+
+        std::cout << threads << " hilos: " << ms << " ms/frame, speedup "
+                  << baseMs / ms << "x"
+                  << (checksum == baseChecksum ? "" : "  (IMAGEN DISTINTA)") << std::endl;
+    }
+
+    cameraAngleY = 0.0f;
+}
+
+// Cámara scriptada y determinista para el modo sin ventana: una vuelta
+// completa alrededor de la nave acercándose y alejándose
+void applyBenchCamera(int frame, int frames) {
+    const float pi = 3.14159265f;
+    float t = frames > 1 ? static_cast<float>(frame) / (frames - 1) : 0.0f;
+
+    cameraAngleY = t * 2.0f * pi;
+    cameraAngleX = 0.3f + 0.4f * std::sin(t * 4.0f * pi);
+    cameraDistance = 3.5f + 2.5f * std::sin(t * 2.0f * pi);
+    modelRotationY = t * pi;
+}
+
+// Promedios por frame de los descartes antes de rasterizar
+void printCullStats(const ClusterCullStats& stats, int frames) {
+    double n = std::max(1, frames);
+    std::cout << "Clusters por frame: " << stats.clusters / n << ", descartados "
+              << stats.frustumClusters / n << " por frustum y "
+              << stats.coneClusters / n << " por cono de normales" << std::endl;
+    std::cout << "Triángulos por frame: " << stats.triangles / n << ", descartados "
+              << stats.frustumTriangles / n << " por frustum, "
+              << stats.coneTriangles / n << " por cono y "
+              << stats.backfaceTriangles / n << " de espaldas uno a uno" << std::endl;
+    std::cout << "Recorte por frame: " << stats.clipTested / n << " triángulos revisados, "
+              << stats.clipped / n << " recortados, " << stats.clipRejected / n << " descartados" << std::endl;
+}
+
+// Promedios por frame de los contadores del rasterizador
+void printRasterStats(const RasterStats& stats, int frames) {
+    double n = std::max(1, frames);
+    std::cout << "Hi-Z " << (rasterHiZ ? "activo" : "desactivado") << ": "
+              << stats.trianglesRejected / n << " triángulos (por tile), "
+              << stats.blocksRejected / n << " bloques, "
+              << stats.pixelsHiZRejected / n << " píxeles descartados por frame" << std::endl;
+    std::cout << "Test de profundidad: " << stats.pixelsTested / n << " píxeles probados, "
+              << stats.pixelsWritten / n << " escritos por frame ("
+              << (stats.pixelsTested ? 100.0 * stats.pixelsWritten / stats.pixelsTested : 0.0)
+              << "% pasan)" << std::endl;
+}
+
+// Renderizar frames sin ventana siguiendo la cámara scriptada y reportar
+// tiempos. Los frames de dumpFrames se guardan como imagen.
+void runHeadless(int frames, const std::vector<int>& dumpFrames, const std::string& dumpPrefix,
+                 const std::string& dumpExtension) {
+    std::cout << "\n=== BENCHMARK SIN VENTANA ===" << std::endl;
+    std::cout << "Rasterizador: " << rasterPathName(rasterPath) << ", hilos: " << renderPool().size()
+              << ", sombreado: " << shadingModeName(shadingMode) << ", modo: " << renderModeName(renderMode)
+              << ", pipeline: " << (framePipelining ? "sí" : "no")
+              << ", visibilidad: " << (visibilityBuffer ? "sí" : "no") << std::endl;
+    printFramebufferFormat();
+
+    // Calentar cachés y el pool de hilos
+    for (int i = 0; i < 5; i++) {
+        applyBenchCamera(0, frames);
+        clear(Color(10, 10, 15));
+        render();
+    }
+
+    std::vector<double> frameMs;
+    frameMs.reserve(frames);
+    uint64_t triangles = 0;
+    rasterStats = RasterStats();
+    cullStats = ClusterCullStats();
+    profiler.resetTotals();
+    std::vector<int> lodFrames(modelLODs.levelCount(), 0);
+    double scaleSum = 0.0;
+    int scaleChanges = 0;
+
+    // Panel y, si se pidió, imagen de un frame ya rasterizado en fb. Con el
+    // pipeline el frame N termina durante la vuelta N + 1.
+    auto finishFrame = [&](int frame, Framebuffer& fb) {
+        if (hudVisible) drawModelHud(fb);
+        if (std::find(dumpFrames.begin(), dumpFrames.end(), frame) != dumpFrames.end()) {
+            char number[16];
+            std::snprintf(number, sizeof(number), "%04d", frame);
+            std::string path = dumpPrefix + number + dumpExtension;
+            if (saveFrame(path, fb)) {
+                std::cout << "Guardado " << path << std::endl;
+            }
+        }
+    };
+
+    for (int frame = 0; frame < frames; frame++) {
+        applyBenchCamera(frame, frames);
+        if (resolution.enabled && renderScaleChanges(resolution.scale)) {
+            // Los dos framebuffers del pipeline deben tener la misma resolución
+            if (drainPipeline()) finishFrame(frame - 1, framebuffer);
+            setRenderScale(resolution.scale);
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        PROFILE_BEGIN_FRAME();
+        if (framePipelining) {
+            buildFrame(frameGeometry);
+            double buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            if (pipelineFrame(buildMs)) finishFrame(frame - 1, presentFramebuffer);
+        } else {
+            clear(Color(10, 10, 15));
+            render();
+            framebuffer.resolve();
+            finishFrame(frame, framebuffer);
+        }
+        PROFILE_END_FRAME();
+        auto end = std::chrono::steady_clock::now();
+
+        double ms = std::chrono::duration<double, std::milli>(end - start).count();
+        frameMs.push_back(ms);
+        triangles += frameTriangles;
+        lodFrames[currentLOD]++;
+        scaleSum += static_cast<double>(renderWidth) / SCREEN_WIDTH;
+        if (resolution.update(ms)) scaleChanges++;
+    }
+
+    // El último frame del pipeline: su espera cuenta para el último tiempo
+    auto start = std::chrono::steady_clock::now();
+    if (drainPipeline()) {
+        finishFrame(frames - 1, framebuffer);
+        frameMs.back() += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    printFrameStats(frameMs, triangles);
+    printCullStats(cullStats, frames);
+    printRasterStats(rasterStats, frames);
+    if (RENDERER_PROFILING) profiler.printSummary();
+
+    std::cout << "Frames por nivel de LOD:";
+    for (int level = 0; level < modelLODs.levelCount(); level++) {
+        std::cout << " " << level << "=" << lodFrames[level];
+    }
+    std::cout << std::endl;
+
+    std::cout << "Resolución interna promedio: " << 100.0 * scaleSum / frames << "% de "
+              << SCREEN_WIDTH << "x" << SCREEN_HEIGHT;
+    if (resolution.enabled) {
+        std::cout << " (objetivo " << resolution.targetMs << " ms, " << scaleChanges << " cambios, final "
+                  << renderWidth << "x" << renderHeight << ")";
+    }
+    std::cout << std::endl;
+}
+
+// Medir el BVH: construcción en cada nivel, descarte por frustum con y sin
+// el árbol de clusters a lo largo de la cámara scriptada, y rayos de
+// selección por una rejilla de píxeles contra la prueba de todas las caras
+void runBVHBenchmark(int frames) {
+    const int cullRepeats = 20;
+    const int rayStep = 8;              // Un rayo cada rayStep píxeles
+    const int linearEvery = 32;         // Uno de cada linearEvery rayos se repite sin el árbol
+    const int pickPoses = 8;
+    auto since = [](std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    std::cout << "\n=== BVH ===" << std::endl;
+    for (int level = 0; level < static_cast<int>(lodGeometry.size()); level++) {
+        const LevelGeometry& geometry = lodGeometry[level];
+        auto start = std::chrono::steady_clock::now();
+        BVH faceTree;
+        buildFaceBVH(geometry.mesh.positions, geometry.mesh.faces, faceTree);
+        double faceMs = since(start);
+
+        ClusteredMesh clusters = geometry.mesh;
+        start = std::chrono::steady_clock::now();
+        buildClusterBVH(clusters);
+        double clusterMs = since(start);
+
+        std::cout << "Nivel " << level << ": " << geometry.mesh.faces.size() << " caras -> " << faceTree.nodes.size()
+                  << " nodos, " << faceTree.leaves << " hojas, profundidad " << faceTree.depth << ", costo SAH "
+                  << faceTree.sahCost() << ", " << faceMs << " ms; " << clusters.clusters.size() << " clusters -> "
+                  << clusters.tree.nodes.size() << " nodos, profundidad " << clusters.tree.depth << ", "
+                  << clusterMs << " ms" << std::endl;
+    }
+
+    // Descarte del nivel 0 en cada pose de la cámara scriptada
+    const LevelGeometry& geometry = lodGeometry[0];
+    std::vector<uint32_t> visible, linearVisible;
+    std::vector<uint8_t> masks, linearMasks;
+    ClusterCullStats treeStats, linearStats;
+    double treeMs = 0.0, linearMs = 0.0;
+    uint64_t extra = 0;
+    for (int frame = 0; frame < frames; frame++) {
+        applyBenchCamera(frame, frames);
+        glm::mat4 mv = createViewMatrix() * createModelMatrix();
+        FrustumPlanes frustum = extractFrustum(createProjectionMatrix() * mv);
+        glm::vec3 eye = -(glm::transpose(glm::mat3(mv)) * glm::vec3(mv[3]));
+
+        auto start = std::chrono::steady_clock::now();
+        for (int r = 0; r < cullRepeats; r++) {
+            ClusterCullStats stats;
+            cullClusters(geometry.mesh, frustum, eye, visible, masks, stats);
+            if (r == 0) treeStats.add(stats);
+        }
+        treeMs += since(start);
+        start = std::chrono::steady_clock::now();
+        for (int r = 0; r < cullRepeats; r++) {
+            ClusterCullStats stats;
+            cullClustersLinear(geometry.mesh, frustum, eye, linearVisible, linearMasks, stats);
+            if (r == 0) linearStats.add(stats);
+        }
+        linearMs += since(start);
+
+        // El árbol sólo puede descartar de más: todo lo suyo está en la lista sin árbol
+        extra += std::count_if(visible.begin(), visible.end(), [&](uint32_t c) {
+            return !std::binary_search(linearVisible.begin(), linearVisible.end(), c);
+        });
+    }
+    double calls = static_cast<double>(frames) * cullRepeats;
+    double n = frames;
+    std::cout << "Descarte (nivel 0, " << frames << " poses): " << 1000.0 * treeMs / calls << " µs con el árbol, "
+              << 1000.0 * linearMs / calls << " µs sin él (" << linearMs / treeMs << "x)" << std::endl;
+    std::cout << "Clusters visibles por pose: " << (treeStats.clusters - treeStats.frustumClusters - treeStats.coneClusters) / n
+              << " con el árbol, " << (linearStats.clusters - linearStats.frustumClusters - linearStats.coneClusters) / n
+              << " sin él" << (extra ? "  (EL ÁRBOL ACEPTA CLUSTERS DESCARTADOS)" : "") << std::endl;
+
+    // Selección: rayos por una rejilla de píxeles en algunas poses
+    uint64_t rays = 0, hits = 0, nodes = 0, triangles = 0;
+    uint64_t linearRays = 0, mismatches = 0;
+    double pickMs = 0.0, linearPickMs = 0.0;
+    for (int pose = 0; pose < pickPoses; pose++) {
+        applyBenchCamera(pose * frames / pickPoses, frames);
+        glm::mat4 screen = createViewportMatrix() * createProjectionMatrix() * createViewMatrix() * createModelMatrix();
+        glm::mat4 inverseScreen = glm::inverse(screen);
+        for (int y = rayStep / 2; y < renderHeight; y += rayStep) {
+            for (int x = rayStep / 2; x < renderWidth; x += rayStep) {
+                BVHRay ray = rayThroughPixel(inverseScreen, x + 0.5f, y + 0.5f);
+                auto start = std::chrono::steady_clock::now();
+                FacePickResult hit = pickFace(geometry.faceTree, geometry.mesh.positions, geometry.mesh.faces, ray);
+                pickMs += since(start);
+                rays++;
+                hits += hit.face >= 0;
+                nodes += hit.nodes;
+                triangles += hit.triangles;
+
+                if (rays % linearEvery == 0) {
+                    start = std::chrono::steady_clock::now();
+                    FacePickResult reference = pickFaceLinear(geometry.mesh.positions, geometry.mesh.faces, ray);
+                    linearPickMs += since(start);
+                    linearRays++;
+                    if (reference.distance != hit.distance) mismatches++;
+                }
+            }
+        }
+    }
+    std::cout << "Selección (nivel 0, " << rays << " rayos): " << 1000.0 * pickMs / rays << " µs por rayo con el árbol, "
+              << 1000.0 * linearPickMs / std::max<uint64_t>(1, linearRays) << " µs sin él ("
+              << (linearPickMs / std::max<uint64_t>(1, linearRays)) / (pickMs / rays) << "x)" << std::endl;
+    std::cout << "Por rayo: " << static_cast<double>(nodes) / rays << " nodos y " << static_cast<double>(triangles) / rays
+              << " triángulos probados, " << 100.0 * hits / rays << "% aciertan"
+              << (mismatches ? "  (DISTINTO DE LA PRUEBA SIN ÁRBOL)" : "") << std::endl;
+
+    cameraAngleX = 0.3f;
+    cameraAngleY = 0.0f;
+    cameraDistance = 3.5f;
+    modelRotationY = 0.0f;
+}
+
+// Flota de prueba: count naves en una rejilla cúbica con posición, giro,
+// tamaño y color pseudoaleatorios (siempre los mismos para cada count)
+void buildFleet(int count, float spacing, InstanceBuffer& fleet) {
+    const Color palette[] = {
+        Color(255, 255, 255), Color(255, 200, 200), Color(200, 255, 210),
+        Color(200, 215, 255), Color(255, 240, 180), Color(230, 200, 255)
+    };
+    const int paletteSize = sizeof(palette) / sizeof(palette[0]);
+
+    int side = static_cast<int>(std::ceil(std::cbrt(static_cast<double>(count))));
+    float offset = (side - 1) * spacing * 0.5f;
+    uint32_t seed = 12345u;
+    auto random = [&seed]() {
+        seed = seed * 1664525u + 1013904223u;
+        return (seed >> 8) / 16777216.0f;
+    };
+
+    // Misma orientación base que el modelo único
+    glm::mat4 base = glm::rotate(glm::mat4(1.0f), glm::radians(180.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    base = glm::rotate(base, glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+
+    fleet.clear();
+    for (int i = 0; i < count; i++) {
+        int x = i % side;
+        int y = (i / side) % side;
+        int z = i / (side * side);
+        glm::vec3 position(x * spacing - offset, y * spacing - offset, z * spacing - offset);
+        position += glm::vec3(random() - 0.5f, random() - 0.5f, random() - 0.5f) * (spacing * 0.4f);
+
+        glm::mat4 transform = glm::translate(glm::mat4(1.0f), position);
+        transform = glm::rotate(transform, random() * 6.2831853f, glm::vec3(0.0f, 1.0f, 0.0f));
+        transform = glm::scale(transform, glm::vec3(0.6f + 0.8f * random()));
+        fleet.add(transform * base, palette[i % paletteSize]);
+    }
+}
+
+// Dibujar flotas de cada tamaño de counts con una cámara que las recorre
+// y reportar tiempos y descartes
+void runFleetBenchmark(const std::vector<int>& counts, int frames, const std::vector<int>& dumpFrames,
+                       const std::string& dumpPrefix, const std::string& dumpExtension) {
+    const float spacing = 4.0f;
+    const float pi = 3.14159265f;
+
+    InstancedMesh mesh;
+    mesh.lods = lodEnabled ? &modelLODs : nullptr;
+    mesh.levels = &lodGeometry;
+    mesh.unitScale = modelScale;
+    meshBoundingSphere(lodGeometry[0].mesh, mesh.center, mesh.radius);
+
+    InstanceBuffer fleet;
+    InstanceRenderer instanceRenderer;
+
+    for (int count : counts) {
+        if (count <= 0) continue;
+        buildFleet(count, spacing, fleet);
+        std::cout << "\n=== FLOTA DE " << count << " NAVES ===" << std::endl;
+        std::cout << "Rasterizador: " << rasterPathName(rasterPath) << ", hilos: " << renderPool().size() << std::endl;
+        printFramebufferFormat();
+
+        // La cámara orbita por fuera del borde de la flota mirando al centro
+        float extent = std::cbrt(static_cast<float>(count)) * spacing * 0.5f;
+        InstanceCamera camera;
+        camera.projection = glm::perspective(glm::radians(CAMERA_FOV_DEGREES),
+                                             static_cast<float>(SCREEN_WIDTH) / SCREEN_HEIGHT,
+                                             0.1f, extent * 4.0f + 100.0f);
+        camera.viewport = createViewportMatrix();
+        camera.lightDir = lightDir;
+        auto applyCamera = [&](int frame) {
+            float t = frames > 1 ? static_cast<float>(frame) / (frames - 1) : 0.0f;
+            float distance = extent * (1.2f + 0.6f * std::sin(t * 2.0f * pi));
+            glm::vec3 eye(distance * std::sin(t * 2.0f * pi), extent * 0.4f, distance * std::cos(t * 2.0f * pi));
+            camera.view = glm::lookAt(eye, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        };
+
+        // Calentar cachés y el pool de hilos
+        InstanceStats stats;
+        for (int i = 0; i < 3; i++) {
+            applyCamera(0);
+            clear(Color(10, 10, 15));
+            instanceRenderer.render(mesh, fleet, camera, shadeColor, stats);
+        }
+
+        std::vector<double> frameMs;
+        frameMs.reserve(frames);
+        stats = InstanceStats();
+        rasterStats = RasterStats();
+        profiler.resetTotals();
+
+        for (int frame = 0; frame < frames; frame++) {
+            applyCamera(frame);
+
+            auto start = std::chrono::steady_clock::now();
+            PROFILE_BEGIN_FRAME();
+            clear(Color(10, 10, 15));
+            instanceRenderer.render(mesh, fleet, camera, shadeColor, stats);
+            if (hudVisible) drawStatsHud({});
+            framebuffer.resolve();
+            PROFILE_END_FRAME();
+            auto end = std::chrono::steady_clock::now();
+            frameMs.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+
+            if (std::find(dumpFrames.begin(), dumpFrames.end(), frame) != dumpFrames.end()) {
+                char number[32];
+                std::snprintf(number, sizeof(number), "fleet%d_%04d", count, frame);
+                std::string path = dumpPrefix + number + dumpExtension;
+                if (saveFrame(path)) {
+                    std::cout << "Guardado " << path << std::endl;
+                }
+            }
+        }
+
+        double n = frames;
+        printFrameStats(frameMs, stats.triangles);
+        std::cout << "Instancias por frame: " << stats.instances / n << ", descartadas por esfera "
+                  << stats.culledInstances / n << std::endl;
+        std::cout << "Instancias visibles por nivel de LOD:";
+        for (size_t level = 0; level < stats.lodInstances.size(); level++) {
+            std::cout << " " << level << "=" << stats.lodInstances[level] / n;
+        }
+        std::cout << std::endl;
+        printCullStats(stats.clusters, frames);
+        printRasterStats(rasterStats, frames);
+        if (RENDERER_PROFILING) profiler.printSummary();
+    }
+}
+
+// Recorrer una malla por chunks (--stream) con una cámara que orbita
+// alrededor de su centro acercándose hasta ver sólo una parte y alejándose
+// hasta verla entera. Reporta tiempos, carga de chunks y memoria.
+bool runStreamBenchmark(const std::string& path, size_t budgetBytes, int frames, const std::vector<int>& dumpFrames,
+                        const std::string& dumpPrefix, const std::string& dumpExtension) {
+    const float pi = 3.14159265f;
+    StreamedMesh mesh;
+    if (!mesh.open(path, budgetBytes)) return false;
+    const StreamHeader& info = mesh.info();
+
+    std::cout << "\n=== MALLA POR CHUNKS ===" << std::endl;
+    std::cout << path << ": " << info.triangleCount << " triángulos, " << info.vertexCount << " vértices en "
+              << info.chunkCount << " chunks" << std::endl;
+    std::cout << "Rasterizador: " << rasterPathName(rasterPath) << ", hilos: " << renderPool().size()
+              << ", caché de residencia: " << budgetBytes / (1024.0 * 1024.0) << " MB" << std::endl;
+    printFramebufferFormat();
+
+    glm::vec3 center = (info.boundsMin + info.boundsMax) * 0.5f;
+    float radius = std::max(glm::length(info.boundsMax - center), 1e-3f);
+    StreamCamera camera;
+    camera.viewport = createViewportMatrix();
+    camera.lightDir = lightDir;
+    auto applyCamera = [&](int frame) {
+        float t = frames > 1 ? static_cast<float>(frame) / (frames - 1) : 0.0f;
+        float distance = radius * (0.7f + 1.3f * (0.5f + 0.5f * std::cos(t * 2.0f * pi)));
+        glm::vec3 eye = center + glm::vec3(distance * std::sin(t * 2.0f * pi), distance * 0.5f,
+                                           distance * std::cos(t * 2.0f * pi));
+        camera.view = glm::lookAt(eye, center, glm::vec3(0.0f, 1.0f, 0.0f));
+        camera.projection = glm::perspective(glm::radians(CAMERA_FOV_DEGREES),
+                                             static_cast<float>(SCREEN_WIDTH) / SCREEN_HEIGHT,
+                                             radius * 1e-4f, distance * 1.2f + radius * 2.0f);
+    };
+
+    std::vector<double> frameMs;
+    frameMs.reserve(frames);
+    StreamStats stats;
+    rasterStats = RasterStats();
+    profiler.resetTotals();
+
+    for (int frame = 0; frame < frames; frame++) {
+        applyCamera(frame);
+
+        auto start = std::chrono::steady_clock::now();
+        PROFILE_BEGIN_FRAME();
+        clear(Color(10, 10, 15));
+        bool ok = mesh.render(camera, stats);
+        framebuffer.resolve();
+        PROFILE_END_FRAME();
+        if (!ok) return false;
+        auto end = std::chrono::steady_clock::now();
+        frameMs.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+
+        if (std::find(dumpFrames.begin(), dumpFrames.end(), frame) != dumpFrames.end()) {
+            char number[32];
+            std::snprintf(number, sizeof(number), "stream_%04d", frame);
+            std::string dumpPath = dumpPrefix + number + dumpExtension;
+            if (saveFrame(dumpPath)) {
+                std::cout << "Guardado " << dumpPath << std::endl;
+            }
+        }
+    }
+
+    double n = frames;
+    double mb = 1024.0 * 1024.0;
+    printFrameStats(frameMs, stats.drawn);
+    std::cout << "Chunks por frame: " << stats.chunks / n << ", descartados " << stats.culledChunks / n
+              << " por frustum sin leerlos" << std::endl;
+    std::cout << "Carga: " << stats.loads / n << " chunks y " << stats.bytesLoaded / n / mb
+              << " MB por frame, " << stats.evictions / n << " desalojados" << std::endl;
+    std::cout << "Triángulos por frame: " << stats.triangles / n << " en chunks visibles, "
+              << stats.backfaceTriangles / n << " de espaldas, " << stats.clipped / n << " recortados" << std::endl;
+    printRasterStats(rasterStats, frames);
+    if (RENDERER_PROFILING) profiler.printSummary();
+
+    std::cout << "Memoria: caché " << mesh.residentSize() / mb << " MB al final, pico " << mesh.peakResidentSize() / mb
+              << " MB (presupuesto " << budgetBytes / mb << " MB)";
+    double peakRSS = peakResidentMB();
+    if (peakRSS >= 0.0) std::cout << ", pico del proceso " << peakRSS << " MB";
+    std::cout << std::endl;
+    return true;
+}
+
+// Matrices y nivel de detalle de una pose del lote, como los armaría
+// buildFrame con esa cámara (sin histéresis: cada pose es independiente)
+BatchView makeBatchView(const BatchPose& pose) {
+    BatchView view;
+    view.mv = createViewMatrix(pose.cameraAngleX, pose.cameraAngleY, pose.cameraDistance) *
+              createModelMatrix(pose.modelRotationY);
+    view.projection = createProjectionMatrix();
+    view.viewport = createViewportMatrix();
+    view.lightDir = pose.lightDir;
+    if (!lodEnabled) {
+        view.lod = 0;
+    } else if (forcedLOD >= 0) {
+        view.lod = std::min(forcedLOD, modelLODs.levelCount() - 1);
+    } else {
+        view.lod = coarsestLODWithin(modelLODs, modelPixelsPerUnit(pose.cameraDistance), LOD_PIXEL_ERROR);
+    }
+    return view;
+}
+
+// Dibujar todas las poses de posesPath repartidas entre los núcleos y
+// guardarlas como imágenes sueltas o, con sheetColumns > 0, en una sola
+// hoja de sheetColumns columnas. Reporta poses por segundo.
+bool runBatch(const std::string& posesPath, int sheetColumns, const std::string& prefix,
+              const std::string& extension) {
+    std::vector<BatchPose> poses;
+    if (!loadBatchPoses(posesPath, lightDir, poses)) return false;
+    if (poses.empty()) {
+        std::cerr << "Error: " << posesPath << " no tiene poses" << std::endl;
+        return false;
+    }
+
+    std::vector<BatchView> views;
+    views.reserve(poses.size());
+    for (const BatchPose& pose : poses) views.push_back(makeBatchView(pose));
+
+    BatchSettings settings;
+    settings.shading = shadingMode;
+    settings.mode = renderMode;
+
+    ThreadPool& pool = renderPool();
+    std::vector<BatchWorker> workers;
+    prepareBatchWorkers(workers, pool.size(), framebuffer, renderWidth, renderHeight);
+
+    std::cout << "\n=== LOTE DE " << poses.size() << " POSES ===" << std::endl;
+    std::cout << "Rasterizador: " << rasterPathName(rasterPath) << ", hilos: " << pool.size()
+              << ", sombreado: " << shadingModeName(shadingMode) << ", modo: " << renderModeName(renderMode)
+              << ", imagen: " << renderWidth << "x" << renderHeight << std::endl;
+    printFramebufferFormat();
+
+    // La hoja: cada pose en su celda, que sólo escribe el hilo que la dibujó
+    int columns = std::min<int>(sheetColumns, static_cast<int>(poses.size()));
+    int rows = columns > 0 ? static_cast<int>((poses.size() + columns - 1) / columns) : 0;
+    int sheetWidth = columns * renderWidth;
+    std::vector<Color> sheet(static_cast<size_t>(sheetWidth) * rows * renderHeight, settings.background);
+    std::atomic<int> failed{0};
+
+    auto start = std::chrono::steady_clock::now();
+    renderBatch(lodGeometry, views, settings, workers, [&](int index, Framebuffer& fb, BatchWorker& worker) {
+        int stride = 0;
+        const Color* pixels = fb.linearColor(worker.staging, stride);
+        if (columns > 0) {
+            Color* cell = &sheet[(static_cast<size_t>(index / columns) * renderHeight) * sheetWidth +
+                                 static_cast<size_t>(index % columns) * renderWidth];
+            for (int y = 0; y < fb.height; y++) {
+                std::copy(pixels + static_cast<size_t>(y) * stride, pixels + static_cast<size_t>(y) * stride + fb.width,
+                          cell + static_cast<size_t>(y) * sheetWidth);
+            }
+            return;
+        }
+        char number[16];
+        std::snprintf(number, sizeof(number), "%04d", index);
+        if (!writeImage(prefix + number + extension, pixels, fb.width, fb.height, stride)) failed++;
+    });
+    if (columns > 0) {
+        std::string path = prefix + "sheet" + extension;
+        if (writeImage(path, sheet.data(), sheetWidth, rows * renderHeight, sheetWidth)) {
+            std::cout << "Guardada la hoja " << path << " (" << columns << "x" << rows << " celdas de "
+                      << renderWidth << "x" << renderHeight << ")" << std::endl;
+        } else {
+            failed++;
+        }
+    } else {
+        char last[16];
+        std::snprintf(last, sizeof(last), "%04d", static_cast<int>(poses.size()) - 1);
+        std::cout << "Guardadas " << poses.size() - failed << " imágenes: " << prefix << "0000" << extension
+                  << " a " << prefix << last << extension << std::endl;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // Totales de todos los hilos
+    ClusterCullStats cull;
+    RasterStats raster;
+    uint64_t triangles = 0;
+    double renderMs = 0.0;
+    for (const BatchWorker& worker : workers) {
+        cull.add(worker.cull);
+        raster.add(worker.raster);
+        triangles += worker.trianglesDrawn;
+        renderMs += worker.renderMs;
+    }
+
+    int count = static_cast<int>(poses.size());
+    std::cout << "Poses por segundo: " << count / seconds << " (" << seconds * 1000.0 << " ms en total con "
+              << pool.size() << " hilos, guardando las imágenes)" << std::endl;
+    std::cout << "Por pose en un hilo: " << renderMs / count << " ms de dibujo, "
+              << static_cast<double>(triangles) / count << " triángulos" << std::endl;
+    printCullStats(cull, count);
+    printRasterStats(raster, count);
+    return failed == 0;
+}
+
+// Lista de enteros separados por comas ("0,10,200")
+std::vector<int> parseIntList(const std::string& text) {
+    std::vector<int> values;
+    size_t start = 0;
+    while (start < text.size()) {
+        size_t end = text.find(',', start);
+        if (end == std::string::npos) end = text.size();
+        if (end > start) values.push_back(std::atoi(text.substr(start, end - start).c_str()));
+        start = end + 1;
     }
+    return values;
 }
 
 int main(int argc, char* argv[]) {
-    init();
-    
+    bool scaling = false;
+    bool bvhBench = false;
+#ifdef RENDERER_HEADLESS_DEFAULT
+    bool headless = true;
+#else
+    bool headless = false;
+#endif
+    bool vsync = true;
+    bool useMeshCache = true;
+    int benchFrames = 300;
+    std::vector<int> dumpFrames;
+    std::string dumpPrefix = "frame_";
+    std::string dumpExtension = ".ppm";
+    std::vector<int> fleetCounts;
+    float renderScale = 1.0f;
+    FramebufferLayout framebufferLayout = FramebufferLayout::Linear;
+    DepthFormat depthFormat = DepthFormat::Float32;
+    bool lazyClear = true;
+    std::string tracePath;
+    std::string batchPath;
+    int sheetColumns = 0;
+    std::string streamPath;
+    size_t streamBudgetMB = 256;
+    std::string streamSource;
+    uint64_t streamTestTriangles = 0;
+
+    // Opciones de línea de comandos
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--raster" && i + 1 < argc) {
+            rasterPath = parseRasterPath(argv[++i]);
+        } else if (arg == "--threads" && i + 1 < argc) {
+            renderThreads = std::max(0, std::atoi(argv[++i]));
+        } else if (arg == "--no-hiz") {
+            rasterHiZ = false;
+        } else if (arg == "--scaling") {
+            scaling = true;
+        } else if (arg == "--bvh-bench") {
+            bvhBench = true;
+        } else if (arg == "--headless") {
+            headless = true;
+        } else if (arg == "--frames" && i + 1 < argc) {
+            benchFrames = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--dump" && i + 1 < argc) {
+            dumpFrames = parseIntList(argv[++i]);
+        } else if (arg == "--dump-prefix" && i + 1 < argc) {
+            dumpPrefix = argv[++i];
+        } else if (arg == "--png") {
+            dumpExtension = ".png";
+        } else if (arg == "--no-vsync") {
+            vsync = false;
+        } else if (arg == "--no-cache") {
+            useMeshCache = false;
+        } else if (arg == "--continuous") {
+            continuousRender = true;
+        } else if (arg == "--no-lod") {
+            lodEnabled = false;
+        } else if (arg == "--lod" && i + 1 < argc) {
+            forcedLOD = std::max(0, std::atoi(argv[++i]));
+        } else if (arg == "--fleet" && i + 1 < argc) {
+            fleetCounts = parseIntList(argv[++i]);
+        } else if (arg == "--render-scale" && i + 1 < argc) {
+            renderScale = static_cast<float>(std::atof(argv[++i]));
+        } else if (arg == "--target-ms" && i + 1 < argc) {
+            resolution.enabled = true;
+            resolution.targetMs = std::max(1.0f, static_cast<float>(std::atof(argv[++i])));
+        } else if (arg == "--min-scale" && i + 1 < argc) {
+            resolution.minScale = static_cast<float>(std::atof(argv[++i]));
+        } else if (arg == "--upscale" && i + 1 < argc) {
+            upscaleMode = parseUpscaleMode(argv[++i]);
+        } else if (arg == "--fb-layout" && i + 1 < argc) {
+            framebufferLayout = parseFramebufferLayout(argv[++i]);
+        } else if (arg == "--depth-bits" && i + 1 < argc) {
+            depthFormat = parseDepthFormat(argv[++i]);
+        } else if (arg == "--eager-clear") {
+            lazyClear = false;
+        } else if (arg == "--shading" && i + 1 < argc) {
+            shadingMode = parseShadingMode(argv[++i]);
+        } else if (arg == "--render-mode" && i + 1 < argc) {
+            renderMode = parseRenderMode(argv[++i]);
+        } else if (arg == "--hud") {
+            hudVisible = true;
+        } else if (arg == "--trace" && i + 1 < argc) {
+            tracePath = argv[++i];
+            profiler.tracing = true;
+        } else if (arg == "--no-pipeline") {
+            framePipelining = false;
+        } else if (arg == "--visibility-buffer") {
+            visibilityBuffer = true;
+        } else if (arg == "--batch" && i + 1 < argc) {
+            batchPath = argv[++i];
+        } else if (arg == "--sheet" && i + 1 < argc) {
+            sheetColumns = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--stream" && i + 1 < argc) {
+            streamPath = argv[++i];
+        } else if (arg == "--stream-budget" && i + 1 < argc) {
+            streamBudgetMB = static_cast<size_t>(std::max(1, std::atoi(argv[++i])));
+        } else if (arg == "--build-stream" && i + 2 < argc) {
+            streamSource = argv[++i];
+            streamPath = argv[++i];
+        } else if (arg == "--stream-test" && i + 1 < argc) {
+            streamTestTriangles = static_cast<uint64_t>(std::max(1.0, std::atof(argv[++i])));
+        }
+    }
+
+    if (framebufferLayout != FramebufferLayout::Linear || depthFormat != DepthFormat::Float32) {
+        framebuffer = makeFramebuffer(SCREEN_WIDTH, SCREEN_HEIGHT, framebufferLayout, depthFormat);
+    }
+    framebuffer.lazyClear = lazyClear;
+    if (framePipelining) {
+        presentFramebuffer = makeFramebuffer(SCREEN_WIDTH, SCREEN_HEIGHT, framebufferLayout, depthFormat);
+        presentFramebuffer.lazyClear = lazyClear;
+    }
+
+    // Resolución interna inicial; con --target-ms el controlador parte de ella
+    resolution.minScale = std::clamp(resolution.minScale, 0.1f, 1.0f);
+    renderScale = std::clamp(renderScale, resolution.enabled ? resolution.minScale : 0.1f, 1.0f);
+    resolution.scale = renderScale;
+    setRenderScale(renderScale);
+
+    // Mallas por chunks: no usan Modelo3D.obj
+    if (!streamPath.empty() || streamTestTriangles > 0) {
+        size_t budget = streamBudgetMB * 1024 * 1024;
+        if (streamPath.empty()) streamPath = "stream_test.meshchunks";
+        bool ok = true;
+        if (!streamSource.empty()) {
+            ok = buildStreamFromObj(streamSource, streamPath, budget);
+        } else if (streamTestTriangles > 0) {
+            ok = buildStreamTestTerrain(streamPath, streamTestTriangles);
+        }
+        ok = ok && runStreamBenchmark(streamPath, budget, benchFrames, dumpFrames, dumpPrefix, dumpExtension);
+        writeTrace(tracePath);
+        return ok ? 0 : 1;
+    }
+
     std::cout << "Cargando modelo..." << std::endl;
-    if (!loadOBJ("Modelo3D.obj", vertices, faces)) {
+    if (!loadOBJ("Modelo3D.obj", vertices, faces, useMeshCache)) {
         std::cerr << "Error: No se pudo cargar el modelo Modelo3D.obj" << std::endl;
         return 1;
     }
     
     calculateModelBounds();
+    meshVersion++;
+    if (lodEnabled) {
+        loadLODs("Modelo3D.obj", vertices, faces, modelLODs, useMeshCache);
+    }
+    buildModelGeometry();
+
+    if (scaling) {
+        int maxThreads = renderThreads > 0 ? renderThreads : defaultThreadCount();
+        runScalingReport(maxThreads, 200);
+        writeTrace(tracePath);
+        return 0;
+    }
+
+    if (bvhBench) {
+        runBVHBenchmark(benchFrames);
+        writeTrace(tracePath);
+        return 0;
+    }
+
+    if (!batchPath.empty()) {
+        bool saved = runBatch(batchPath, sheetColumns, dumpPrefix, dumpExtension);
+        writeTrace(tracePath);
+        return saved ? 0 : 1;
+    }
+
+    if (!fleetCounts.empty()) {
+        runFleetBenchmark(fleetCounts, benchFrames, dumpFrames, dumpPrefix, dumpExtension);
+        writeTrace(tracePath);
+        return 0;
+    }
+
+    if (headless) {
+        runHeadless(benchFrames, dumpFrames, dumpPrefix, dumpExtension);
+        writeTrace(tracePath);
+        return 0;
+    }
+
+    init(vsync);
+
+    FramePacer pacer;
+    pacer.start(rendererHasVsync());
     
     std::cout << "\n=== SPACESHIP RENDERER ===" << std::endl;
     std::cout << "Vértices: " << vertices.size() << std::endl;
     std::cout << "Caras: " << faces.size() << std::endl;
+    std::cout << "Niveles de LOD: " << modelLODs.levelCount() << std::endl;
+    std::cout << "Rasterizador: " << rasterPathName(rasterPath) << std::endl;
+    printFramebufferFormat();
+    std::cout << "Hilos de render: " << renderPool().size() << std::endl;
+    std::cout << "Vsync: " << (pacer.vsync ? "sí" : "no (ritmo por temporizador)") << std::endl;
+    std::cout << "Pipeline de frames: " << (framePipelining ? "sí (rasterización en su propio hilo)" : "no") << std::endl;
+    std::cout << "Resolución interna: " << renderWidth << "x" << renderHeight;
+    if (resolution.enabled) std::cout << " (dinámica, objetivo " << resolution.targetMs << " ms)";
+    std::cout << std::endl;
     std::cout << "\n=== CONTROLES ===" << std::endl;
     std::cout << "Flechas: Rotar cámara" << std::endl;
     std::cout << "Q/E: Girar nave sobre sí misma" << std::endl;
     std::cout << "W/S: Zoom" << std::endl;
     std::cout << "R: Reset" << std::endl;
     std::cout << "1-5: Cambiar luz" << std::endl;
+    std::cout << "H: Panel de estadísticas" << std::endl;
+    std::cout << "M: Cambiar sombreado (plano, Gouraud, Phong)" << std::endl;
+    std::cout << "F: Cambiar modo (relleno, alambre, alambre encima)" << std::endl;
+    std::cout << "Clic izquierdo: Elegir una cara (en el vacío, quitar la selección)" << std::endl;
     std::cout << "ESC: Salir\n" << std::endl;
     
     bool running = true;
+    int shownLOD = 0;
+    bool hasFrame = false;
+    bool needsPresent = false;
+    bool lowResolutionFrame = false;    // El último frame se bajó de resolución por tiempo
+    ViewState drawnState = currentViewState();
     while (running) {
         SDL_Event event;
+
+        // Sin cambios pendientes no hay nada que dibujar: dormir hasta el
+        // siguiente evento en lugar de repetir el mismo frame
+        if (!continuousRender && hasFrame && !needsPresent && !lowResolutionFrame) {
+            ViewState state = currentViewState();
+            if (state.sameGeometry(drawnState) && state.sameLight(drawnState)) {
+                // Mostrar el frame que quedó en el pipeline antes de dormir
+                finishPipelinedFrame();
+                if (SDL_WaitEvent(&event)) {
+                    if (event.type == SDL_WINDOWEVENT) needsPresent = true;
+                    handleInput(event, running);
+                }
+            }
+        }
         while (SDL_PollEvent(&event)) {
+            if (event.type == SDL_WINDOWEVENT) needsPresent = true;
             handleInput(event, running);
         }
+        if (!running) break;
 
-        clear(Color(10, 10, 15));
-        render();
-        renderBuffer(renderer);
+        ViewState state = currentViewState();
+        bool moving = !hasFrame || continuousRender || !state.sameGeometry(drawnState) ||
+                      !state.sameOverlay(drawnState);
+
+        // Los caminos sin movimiento parten del último frame terminado
+        if (!moving) finishPipelinedFrame();
+
+        if (moving) {
+            // En movimiento manda el controlador de resolución. Los dos
+            // framebuffers del pipeline deben tener la misma resolución.
+            if (resolution.enabled && renderScaleChanges(resolution.scale)) {
+                finishPipelinedFrame();
+                setRenderScale(resolution.scale);
+            }
+            auto start = std::chrono::steady_clock::now();
+            PROFILE_BEGIN_FRAME();
+            if (framePipelining) {
+                // Armar este frame mientras se rasteriza el anterior, y
+                // presentar el anterior mientras se rasteriza este
+                buildFrame(frameGeometry);
+                double buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+                if (pipelineFrame(buildMs)) {
+                    resolution.update(pipelinedFrameMs);
+                    showFrame(presentFramebuffer);
+                }
+                PROFILE_END_FRAME();
+            } else {
+                clear(Color(10, 10, 15));
+                render();
+                auto end = std::chrono::steady_clock::now();
+                resolution.update(std::chrono::duration<double, std::milli>(end - start).count());
+                presentFrame();
+            }
+            lowResolutionFrame = resolution.enabled && renderWidth < SCREEN_WIDTH;
+        } else if (lowResolutionFrame && state.sameLight(drawnState)) {
+            // La escena se quedó quieta sobre un frame de baja resolución:
+            // dibujarlo una vez a resolución completa
+            setRenderScale(1.0f);
+            PROFILE_BEGIN_FRAME();
+            clear(Color(10, 10, 15));
+            render();
+            lowResolutionFrame = false;
+            presentFrame();
+        } else if (!state.sameLight(drawnState)) {
+            // Sólo cambió la luz: reutilizar la geometría del frame anterior
+            PROFILE_BEGIN_FRAME();
+            clear(Color(10, 10, 15));
+            reshade();
+            presentFrame();
+        } else if (needsPresent) {
+            // Ventana expuesta o restaurada: la textura ya tiene el frame
+            presentLastFrame(renderer);
+        } else {
+            continue;
+        }
+        drawnState = state;
+        hasFrame = true;
+        needsPresent = false;
+
+        if (currentLOD != shownLOD) {
+            shownLOD = currentLOD;
+            std::cout << "LOD: nivel " << currentLOD << " ("
+                      << lodFaces(modelLODs, faces, currentLOD).size() << " triángulos)" << std::endl;
+        }
         
-        SDL_Delay(16);
+        pacer.wait();
     }
 
+    drainPipeline();
+    writeTrace(tracePath);
+    destroyFrameTexture();
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
     SDL_Quit();
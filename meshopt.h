@@ -0,0 +1,415 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+// Optimización de la malla al cargar.
+//
+// 1. Se unen los vértices con la misma posición exacta y la misma normal
+//    suavizada, y se descartan las caras que quedan con dos índices
+//    iguales. Los duplicados con normales distintas son aristas vivas
+//    del modelo y se conservan, así que el sombreado no cambia.
+// 2. Se reordenan los triángulos para reusar la caché de vértices
+//    transformados (algoritmo de Forsyth: cada vértice puntúa por su
+//    posición en una caché LRU simulada y por cuántas caras le quedan).
+// 3. Se reordenan los vértices por primer uso en ese orden, lo que también
+//    descarta los que ninguna cara usa.
+//
+// La caché del .obj guarda las caras como un solo arreglo de índices, de
+// 16 bits si la malla tiene a lo sumo 65536 vértices.
+
+// Cada cara es un triángulo
+struct Face {
+    std::array<int, 3> vertexIndices;
+};
+
+const int VERTEX_CACHE_SCORE_SIZE = 32;     // Caché LRU que puntúa el reordenamiento
+const int VERTEX_CACHE_SIM_SIZE = 16;       // Caché FIFO con que se mide el ACMR
+const int VERTEX_FETCH_LINE = 64;           // Línea de caché al medir la lectura de vértices
+const int VERTEX_FETCH_LINES = 64;          // Líneas de esa caché (4 KB)
+
+// Índices de todas las caras en un solo arreglo, de 16 o 32 bits
+struct IndexBuffer {
+    std::vector<uint16_t> indices16;
+    std::vector<uint32_t> indices32;
+
+    bool compact() const {
+        return indices32.empty();
+    }
+
+    size_t size() const {
+        return compact() ? indices16.size() : indices32.size();
+    }
+
+    uint32_t operator[](size_t i) const {
+        return compact() ? indices16[i] : indices32[i];
+    }
+
+    int indexSize() const {
+        return compact() ? 2 : 4;
+    }
+
+    size_t bytes() const {
+        return size() * indexSize();
+    }
+
+    void* data() {
+        return compact() ? static_cast<void*>(indices16.data()) : static_cast<void*>(indices32.data());
+    }
+
+    const void* data() const {
+        return compact() ? static_cast<const void*>(indices16.data()) : static_cast<const void*>(indices32.data());
+    }
+
+    // Reservar count índices del tamaño que alcance para vertexCount vértices
+    void resize(size_t count, size_t vertexCount) {
+        indices16.clear();
+        indices32.clear();
+        if (vertexCount <= 65536) indices16.resize(count);
+        else indices32.resize(count);
+    }
+};
+
+void buildIndexBuffer(const std::vector<Face>& faces, size_t vertexCount, IndexBuffer& out) {
+    out.resize(faces.size() * 3, vertexCount);
+    for (size_t f = 0; f < faces.size(); f++) {
+        for (int k = 0; k < 3; k++) {
+            uint32_t index = static_cast<uint32_t>(faces[f].vertexIndices[k]);
+            if (out.compact()) out.indices16[f * 3 + k] = static_cast<uint16_t>(index);
+            else out.indices32[f * 3 + k] = index;
+        }
+    }
+}
+
+void expandIndexBuffer(const IndexBuffer& buffer, std::vector<Face>& out) {
+    size_t first = out.size();
+    out.resize(first + buffer.size() / 3);
+    for (size_t f = 0; f < buffer.size() / 3; f++) {
+        for (int k = 0; k < 3; k++) {
+            out[first + f].vertexIndices[k] = static_cast<int>(buffer[f * 3 + k]);
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Unión de vértices
+// ---------------------------------------------------------------------------
+
+// Índice del primer vértice con la misma posición exacta que cada vértice.
+// Muchos .obj repiten posiciones (por costuras de UV o normales); sin
+// unirlas las aristas de la costura nunca se podrían colapsar.
+std::vector<int> weldVertices(const std::vector<glm::vec3>& vertices) {
+    struct PositionHash {
+        size_t operator()(const glm::vec3& p) const {
+            uint32_t bits[3];
+            std::memcpy(bits, &p.x, sizeof(float));
+            std::memcpy(bits + 1, &p.y, sizeof(float));
+            std::memcpy(bits + 2, &p.z, sizeof(float));
+            return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+        }
+    };
+    struct PositionEqual {
+        bool operator()(const glm::vec3& a, const glm::vec3& b) const {
+            return a.x == b.x && a.y == b.y && a.z == b.z;
+        }
+    };
+
+    std::unordered_map<glm::vec3, int, PositionHash, PositionEqual> first;
+    first.reserve(vertices.size());
+    std::vector<int> remap(vertices.size());
+    for (size_t i = 0; i < vertices.size(); i++) {
+        remap[i] = first.emplace(vertices[i], static_cast<int>(i)).first->second;
+    }
+    return remap;
+}
+
+// Como weldVertices, pero sólo une vértices cuyas normales suavizadas
+// (suma de los productos cruz de sus caras, como buildVertexNormals)
+// apuntan hacia el mismo lado. Los vértices que sólo usan caras sin área
+// no tienen normal y se unen con cualquiera en su posición.
+std::vector<int> weldMatchingVertices(const std::vector<glm::vec3>& vertices, const std::vector<Face>& faces) {
+    const float sameNormal = 0.9999f;
+
+    std::vector<glm::vec3> normals(vertices.size(), glm::vec3(0.0f));
+    for (const Face& face : faces) {
+        const auto& idx = face.vertexIndices;
+        glm::vec3 p0 = vertices[idx[0]];
+        glm::vec3 weighted = glm::cross(vertices[idx[1]] - p0, vertices[idx[2]] - p0);
+        for (int index : idx) normals[index] += weighted;
+    }
+    for (glm::vec3& normal : normals) {
+        float length = glm::length(normal);
+        normal = length > 0.0f ? normal / length : glm::vec3(0.0f);
+    }
+
+    // Cada posición tiene una lista de vértices que se conservan, enlazada
+    // desde el primero (el que devuelve weldVertices)
+    std::vector<int> first = weldVertices(vertices);
+    std::vector<int> nextKept(vertices.size(), -1);
+    std::vector<int> remap(vertices.size());
+    for (size_t v = 0; v < vertices.size(); v++) {
+        int head = first[v];
+        remap[v] = static_cast<int>(v);
+        if (head == static_cast<int>(v)) continue;
+
+        int kept = head;
+        while (true) {
+            bool noNormal = normals[v] == glm::vec3(0.0f) || normals[kept] == glm::vec3(0.0f);
+            if (noNormal || glm::dot(normals[v], normals[kept]) >= sameNormal) {
+                if (normals[kept] == glm::vec3(0.0f)) normals[kept] = normals[v];
+                remap[v] = kept;
+                break;
+            }
+            if (nextKept[kept] < 0) {
+                nextKept[kept] = static_cast<int>(v);
+                break;
+            }
+            kept = nextKept[kept];
+        }
+    }
+    return remap;
+}
+
+// ---------------------------------------------------------------------------
+// Orden de triángulos (Forsyth)
+// ---------------------------------------------------------------------------
+
+struct ForsythScores {
+    float cache[VERTEX_CACHE_SCORE_SIZE];
+    float valence[32];
+
+    ForsythScores() {
+        // Los tres vértices del último triángulo valen lo mismo, para no
+        // favorecer tiras largas; el resto decae con la posición
+        for (int i = 0; i < VERTEX_CACHE_SCORE_SIZE; i++) {
+            cache[i] = i < 3 ? 0.75f
+                             : std::pow(1.0f - (i - 3) / float(VERTEX_CACHE_SCORE_SIZE - 3), 1.5f);
+        }
+        // Los vértices con pocas caras pendientes suben, para no dejarlos
+        // aislados
+        for (int i = 0; i < 32; i++) {
+            valence[i] = i == 0 ? 0.0f : 2.0f / std::sqrt(float(i));
+        }
+    }
+
+    float vertex(int cachePosition, uint32_t remaining) const {
+        if (remaining == 0) return -1.0f;
+        float score = cachePosition >= 0 ? cache[cachePosition] : 0.0f;
+        return score + (remaining < 32 ? valence[remaining] : 2.0f / std::sqrt(float(remaining)));
+    }
+};
+
+// Reordenar las caras (los índices no cambian)
+void optimizeVertexCache(std::vector<Face>& faces, size_t vertexCount) {
+    static const ForsythScores scores;
+    size_t faceCount = faces.size();
+    if (faceCount == 0) return;
+
+    // Caras de cada vértice (CSR); remaining[v] cuenta las no emitidas, que
+    // se mantienen al principio de su rango
+    std::vector<uint32_t> remaining(vertexCount, 0);
+    for (const Face& face : faces) {
+        for (int index : face.vertexIndices) remaining[index]++;
+    }
+    std::vector<uint32_t> offsets(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++) offsets[v + 1] = offsets[v] + remaining[v];
+    std::vector<uint32_t> adjacency(offsets[vertexCount]);
+    {
+        std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t f = 0; f < faceCount; f++) {
+            for (int index : faces[f].vertexIndices) adjacency[fill[index]++] = static_cast<uint32_t>(f);
+        }
+    }
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> vertexScore(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++) vertexScore[v] = scores.vertex(-1, remaining[v]);
+
+    std::vector<uint8_t> emitted(faceCount, 0);
+    std::vector<Face> ordered;
+    ordered.reserve(faceCount);
+    std::vector<int> cache, nextCache;
+    cache.reserve(VERTEX_CACHE_SCORE_SIZE + 3);
+    nextCache.reserve(VERTEX_CACHE_SCORE_SIZE + 3);
+
+    size_t scan = 0;
+    int64_t best = -1;
+    while (ordered.size() < faceCount) {
+        // Sin candidatos en la caché: seguir por la primera cara pendiente
+        if (best < 0) {
+            while (emitted[scan]) scan++;
+            best = static_cast<int64_t>(scan);
+        }
+
+        const Face& face = faces[best];
+        emitted[best] = 1;
+        ordered.push_back(face);
+
+        for (int index : face.vertexIndices) {
+            uint32_t* begin = adjacency.data() + offsets[index];
+            uint32_t* end = begin + remaining[index];
+            uint32_t* found = std::find(begin, end, static_cast<uint32_t>(best));
+            if (found != end) {
+                std::swap(*found, *(end - 1));
+                remaining[index]--;
+            }
+        }
+
+        // Los vértices de la cara pasan al frente de la caché
+        nextCache.clear();
+        for (int index : face.vertexIndices) {
+            if (std::find(nextCache.begin(), nextCache.end(), index) == nextCache.end()) nextCache.push_back(index);
+        }
+        for (int index : cache) {
+            if (std::find(nextCache.begin(), nextCache.end(), index) == nextCache.end()) nextCache.push_back(index);
+        }
+        for (size_t i = 0; i < nextCache.size(); i++) {
+            int index = nextCache[i];
+            cachePosition[index] = i < static_cast<size_t>(VERTEX_CACHE_SCORE_SIZE) ? static_cast<int>(i) : -1;
+            vertexScore[index] = scores.vertex(cachePosition[index], remaining[index]);
+        }
+        if (nextCache.size() > static_cast<size_t>(VERTEX_CACHE_SCORE_SIZE)) nextCache.resize(VERTEX_CACHE_SCORE_SIZE);
+        std::swap(cache, nextCache);
+
+        // Elegir la cara pendiente de mejor puntaje entre las de la caché
+        best = -1;
+        float bestScore = -1.0f;
+        for (int index : cache) {
+            for (uint32_t a = 0; a < remaining[index]; a++) {
+                uint32_t f = adjacency[offsets[index] + a];
+                const auto& idx = faces[f].vertexIndices;
+                float score = vertexScore[idx[0]] + vertexScore[idx[1]] + vertexScore[idx[2]];
+                if (score > bestScore) {
+                    bestScore = score;
+                    best = f;
+                }
+            }
+        }
+    }
+
+    faces = std::move(ordered);
+}
+
+// ---------------------------------------------------------------------------
+// Orden de vértices
+// ---------------------------------------------------------------------------
+
+// Numerar los vértices en el orden en que los usan las caras; los que
+// ninguna cara usa se descartan
+void optimizeVertexFetch(std::vector<glm::vec3>& vertices, std::vector<Face>& faces) {
+    std::vector<int> remap(vertices.size(), -1);
+    std::vector<glm::vec3> ordered;
+    ordered.reserve(vertices.size());
+    for (Face& face : faces) {
+        for (int& index : face.vertexIndices) {
+            if (remap[index] < 0) {
+                remap[index] = static_cast<int>(ordered.size());
+                ordered.push_back(vertices[index]);
+            }
+            index = remap[index];
+        }
+    }
+    vertices = std::move(ordered);
+}
+
+// ---------------------------------------------------------------------------
+// Medición
+// ---------------------------------------------------------------------------
+
+struct VertexCacheStats {
+    double acmr = 0.0;          // Vértices transformados por triángulo (mínimo ~0.5)
+    double atvr = 0.0;          // Vértices transformados por vértice usado (mínimo 1)
+    double overfetch = 0.0;     // Bytes leídos de vértices por byte de vértice usado (mínimo 1)
+};
+
+// Simular una caché FIFO de vértices transformados y una caché de líneas
+// para la lectura de las posiciones
+VertexCacheStats measureVertexCache(const std::vector<Face>& faces, size_t vertexCount) {
+    VertexCacheStats stats;
+    if (faces.empty()) return stats;
+
+    // Una entrada sigue en la FIFO mientras no haya habido SIZE fallos
+    // después de que entró
+    std::vector<uint64_t> vertexStamp(vertexCount, 0);
+    uint64_t transforms = 0;
+    uint64_t vertexTime = VERTEX_CACHE_SIM_SIZE + 1;
+
+    size_t lineCount = vertexCount * sizeof(glm::vec3) / VERTEX_FETCH_LINE + 2;
+    std::vector<uint64_t> lineStamp(lineCount, 0);
+    uint64_t lineMisses = 0;
+    uint64_t lineTime = VERTEX_FETCH_LINES + 1;
+
+    std::vector<uint8_t> used(vertexCount, 0);
+    size_t usedCount = 0;
+
+    for (const Face& face : faces) {
+        for (int index : face.vertexIndices) {
+            if (vertexTime - vertexStamp[index] <= static_cast<uint64_t>(VERTEX_CACHE_SIM_SIZE)) continue;
+            vertexStamp[index] = vertexTime++;
+            transforms++;
+            if (!used[index]) {
+                used[index] = 1;
+                usedCount++;
+            }
+
+            size_t first = index * sizeof(glm::vec3) / VERTEX_FETCH_LINE;
+            size_t last = ((index + 1) * sizeof(glm::vec3) - 1) / VERTEX_FETCH_LINE;
+            for (size_t line = first; line <= last; line++) {
+                if (lineTime - lineStamp[line] <= static_cast<uint64_t>(VERTEX_FETCH_LINES)) continue;
+                lineStamp[line] = lineTime++;
+                lineMisses++;
+            }
+        }
+    }
+
+    stats.acmr = double(transforms) / faces.size();
+    stats.atvr = double(transforms) / usedCount;
+    stats.overfetch = double(lineMisses * VERTEX_FETCH_LINE) / (usedCount * sizeof(glm::vec3));
+    return stats;
+}
+
+// ---------------------------------------------------------------------------
+// Todo junto
+// ---------------------------------------------------------------------------
+
+struct MeshOptimizeStats {
+    size_t inputVertices = 0, inputFaces = 0;
+    size_t degenerateFaces = 0;         // Caras con dos índices iguales tras unir vértices
+    VertexCacheStats before, after;
+    size_t indexBytesBefore = 0;        // Índices de 32 bits, antes de optimizar
+    size_t indexBytesAfter = 0;         // IndexBuffer resultante
+    size_t vertexBytesBefore = 0, vertexBytesAfter = 0;
+};
+
+MeshOptimizeStats optimizeMesh(std::vector<glm::vec3>& vertices, std::vector<Face>& faces) {
+    MeshOptimizeStats stats;
+    stats.inputVertices = vertices.size();
+    stats.inputFaces = faces.size();
+    stats.before = measureVertexCache(faces, vertices.size());
+    stats.indexBytesBefore = faces.size() * 3 * sizeof(uint32_t);
+    stats.vertexBytesBefore = vertices.size() * sizeof(glm::vec3);
+
+    std::vector<int> welded = weldMatchingVertices(vertices, faces);
+    size_t kept = 0;
+    for (Face face : faces) {
+        for (int& index : face.vertexIndices) index = welded[index];
+        const auto& idx = face.vertexIndices;
+        if (idx[0] == idx[1] || idx[1] == idx[2] || idx[0] == idx[2]) continue;
+        faces[kept++] = face;
+    }
+    stats.degenerateFaces = faces.size() - kept;
+    faces.resize(kept);
+
+    optimizeVertexCache(faces, vertices.size());
+    optimizeVertexFetch(vertices, faces);
+
+    stats.after = measureVertexCache(faces, vertices.size());
+    stats.indexBytesAfter = faces.size() * 3 * (vertices.size() <= 65536 ? sizeof(uint16_t) : sizeof(uint32_t));
+    stats.vertexBytesAfter = vertices.size() * sizeof(glm::vec3);
+    return stats;
+}
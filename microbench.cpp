@@ -0,0 +1,398 @@
+#include <SDL2/SDL.h>
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "color.h"
+#include "framebuffer.h"
+#include "triangle.h"
+#include "bench.h"
+
+// Microbenchmarks de los núcleos del rasterizador: triangle(),
+// barycentric(), line(), clear() y el empaquetado de renderBuffer()
+// (packFrame), cada uno sobre cargas sintéticas.
+//
+// Las cargas salen de un generador con semilla fija, así que cada corrida
+// dibuja exactamente lo mismo. Cada caso se prepara fuera del tiempo
+// medido, se corre una vez para calentar y luego --reps veces; se reporta
+// la mediana y la dispersión (máximo - mínimo, relativa a la mediana).
+// Por defecto todo corre en un hilo para que los números sean estables.
+//
+// Los píxeles de triangle() y line() son los que llegaron al test de
+// profundidad (RasterStats::pixelsTested); los que descarta el Hi-Z por
+// bloques no cuentan.
+
+// Generador congruencial lineal: el mismo resultado en cualquier
+// plataforma, a diferencia de las distribuciones de <random>
+struct MicroRandom {
+    uint32_t state;
+
+    explicit MicroRandom(uint32_t seed) : state(seed) {}
+
+    // Uniforme en [0, 1)
+    float next() {
+        state = state * 1664525u + 1013904223u;
+        return (state >> 8) * (1.0f / 16777216.0f);
+    }
+
+    float range(float lo, float hi) {
+        return lo + (hi - lo) * next();
+    }
+};
+
+// Destino de los resultados que nadie usa, para que el compilador no quite
+// las llamadas
+volatile float microSink = 0.0f;
+
+struct MicroTriangle {
+    glm::vec3 v0, v1, v2;
+    Color color;
+};
+
+struct MicroLine {
+    int x1, y1, x2, y2;
+    Color color;
+};
+
+// Trabajo de una repetición: cuántos elementos y píxeles procesó
+struct MicroWork {
+    uint64_t items = 0;
+    uint64_t pixels = 0;
+};
+
+struct MicroCase {
+    std::string kernel;
+    std::string workload;
+    std::string unit;                   // Nombre de un elemento (triángulo, línea, frame...)
+    std::function<void()> prepare;      // Fuera del tiempo medido, antes de cada repetición
+    std::function<MicroWork()> run;
+};
+
+Color microColor(MicroRandom& random) {
+    return Color(static_cast<int>(random.range(32, 255)), static_cast<int>(random.range(32, 255)),
+                 static_cast<int>(random.range(32, 255)));
+}
+
+// ---------------------------------------------------------------------------
+// Cargas
+// ---------------------------------------------------------------------------
+
+// Triángulos de lado ~size con el centro en cualquier parte de la pantalla
+std::vector<MicroTriangle> scatteredTriangles(uint32_t seed, int count, float size) {
+    MicroRandom random(seed);
+    std::vector<MicroTriangle> out(count);
+    for (MicroTriangle& tri : out) {
+        glm::vec2 center(random.range(0, SCREEN_WIDTH), random.range(0, SCREEN_HEIGHT));
+        float z = random.range(0.05f, 0.95f);
+        float angle = random.range(0.0f, 6.2831853f);
+        for (int k = 0; k < 3; k++) {
+            float a = angle + k * 2.0943951f;
+            float r = size * random.range(0.4f, 0.7f);
+            glm::vec3 v(center.x + r * std::cos(a), center.y + r * std::sin(a), z);
+            (k == 0 ? tri.v0 : k == 1 ? tri.v1 : tri.v2) = v;
+        }
+        tri.color = microColor(random);
+    }
+    return out;
+}
+
+// Triángulos que cubren toda la pantalla, cada uno más cerca que el
+// anterior (todos pasan el test de profundidad)
+std::vector<MicroTriangle> fullScreenTriangles(int count) {
+    MicroRandom random(3);
+    std::vector<MicroTriangle> out(count);
+    for (int i = 0; i < count; i++) {
+        float z = 0.95f - 0.9f * i / count;
+        out[i].v0 = glm::vec3(-1.0f, -1.0f, z);
+        out[i].v1 = glm::vec3(2.0f * SCREEN_WIDTH + 1.0f, -1.0f, z);
+        out[i].v2 = glm::vec3(-1.0f, 2.0f * SCREEN_HEIGHT + 1.0f, z);
+        out[i].color = microColor(random);
+    }
+    return out;
+}
+
+// Astillas: largas (200 a 700 píxeles) y de uno o dos píxeles de ancho, en
+// cualquier dirección
+std::vector<MicroTriangle> sliverTriangles(int count) {
+    MicroRandom random(4);
+    std::vector<MicroTriangle> out(count);
+    for (MicroTriangle& tri : out) {
+        glm::vec2 start(random.range(0, SCREEN_WIDTH), random.range(0, SCREEN_HEIGHT));
+        float angle = random.range(0.0f, 6.2831853f);
+        float length = random.range(200.0f, 700.0f);
+        float width = random.range(0.5f, 2.0f);
+        glm::vec2 direction(std::cos(angle), std::sin(angle));
+        glm::vec2 side(-direction.y * width, direction.x * width);
+        float z = random.range(0.05f, 0.95f);
+        glm::vec2 end = start + direction * length;
+        tri.v0 = glm::vec3(start.x, start.y, z);
+        tri.v1 = glm::vec3(end.x, end.y, z);
+        tri.v2 = glm::vec3(start.x + side.x, start.y + side.y, z);
+        tri.color = microColor(random);
+    }
+    return out;
+}
+
+// Pila de cuadrados de 256x256 en el centro (dos triángulos por capa). De
+// atrás hacia adelante todas las capas se escriben; de adelante hacia atrás
+// sólo la primera y el resto se descarta por profundidad.
+std::vector<MicroTriangle> overdrawStack(int layers, bool backToFront) {
+    MicroRandom random(5);
+    std::vector<MicroTriangle> out;
+    float x0 = SCREEN_WIDTH / 2 - 128.0f, y0 = SCREEN_HEIGHT / 2 - 128.0f;
+    float x1 = x0 + 256.0f, y1 = y0 + 256.0f;
+    for (int i = 0; i < layers; i++) {
+        float t = static_cast<float>(i) / layers;
+        float z = backToFront ? 0.95f - 0.9f * t : 0.05f + 0.9f * t;
+        Color color = microColor(random);
+        out.push_back({glm::vec3(x0, y0, z), glm::vec3(x1, y0, z), glm::vec3(x1, y1, z), color});
+        out.push_back({glm::vec3(x0, y0, z), glm::vec3(x1, y1, z), glm::vec3(x0, y1, z), color});
+    }
+    return out;
+}
+
+std::vector<MicroLine> randomLines(uint32_t seed, int count, float minLength, float maxLength) {
+    MicroRandom random(seed);
+    std::vector<MicroLine> out(count);
+    for (MicroLine& line : out) {
+        float angle = random.range(0.0f, 6.2831853f);
+        float length = random.range(minLength, maxLength);
+        float x = random.range(0, SCREEN_WIDTH), y = random.range(0, SCREEN_HEIGHT);
+        line.x1 = static_cast<int>(x);
+        line.y1 = static_cast<int>(y);
+        line.x2 = static_cast<int>(x + length * std::cos(angle));
+        line.y2 = static_cast<int>(y + length * std::sin(angle));
+        line.color = microColor(random);
+    }
+    return out;
+}
+
+// ---------------------------------------------------------------------------
+// Casos
+// ---------------------------------------------------------------------------
+
+// Framebuffer global con el formato pedido, borrado
+void resetFramebuffer(FramebufferLayout layout, DepthFormat depth, bool lazy) {
+    if (framebuffer.layout != layout || framebuffer.depthFormat != depth) {
+        framebuffer = makeFramebuffer(SCREEN_WIDTH, SCREEN_HEIGHT, layout, depth);
+    }
+    framebuffer.lazyClear = lazy;
+    setRenderScale(1.0f);
+    clear(Color(0, 0, 0));
+}
+
+MicroCase triangleCase(const std::string& workload, std::vector<MicroTriangle> triangles) {
+    auto shared = std::make_shared<std::vector<MicroTriangle>>(std::move(triangles));
+    MicroCase c;
+    c.kernel = "triangle";
+    c.workload = workload;
+    c.unit = "triángulo";
+    c.prepare = [] { resetFramebuffer(FramebufferLayout::Linear, DepthFormat::Float32, true); };
+    c.run = [shared] {
+        uint64_t before = rasterStats.pixelsTested;
+        for (const MicroTriangle& tri : *shared) triangle(tri.v0, tri.v1, tri.v2, tri.color);
+        return MicroWork{shared->size(), rasterStats.pixelsTested - before};
+    };
+    return c;
+}
+
+MicroCase lineCase(const std::string& workload, std::vector<MicroLine> lines) {
+    auto shared = std::make_shared<std::vector<MicroLine>>(std::move(lines));
+    MicroCase c;
+    c.kernel = "line";
+    c.workload = workload;
+    c.unit = "línea";
+    c.prepare = [] { resetFramebuffer(FramebufferLayout::Linear, DepthFormat::Float32, true); };
+    c.run = [shared] {
+        uint64_t before = rasterStats.pixelsTested;
+        for (const MicroLine& l : *shared) line(l.x1, l.y1, l.x2, l.y2, l.color);
+        return MicroWork{shared->size(), rasterStats.pixelsTested - before};
+    };
+    return c;
+}
+
+// Puntos al azar contra triángulos medianos, como el recorrido por
+// bounding box que reemplazó el rasterizador por bordes
+MicroCase barycentricCase() {
+    const int pointCount = 1 << 20;
+    auto triangles = std::make_shared<std::vector<MicroTriangle>>(scatteredTriangles(6, 256, 24.0f));
+    auto points = std::make_shared<std::vector<glm::vec3>>(pointCount);
+    MicroRandom random(7);
+    for (size_t i = 0; i < points->size(); i++) {
+        const MicroTriangle& tri = (*triangles)[i % triangles->size()];
+        glm::vec3 low = glm::min(glm::min(tri.v0, tri.v1), tri.v2);
+        glm::vec3 high = glm::max(glm::max(tri.v0, tri.v1), tri.v2);
+        (*points)[i] = glm::vec3(random.range(low.x, high.x), random.range(low.y, high.y), 0.0f);
+    }
+
+    MicroCase c;
+    c.kernel = "barycentric";
+    c.workload = "bbox 24px";
+    c.unit = "punto";
+    c.prepare = [] {};
+    c.run = [triangles, points] {
+        float inside = 0.0f;
+        for (size_t i = 0; i < points->size(); i++) {
+            const MicroTriangle& tri = (*triangles)[i % triangles->size()];
+            glm::vec3 b = barycentric(tri.v0, tri.v1, tri.v2, (*points)[i]);
+            inside += (b.x >= 0.0f && b.y >= 0.0f && b.z >= 0.0f) ? 1.0f : 0.0f;
+        }
+        microSink = inside;
+        return MicroWork{points->size(), points->size()};
+    };
+    return c;
+}
+
+MicroCase clearCase(FramebufferLayout layout, DepthFormat depth, bool lazy) {
+    MicroCase c;
+    c.kernel = "clear";
+    c.workload = std::string(framebufferLayoutName(layout)) + " " + depthFormatName(depth) +
+                 (lazy ? " diferido" : "");
+    c.unit = "frame";
+    c.prepare = [layout, depth, lazy] { resetFramebuffer(layout, depth, lazy); };
+    c.run = [lazy] {
+        const int frames = 16;
+        for (int i = 0; i < frames; i++) {
+            clear(Color(i, 0, 0));
+            // Diferido: el costo está en resolver los bloques que nadie tocó
+            if (lazy) framebuffer.resolve();
+        }
+        return MicroWork{frames, static_cast<uint64_t>(frames) * framebuffer.width * framebuffer.height};
+    };
+    return c;
+}
+
+// Frame con triángulos medianos, empaquetado como para subirlo a la
+// textura; scale < 1 pasa por el escalado bilineal
+MicroCase packCase(FramebufferLayout layout, float scale) {
+    MicroCase c;
+    c.kernel = "pack";
+    c.workload = std::string(framebufferLayoutName(layout)) + (scale < 1.0f ? " bilinear" : "");
+    c.unit = "frame";
+    auto triangles = std::make_shared<std::vector<MicroTriangle>>(scatteredTriangles(8, 4000, 24.0f));
+    c.prepare = [layout, scale, triangles] {
+        resetFramebuffer(layout, DepthFormat::Float32, false);
+        setRenderScale(scale);
+        clear(Color(0, 0, 0));
+        for (const MicroTriangle& tri : *triangles) triangle(tri.v0, tri.v1, tri.v2, tri.color);
+        framebuffer.resolve();
+        upscaleMode = scale < 1.0f ? UPSCALE_BILINEAR : UPSCALE_SDL;
+    };
+    c.run = [] {
+        const int frames = 16;
+        uint64_t pixels = 0;
+        for (int i = 0; i < frames; i++) {
+            int width = 0, height = 0, stride = 0;
+            packFrame(framebuffer, width, height, stride);
+            pixels += static_cast<uint64_t>(width) * height;
+        }
+        return MicroWork{frames, pixels};
+    };
+    return c;
+}
+
+std::vector<MicroCase> microCases() {
+    std::vector<MicroCase> cases;
+    cases.push_back(triangleCase("diminutos", scatteredTriangles(1, 200000, 0.8f)));
+    cases.push_back(triangleCase("medianos", scatteredTriangles(2, 20000, 24.0f)));
+    cases.push_back(triangleCase("pantalla", fullScreenTriangles(32)));
+    cases.push_back(triangleCase("astillas", sliverTriangles(20000)));
+    cases.push_back(triangleCase("pila atrás-adelante", overdrawStack(256, true)));
+    cases.push_back(triangleCase("pila adelante-atrás", overdrawStack(256, false)));
+    cases.push_back(barycentricCase());
+    cases.push_back(lineCase("cortas", randomLines(9, 200000, 1.0f, 8.0f)));
+    cases.push_back(lineCase("largas", randomLines(10, 5000, 200.0f, 800.0f)));
+    for (FramebufferLayout layout : {FramebufferLayout::Linear, FramebufferLayout::Tiled}) {
+        for (DepthFormat depth : {DepthFormat::Float32, DepthFormat::Unorm24, DepthFormat::Unorm16}) {
+            cases.push_back(clearCase(layout, depth, false));
+        }
+    }
+    cases.push_back(clearCase(FramebufferLayout::Linear, DepthFormat::Float32, true));
+    cases.push_back(packCase(FramebufferLayout::Linear, 1.0f));
+    cases.push_back(packCase(FramebufferLayout::Tiled, 1.0f));
+    cases.push_back(packCase(FramebufferLayout::Linear, 0.5f));
+    return cases;
+}
+
+// ---------------------------------------------------------------------------
+// Medición
+// ---------------------------------------------------------------------------
+
+// Rellenar con espacios hasta width caracteres (no bytes: las tildes
+// ocupan dos en UTF-8)
+std::string padded(const std::string& text, size_t width) {
+    size_t characters = 0;
+    for (unsigned char c : text) {
+        if ((c & 0xC0) != 0x80) characters++;
+    }
+    return characters < width ? text + std::string(width - characters, ' ') : text;
+}
+
+void runMicroCase(const MicroCase& c, int reps) {
+    c.prepare();
+    MicroWork work = c.run();   // Calentar
+
+    std::vector<double> runNs;
+    for (int r = 0; r < reps; r++) {
+        c.prepare();
+        auto start = std::chrono::steady_clock::now();
+        work = c.run();
+        runNs.push_back(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count());
+    }
+
+    double median = percentile(runNs, 50.0);
+    double spread = median > 0.0
+        ? 100.0 * (*std::max_element(runNs.begin(), runNs.end()) - *std::min_element(runNs.begin(), runNs.end())) / median
+        : 0.0;
+    double perItem = work.items ? median / work.items : 0.0;
+    double perPixel = work.pixels ? median / work.pixels : 0.0;
+    double pixelsPerItem = work.items ? static_cast<double>(work.pixels) / work.items : 0.0;
+
+    std::printf("%s %s %9llu %s %12.1f %12.2f %10.3f %7.1f%%\n",
+                padded(c.kernel, 12).c_str(), padded(c.workload, 22).c_str(),
+                static_cast<unsigned long long>(work.items), padded(c.unit, 10).c_str(),
+                pixelsPerItem, perItem, perPixel, spread);
+    std::fflush(stdout);
+}
+
+int main(int argc, char* argv[]) {
+    int reps = 7;
+    std::string filter;
+    renderThreads = 1;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--raster" && i + 1 < argc) {
+            rasterPath = parseRasterPath(argv[++i]);
+        } else if (arg == "--reps" && i + 1 < argc) {
+            reps = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--filter" && i + 1 < argc) {
+            filter = argv[++i];
+        } else if (arg == "--threads" && i + 1 < argc) {
+            renderThreads = std::max(0, std::atoi(argv[++i]));
+        } else {
+            std::fprintf(stderr, "Uso: %s [--raster scalar|sse2|avx2] [--reps N] [--filter texto] [--threads N]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    std::printf("Rasterizador: %s, hilos: %d, repeticiones: %d, framebuffer %dx%d\n",
+                rasterPathName(rasterPath), renderPool().size(), reps, SCREEN_WIDTH, SCREEN_HEIGHT);
+    std::printf("%s %s %9s %s %12s %12s %s %8s\n",
+                padded("núcleo", 12).c_str(), padded("carga", 22).c_str(), "elementos", padded("", 10).c_str(),
+                "px/elemento", "ns/elemento", padded("  ns/píxel", 10).c_str(), "disp.");
+
+    for (const MicroCase& c : microCases()) {
+        std::string name = c.kernel + " " + c.workload;
+        if (!filter.empty() && name.find(filter) == std::string::npos) continue;
+        runMicroCase(c, reps);
+    }
+    return 0;
+}
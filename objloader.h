@@ -1,55 +1,396 @@
 #pragma once
 #include <glm/glm.hpp>
-#include <vector>
-#include <string>
-#include <fstream>
-#include <sstream>
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
 #include <iostream>
+#include <string>
+#include <vector>
+#include "mappedfile.h"
+#include "meshopt.h"
+#include "threadpool.h"
+
+// Cargador de OBJ.
+//
+// El archivo se mapea en memoria y se parsea directamente sobre los bytes
+// con std::from_chars, sin streams. Los archivos grandes se parten en
+// bloques de líneas que se parsean en paralelo. Soporta caras v, v/vt,
+// v//vn y v/vt/vn, índices negativos (relativos al último vértice) y
+// polígonos de más de 3 lados, que se triangulan en abanico.
+//
+// Después de parsear, la malla se optimiza (meshopt.h) y se guarda una
+// caché binaria junto al .obj (<archivo>.obj.meshcache) con los vértices y
+// el arreglo de índices; mientras el .obj no cambie, las siguientes cargas
+// sólo leen la caché.
 
-struct Face {
-    std::vector<int> vertexIndices;
+// Bloques de al menos este tamaño se parsean en paralelo
+const size_t OBJ_PARALLEL_CHUNK = 1 << 20;
+
+const char MESH_CACHE_MAGIC[8] = {'O', 'B', 'J', 'C', 'A', 'C', 'H', 'E'};
+const uint32_t MESH_CACHE_VERSION = 2;
+
+struct MeshCacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t indexSize;         // Bytes por índice: 2 o 4
+    uint64_t sourceSize;
+    int64_t sourceTime;
+    uint64_t vertexCount;
+    uint64_t faceCount;
 };
 
-bool loadOBJ(const std::string& path, std::vector<glm::vec3>& out_vertices, std::vector<Face>& out_faces) {
-    std::ifstream file(path);
-    if (!file.is_open()) {
-        std::cerr << "Error: No se pudo abrir el archivo " << path << std::endl;
-        return false;
+std::string meshCachePath(const std::string& path) {
+    return path + ".meshcache";
+}
+
+// Tamaño y fecha de modificación del .obj, para invalidar la caché
+bool sourceFileStamp(const std::string& path, uint64_t& size, int64_t& time) {
+    std::error_code error;
+    size = std::filesystem::file_size(path, error);
+    if (error) return false;
+    auto modified = std::filesystem::last_write_time(path, error);
+    if (error) return false;
+    time = static_cast<int64_t>(modified.time_since_epoch().count());
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Parser
+// ---------------------------------------------------------------------------
+
+inline bool isBlank(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+inline const char* skipBlanks(const char* p, const char* end) {
+    while (p < end && isBlank(*p)) p++;
+    return p;
+}
+
+inline const char* lineEnd(const char* p, const char* end) {
+    const char* newline = static_cast<const char*>(std::memchr(p, '\n', end - p));
+    return newline ? newline : end;
+}
+
+inline const char* parseFloat(const char* p, const char* end, float& value) {
+    p = skipBlanks(p, end);
+    if (p < end && *p == '+') p++;
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+    auto result = std::from_chars(p, end, value);
+    if (result.ec != std::errc()) {
+        value = 0.0f;
+        return p;
+    }
+    return result.ptr;
+#else
+    // Biblioteca estándar sin from_chars para float
+    char buffer[64];
+    size_t n = std::min<size_t>(sizeof(buffer) - 1, end - p);
+    std::memcpy(buffer, p, n);
+    buffer[n] = '\0';
+    char* stop = nullptr;
+    value = std::strtof(buffer, &stop);
+    return p + (stop - buffer);
+#endif
+}
+
+inline const char* parseInt(const char* p, const char* end, long long& value, bool& ok) {
+    auto result = std::from_chars(p, end, value);
+    ok = result.ec == std::errc();
+    return ok ? result.ptr : p;
+}
+
+// Resultado de parsear un bloque de líneas
+struct ObjChunk {
+    const char* begin = nullptr;
+    const char* end = nullptr;
+    size_t vertexCount = 0;      // Líneas "v" del bloque (primera pasada)
+    size_t vertexOffset = 0;     // Vértices en los bloques anteriores
+    std::vector<Face> faces;
+    size_t skippedFaces = 0;
+};
+
+inline bool isVertexLine(const char* p, const char* end) {
+    return end - p >= 2 && p[0] == 'v' && isBlank(p[1]);
+}
+
+inline bool isFaceLine(const char* p, const char* end) {
+    return end - p >= 2 && p[0] == 'f' && isBlank(p[1]);
+}
+
+// Primera pasada: contar vértices, para saber dónde empieza cada bloque en
+// el arreglo final y resolver índices negativos
+void countObjChunk(ObjChunk& chunk) {
+    const char* p = chunk.begin;
+    while (p < chunk.end) {
+        const char* eol = lineEnd(p, chunk.end);
+        const char* q = skipBlanks(p, eol);
+        if (isVertexLine(q, eol)) chunk.vertexCount++;
+        p = eol + 1;
     }
+}
 
-    std::string line;
-    while (std::getline(file, line)) {
-        std::istringstream iss(line);
-        std::string prefix;
-        iss >> prefix;
+// Segunda pasada: escribir los vértices en su lugar y triangular las caras
+void parseObjChunk(ObjChunk& chunk, glm::vec3* outVertices, size_t totalVertices) {
+    std::vector<long long> corners;
+    size_t vertexIndex = chunk.vertexOffset;
 
-        if (prefix == "v") {
-            // Vertex
+    const char* p = chunk.begin;
+    while (p < chunk.end) {
+        const char* eol = lineEnd(p, chunk.end);
+        const char* q = skipBlanks(p, eol);
+
+        if (isVertexLine(q, eol)) {
             glm::vec3 vertex;
-            iss >> vertex.x >> vertex.y >> vertex.z;
-            out_vertices.push_back(vertex);
+            q = parseFloat(q + 2, eol, vertex.x);
+            q = parseFloat(q, eol, vertex.y);
+            parseFloat(q, eol, vertex.z);
+            outVertices[vertexIndex++] = vertex;
         }
-        else if (prefix == "f") {
-            // Face
-            Face face;
-            std::string vertexStr;
-            while (iss >> vertexStr) {
-                std::istringstream viss(vertexStr);
-                int vertexIndex;
-                char slash;
-                
-                // Leer el primer número (índice del vértice)
-                viss >> vertexIndex;
-                face.vertexIndices.push_back(vertexIndex - 1); // OBJ usa índices base 1
-                
-                // Ignorar texture/normal indices si existen
+        else if (isFaceLine(q, eol)) {
+            corners.clear();
+            bool valid = true;
+            q += 2;
+
+            while (true) {
+                q = skipBlanks(q, eol);
+                if (q >= eol) break;
+
+                long long index = 0;
+                bool ok = false;
+                q = parseInt(q, eol, index, ok);
+                if (!ok || index == 0) {
+                    valid = false;
+                    break;
+                }
+
+                // OBJ usa índices base 1; los negativos cuentan desde el
+                // último vértice leído hasta esta línea
+                long long resolved = index > 0 ? index - 1 : static_cast<long long>(vertexIndex) + index;
+                if (resolved < 0 || resolved >= static_cast<long long>(totalVertices)) {
+                    valid = false;
+                    break;
+                }
+                corners.push_back(resolved);
+
+                // Ignorar los índices de textura y normal (/vt/vn)
+                while (q < eol && !isBlank(*q)) q++;
+            }
+
+            if (!valid || corners.size() < 3) {
+                chunk.skippedFaces++;
+            } else {
+                for (size_t i = 1; i + 1 < corners.size(); i++) {
+                    Face face;
+                    face.vertexIndices = {static_cast<int>(corners[0]),
+                                          static_cast<int>(corners[i]),
+                                          static_cast<int>(corners[i + 1])};
+                    chunk.faces.push_back(face);
+                }
             }
+        }
+
+        p = eol + 1;
+    }
+}
+
+bool parseOBJ(const std::string& path, std::vector<glm::vec3>& out_vertices, std::vector<Face>& out_faces) {
+    MappedFile file;
+    if (!file.open(path)) {
+        std::cerr << "Error: No se pudo abrir el archivo " << path << std::endl;
+        return false;
+    }
+
+    const char* data = file.data();
+    const char* end = data + file.size();
+
+    // Partir el archivo en bloques que terminan en fin de línea
+    ThreadPool& pool = renderPool();
+    size_t chunkCount = std::max<size_t>(1, std::min<size_t>(file.size() / OBJ_PARALLEL_CHUNK, pool.size() * 4));
+    std::vector<ObjChunk> chunks(chunkCount);
+    const char* start = data;
+    for (size_t i = 0; i < chunkCount; i++) {
+        const char* stop = (i + 1 == chunkCount) ? end : data + file.size() * (i + 1) / chunkCount;
+        if (stop < start) stop = start;
+        if (stop < end) stop = std::min(end, lineEnd(stop, end) + 1);
+        chunks[i].begin = start;
+        chunks[i].end = stop;
+        start = stop;
+    }
+
+    pool.parallelFor(static_cast<int>(chunkCount), [&](int i, int) {
+        countObjChunk(chunks[i]);
+    });
+
+    size_t totalVertices = 0;
+    for (auto& chunk : chunks) {
+        chunk.vertexOffset = totalVertices;
+        totalVertices += chunk.vertexCount;
+    }
+
+    size_t firstVertex = out_vertices.size();
+    out_vertices.resize(firstVertex + totalVertices);
+    glm::vec3* vertexData = out_vertices.data() + firstVertex;
+
+    pool.parallelFor(static_cast<int>(chunkCount), [&](int i, int) {
+        parseObjChunk(chunks[i], vertexData, totalVertices);
+    });
+
+    size_t totalFaces = 0;
+    size_t skipped = 0;
+    for (const auto& chunk : chunks) {
+        totalFaces += chunk.faces.size();
+        skipped += chunk.skippedFaces;
+    }
+
+    out_faces.reserve(out_faces.size() + totalFaces);
+    for (auto& chunk : chunks) {
+        for (Face face : chunk.faces) {
+            for (int& index : face.vertexIndices) index += static_cast<int>(firstVertex);
             out_faces.push_back(face);
         }
     }
 
-    file.close();
-    std::cout << "Modelo cargado: " << out_vertices.size() << " vertices, " 
-              << out_faces.size() << " faces" << std::endl;
+    if (skipped > 0) {
+        std::cerr << "Aviso: " << skipped << " caras con índices inválidos ignoradas" << std::endl;
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Caché binaria
+// ---------------------------------------------------------------------------
+
+bool readMeshCache(const std::string& path, std::vector<glm::vec3>& out_vertices, std::vector<Face>& out_faces) {
+    uint64_t sourceSize;
+    int64_t sourceTime;
+    if (!sourceFileStamp(path, sourceSize, sourceTime)) return false;
+
+    std::string cachePath = meshCachePath(path);
+    std::error_code error;
+    uint64_t cacheSize = std::filesystem::file_size(cachePath, error);
+    if (error) return false;
+
+    FILE* file = std::fopen(cachePath.c_str(), "rb");
+    if (!file) return false;
+
+    MeshCacheHeader header;
+    bool ok = std::fread(&header, sizeof(header), 1, file) == 1 &&
+              std::memcmp(header.magic, MESH_CACHE_MAGIC, sizeof(header.magic)) == 0 &&
+              header.version == MESH_CACHE_VERSION &&
+              header.sourceSize == sourceSize &&
+              header.sourceTime == sourceTime;
+
+    // Las cantidades del encabezado deben dar exactamente el tamaño del
+    // archivo antes de reservar nada (sin desbordar si están corruptas)
+    if (ok) {
+        uint64_t indexSize = header.vertexCount <= 65536 ? 2 : 4;
+        uint64_t body = cacheSize - sizeof(header);
+        ok = header.indexSize == indexSize &&
+             header.vertexCount <= body / sizeof(glm::vec3) &&
+             header.faceCount <= (body - header.vertexCount * sizeof(glm::vec3)) / (3 * indexSize) &&
+             body == header.vertexCount * sizeof(glm::vec3) + header.faceCount * 3 * indexSize;
+    }
+
+    if (ok) {
+        std::vector<glm::vec3> cachedVertices(header.vertexCount);
+        IndexBuffer cachedIndices;
+        cachedIndices.resize(header.faceCount * 3, header.vertexCount);
+        ok = std::fread(cachedVertices.data(), sizeof(glm::vec3), cachedVertices.size(), file) == cachedVertices.size() &&
+             std::fread(cachedIndices.data(), cachedIndices.indexSize(), cachedIndices.size(), file) == cachedIndices.size();
+
+        for (size_t i = 0; ok && i < cachedIndices.size(); i++) {
+            if (cachedIndices[i] >= header.vertexCount) ok = false;
+        }
+
+        if (ok) {
+            out_vertices.insert(out_vertices.end(), cachedVertices.begin(), cachedVertices.end());
+            expandIndexBuffer(cachedIndices, out_faces);
+        }
+    }
+
+    std::fclose(file);
+    return ok;
+}
+
+void writeMeshCache(const std::string& path, const std::vector<glm::vec3>& vertices, const std::vector<Face>& faces) {
+    IndexBuffer indices;
+    buildIndexBuffer(faces, vertices.size(), indices);
+
+    MeshCacheHeader header = {};
+    std::memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(header.magic));
+    header.version = MESH_CACHE_VERSION;
+    header.indexSize = static_cast<uint32_t>(indices.indexSize());
+    header.vertexCount = vertices.size();
+    header.faceCount = faces.size();
+    if (!sourceFileStamp(path, header.sourceSize, header.sourceTime)) return;
+
+    // Escribir a un temporal y renombrar, para no dejar cachés a medias
+    std::string cachePath = meshCachePath(path);
+    std::string tempPath = cachePath + ".tmp";
+    FILE* file = std::fopen(tempPath.c_str(), "wb");
+    if (!file) {
+        std::cerr << "Aviso: No se pudo escribir la caché " << cachePath << std::endl;
+        return;
+    }
+
+    bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+              std::fwrite(vertices.data(), sizeof(glm::vec3), vertices.size(), file) == vertices.size() &&
+              std::fwrite(indices.data(), indices.indexSize(), indices.size(), file) == indices.size();
+    ok = std::fclose(file) == 0 && ok;
+
+    std::error_code error;
+    if (ok) std::filesystem::rename(tempPath, cachePath, error);
+    if (!ok || error) {
+        std::filesystem::remove(tempPath, error);
+        std::cerr << "Aviso: No se pudo escribir la caché " << cachePath << std::endl;
+    }
+}
+
+bool loadOBJ(const std::string& path, std::vector<glm::vec3>& out_vertices, std::vector<Face>& out_faces,
+             bool useCache = true) {
+    auto start = std::chrono::steady_clock::now();
+    bool fromCache = false;
+
+    // La caché y la optimización tratan la malla completa, sólo sirven si
+    // los arreglos están vacíos
+    bool wholeMesh = out_vertices.empty() && out_faces.empty();
+    useCache = useCache && wholeMesh;
+
+    bool optimized = false;
+    MeshOptimizeStats optimizeStats;
+    if (useCache && readMeshCache(path, out_vertices, out_faces)) {
+        fromCache = true;
+    } else {
+        if (!parseOBJ(path, out_vertices, out_faces)) return false;
+        if (wholeMesh) {
+            optimizeStats = optimizeMesh(out_vertices, out_faces);
+            optimized = true;
+        }
+        if (useCache) writeMeshCache(path, out_vertices, out_faces);
+    }
+
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Modelo cargado: " << out_vertices.size() << " vertices, "
+              << out_faces.size() << " faces (" << ms << " ms"
+              << (fromCache ? ", desde caché" : "") << ")" << std::endl;
+
+    if (optimized) {
+        const MeshOptimizeStats& s = optimizeStats;
+        std::cout << "Optimización: " << s.inputVertices << " -> " << out_vertices.size() << " vértices, "
+                  << s.degenerateFaces << " caras degeneradas quitadas" << std::endl;
+        std::cout << "  ACMR (FIFO de " << VERTEX_CACHE_SIM_SIZE << "): " << s.before.acmr << " -> " << s.after.acmr
+                  << ", ATVR: " << s.before.atvr << " -> " << s.after.atvr
+                  << ", lectura de vértices: " << s.before.overfetch << "x -> " << s.after.overfetch << "x" << std::endl;
+        std::cout << "  Índices: " << s.indexBytesBefore << " -> " << s.indexBytesAfter << " bytes ("
+                  << (out_vertices.size() <= 65536 ? 16 : 32) << " bits), vértices: "
+                  << s.vertexBytesBefore << " -> " << s.vertexBytesAfter << " bytes" << std::endl;
+    }
     return true;
-}
\ No newline at end of file
+}
@@ -0,0 +1,103 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "profiler.h"
+
+// Pipeline de frames: la rasterización de un frame corre en su propio hilo
+// mientras el hilo principal presenta el frame anterior y arma la geometría
+// (nivel de detalle, descarte, transformación y orden) del siguiente.
+//
+// Con dos framebuffers basta: uno lo escribe la rasterización y el otro se
+// presenta. El hilo principal espera a que termine el frame N antes de
+// enviar el N+1, así que nunca hay más de un frame en vuelo y la imagen
+// llega a la pantalla a lo sumo un frame más tarde que sin pipeline.
+//
+// Las dos etapas comparten el pool de render; sus parallelFor se turnan.
+
+// Hilo que ejecuta de a un trabajo por vez
+class FrameStageThread {
+public:
+    FrameStageThread() : thread([this] { stageLoop(); }) {}
+
+    ~FrameStageThread() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_one();
+        thread.join();
+    }
+
+    FrameStageThread(const FrameStageThread&) = delete;
+    FrameStageThread& operator=(const FrameStageThread&) = delete;
+
+    // Ejecutar fn en el hilo de la etapa, después de que termine el trabajo
+    // anterior
+    void submit(std::function<void()> fn) {
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] { return !hasJob; });
+        job = std::move(fn);
+        hasJob = true;
+        wake.notify_one();
+    }
+
+    // Esperar a que termine el último trabajo enviado
+    void wait() {
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] { return !hasJob; });
+    }
+
+    // Lo que tardó el último trabajo terminado (válido después de wait)
+    double lastMs() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return jobMs;
+    }
+
+private:
+    void stageLoop() {
+        profileThread = PROFILE_THREAD_PIPELINE;
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            wake.wait(lock, [this] { return stopping || hasJob; });
+            if (!hasJob) return;
+
+            lock.unlock();
+            auto start = std::chrono::steady_clock::now();
+            job();
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            lock.lock();
+
+            job = nullptr;
+            jobMs = ms;
+            hasJob = false;
+            done.notify_all();
+        }
+    }
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    std::function<void()> job;
+    bool hasJob = false;
+    bool stopping = false;
+    double jobMs = 0.0;
+
+    // Último: arranca cuando el resto ya está construido
+    std::thread thread;
+};
+
+// Usar el pipeline en la ventana y en el benchmark sin ventana
+// (--no-pipeline vuelve al frame completamente secuencial)
+bool framePipelining = true;
+
+std::unique_ptr<FrameStageThread> rasterStageInstance;
+
+// Hilo de la rasterización, creado la primera vez que se usa
+FrameStageThread& rasterStage() {
+    if (!rasterStageInstance) rasterStageInstance.reset(new FrameStageThread());
+    return *rasterStageInstance;
+}
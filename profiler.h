@@ -0,0 +1,288 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Instrumentación por etapas: cuánto tarda cada etapa del frame y cuántos
+// triángulos y píxeles pasan por cada una.
+//
+// Las etapas se miden con PROFILE_SCOPE(etapa), que toma el tiempo al
+// entrar y al salir del bloque; los contadores se suman con
+// PROFILE_COUNT(contador, valor). Pueden usarlos el hilo principal y el de
+// la rasterización del pipeline de frames; las etapas paralelas se miden
+// desde quien llama a parallelFor, no desde las tareas.
+//
+// Con el pipeline el hilo principal empieza el frame N + 1 mientras el otro
+// hilo todavía rasteriza el N, así que lo que mide ese hilo va a su propio
+// bloque y se suma con PROFILE_MERGE_PIPELINE() al recoger el frame. Cada
+// frame del perfilador junta entonces el armado de un frame con la
+// rasterización del anterior; los acumulados cuentan todo una sola vez.
+//
+// Con RENDERER_NO_PROFILING definido las macros no generan código y el
+// perfilador nunca se llama.
+
+#ifdef RENDERER_NO_PROFILING
+#define RENDERER_PROFILING 0
+#else
+#define RENDERER_PROFILING 1
+#endif
+
+enum ProfileStage {
+    PROFILE_CLEAR,
+    PROFILE_CULL,           // Nivel de detalle y descarte de clusters
+    PROFILE_TRANSFORM,
+    PROFILE_ASSEMBLE,       // Cara trasera, recorte y armado de triángulos
+    PROFILE_INSTANCES,      // Descarte, transformación y armado de instancias (en paralelo)
+    PROFILE_STREAM,         // Carga de chunks de una malla fuera de memoria
+    PROFILE_SHADE,
+    PROFILE_SORT,
+    PROFILE_BIN,
+    PROFILE_RASTER,
+    PROFILE_VISIBILITY,     // Sombreado de los píxeles visibles del buffer de visibilidad
+    PROFILE_LINES,          // Aristas de la malla de alambre (reparto y dibujo)
+    PROFILE_RESOLVE,        // Bloques sin tocar del borrado diferido
+    PROFILE_HUD,
+    PROFILE_PRESENT,
+    PROFILE_STAGE_COUNT
+};
+
+const char* const PROFILE_STAGE_NAMES[PROFILE_STAGE_COUNT] = {
+    "clear", "cull", "transform", "assemble", "instances", "stream", "shade",
+    "sort", "bin", "raster", "vis shade", "lines", "resolve", "hud", "present"
+};
+
+enum ProfileCounter {
+    COUNTER_TRIANGLES_SUBMITTED,    // Triángulos de los clusters considerados
+    COUNTER_TRIANGLES_CULLED,       // Descartados antes de rasterizar (frustum, cono, espaldas, recorte)
+    COUNTER_TRIANGLES_DRAWN,        // Enviados al rasterizador
+    COUNTER_TRIANGLES_HIZ,          // Descartados enteros por el Hi-Z de los tiles
+    COUNTER_PIXELS_TESTED,
+    COUNTER_PIXELS_WRITTEN,
+    COUNTER_PIXELS_SCREEN,          // Píxeles de la resolución interna
+    PROFILE_COUNTER_COUNT
+};
+
+const char* const PROFILE_COUNTER_NAMES[PROFILE_COUNTER_COUNT] = {
+    "submitted", "culled", "drawn", "hiz", "tested", "written", "screen"
+};
+
+// Hilo que mide, para separar las etapas en la traza
+enum ProfileThread {
+    PROFILE_THREAD_MAIN = 1,
+    PROFILE_THREAD_PIPELINE = 2     // Rasterización del pipeline de frames
+};
+
+thread_local int profileThread = PROFILE_THREAD_MAIN;
+
+// Intervalo medido, para exportar
+struct ProfileEvent {
+    int stage;                  // -1 = el frame completo
+    int thread;                 // ProfileThread
+    int64_t startNs, durationNs;
+};
+
+// Contadores de un frame, para exportar
+struct ProfileCounterSample {
+    int64_t timeNs;
+    uint64_t values[PROFILE_COUNTER_COUNT];
+};
+
+struct Profiler {
+    using Clock = std::chrono::steady_clock;
+
+    Clock::time_point origin = Clock::now();
+    int64_t frameStartNs = 0;
+
+    // Frame en curso
+    int64_t stageNs[PROFILE_STAGE_COUNT] = {};
+    uint64_t counters[PROFILE_COUNTER_COUNT] = {};
+    bool inFrame = false;
+
+    // Lo que midió el hilo del pipeline desde la última vez que se sumó
+    int64_t pipelineStageNs[PROFILE_STAGE_COUNT] = {};
+    uint64_t pipelineCounters[PROFILE_COUNTER_COUNT] = {};
+
+    // Último frame completo (lo que muestra el HUD)
+    double lastStageMs[PROFILE_STAGE_COUNT] = {};
+    uint64_t lastCounters[PROFILE_COUNTER_COUNT] = {};
+    double lastFrameMs = 0.0;
+    double smoothedFrameMs = 0.0;
+
+    // Acumulados desde el último reset
+    double totalStageMs[PROFILE_STAGE_COUNT] = {};
+    uint64_t totalCounters[PROFILE_COUNTER_COUNT] = {};
+    int frames = 0;
+
+    // Traza para chrome://tracing; se guarda sólo si tracing está activo
+    bool tracing = false;
+    size_t maxEvents = 1 << 20;
+    std::vector<ProfileEvent> events;
+    std::vector<ProfileCounterSample> counterSamples;
+
+    // Con el pipeline de frames las etapas llegan desde dos hilos
+    std::mutex mutex;
+
+    int64_t now() const {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - origin).count();
+    }
+
+    void beginFrame() {
+        std::lock_guard<std::mutex> lock(mutex);
+        frameStartNs = now();
+        std::fill(stageNs, stageNs + PROFILE_STAGE_COUNT, 0);
+        std::fill(counters, counters + PROFILE_COUNTER_COUNT, 0);
+        inFrame = true;
+    }
+
+    void addStage(int stage, int64_t startNs, int64_t endNs) {
+        std::lock_guard<std::mutex> lock(mutex);
+        int64_t* target = profileThread == PROFILE_THREAD_PIPELINE ? pipelineStageNs : stageNs;
+        target[stage] += endNs - startNs;
+        if (tracing && events.size() < maxEvents) {
+            events.push_back(ProfileEvent{stage, profileThread, startNs, endNs - startNs});
+        }
+    }
+
+    void count(int counter, uint64_t value) {
+        std::lock_guard<std::mutex> lock(mutex);
+        uint64_t* target = profileThread == PROFILE_THREAD_PIPELINE ? pipelineCounters : counters;
+        target[counter] += value;
+    }
+
+    // Sumar lo que midió el hilo del pipeline (ya en espera) al frame en
+    // curso, o directamente a los acumulados si se recoge fuera de un frame
+    void mergePipeline() {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (int i = 0; i < PROFILE_STAGE_COUNT; i++) {
+            if (inFrame) stageNs[i] += pipelineStageNs[i];
+            else totalStageMs[i] += pipelineStageNs[i] / 1e6;
+        }
+        for (int i = 0; i < PROFILE_COUNTER_COUNT; i++) {
+            if (inFrame) counters[i] += pipelineCounters[i];
+            else totalCounters[i] += pipelineCounters[i];
+        }
+        std::fill(pipelineStageNs, pipelineStageNs + PROFILE_STAGE_COUNT, 0);
+        std::fill(pipelineCounters, pipelineCounters + PROFILE_COUNTER_COUNT, 0);
+    }
+
+    void endFrame() {
+        std::lock_guard<std::mutex> lock(mutex);
+        int64_t endNs = now();
+        inFrame = false;
+        lastFrameMs = (endNs - frameStartNs) / 1e6;
+        smoothedFrameMs = smoothedFrameMs > 0.0 ? smoothedFrameMs * 0.9 + lastFrameMs * 0.1 : lastFrameMs;
+
+        for (int i = 0; i < PROFILE_STAGE_COUNT; i++) {
+            lastStageMs[i] = stageNs[i] / 1e6;
+            totalStageMs[i] += lastStageMs[i];
+        }
+        for (int i = 0; i < PROFILE_COUNTER_COUNT; i++) {
+            lastCounters[i] = counters[i];
+            totalCounters[i] += counters[i];
+        }
+        frames++;
+
+        if (tracing && events.size() < maxEvents) {
+            events.push_back(ProfileEvent{-1, profileThread, frameStartNs, endNs - frameStartNs});
+            ProfileCounterSample sample;
+            sample.timeNs = endNs;
+            std::copy(counters, counters + PROFILE_COUNTER_COUNT, sample.values);
+            counterSamples.push_back(sample);
+        }
+    }
+
+    void resetTotals() {
+        std::fill(totalStageMs, totalStageMs + PROFILE_STAGE_COUNT, 0.0);
+        std::fill(totalCounters, totalCounters + PROFILE_COUNTER_COUNT, 0);
+        frames = 0;
+    }
+
+    // Veces que se escribe cada píxel de la pantalla en promedio
+    static double overdraw(const uint64_t* values) {
+        return values[COUNTER_PIXELS_SCREEN] ? static_cast<double>(values[COUNTER_PIXELS_WRITTEN]) / values[COUNTER_PIXELS_SCREEN] : 0.0;
+    }
+
+    // Promedios por frame de las etapas y los contadores
+    void printSummary() const {
+        double n = std::max(1, frames);
+        std::cout << "Etapas (ms por frame):";
+        for (int i = 0; i < PROFILE_STAGE_COUNT; i++) {
+            if (totalStageMs[i] > 0.0) std::cout << " " << PROFILE_STAGE_NAMES[i] << "=" << totalStageMs[i] / n;
+        }
+        std::cout << std::endl;
+        std::cout << "Triángulos por frame: " << totalCounters[COUNTER_TRIANGLES_SUBMITTED] / n << " enviados, "
+                  << totalCounters[COUNTER_TRIANGLES_CULLED] / n << " descartados, "
+                  << totalCounters[COUNTER_TRIANGLES_DRAWN] / n << " rasterizados ("
+                  << totalCounters[COUNTER_TRIANGLES_HIZ] / n << " descartados por Hi-Z)" << std::endl;
+        std::cout << "Overdraw: " << overdraw(totalCounters) << " escrituras por píxel" << std::endl;
+    }
+
+    // Guardar la traza en el formato JSON de chrome://tracing (y Perfetto)
+    bool writeChromeTrace(const std::string& path) const {
+        std::ofstream out(path);
+        if (!out) {
+            std::cerr << "Error: No se pudo escribir la traza " << path << std::endl;
+            return false;
+        }
+
+        out << "{\"traceEvents\":[\n";
+        bool first = true;
+        auto separator = [&]() {
+            if (!first) out << ",\n";
+            first = false;
+        };
+        for (const ProfileEvent& e : events) {
+            separator();
+            out << "{\"name\":\"" << (e.stage < 0 ? "frame" : PROFILE_STAGE_NAMES[e.stage])
+                << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << e.thread << ",\"ts\":" << e.startNs / 1000.0
+                << ",\"dur\":" << e.durationNs / 1000.0 << "}";
+        }
+        for (const ProfileCounterSample& sample : counterSamples) {
+            separator();
+            out << "{\"name\":\"triangles\",\"ph\":\"C\",\"pid\":1,\"ts\":" << sample.timeNs / 1000.0 << ",\"args\":{";
+            for (int i = COUNTER_TRIANGLES_SUBMITTED; i <= COUNTER_TRIANGLES_HIZ; i++) {
+                out << (i ? "," : "") << "\"" << PROFILE_COUNTER_NAMES[i] << "\":" << sample.values[i];
+            }
+            out << "}},\n{\"name\":\"pixels\",\"ph\":\"C\",\"pid\":1,\"ts\":" << sample.timeNs / 1000.0 << ",\"args\":{"
+                << "\"tested\":" << sample.values[COUNTER_PIXELS_TESTED]
+                << ",\"written\":" << sample.values[COUNTER_PIXELS_WRITTEN] << "}}";
+        }
+        out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+        return static_cast<bool>(out);
+    }
+};
+
+Profiler profiler;
+
+// Mide el bloque en el que se declara
+struct ProfileScope {
+    int stage;
+    int64_t start;
+
+    explicit ProfileScope(int s) : stage(s), start(profiler.now()) {}
+
+    ~ProfileScope() {
+        profiler.addStage(stage, start, profiler.now());
+    }
+};
+
+#if RENDERER_PROFILING
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(stage) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(stage)
+#define PROFILE_COUNT(counter, value) profiler.count(counter, value)
+#define PROFILE_BEGIN_FRAME() profiler.beginFrame()
+#define PROFILE_END_FRAME() profiler.endFrame()
+#define PROFILE_MERGE_PIPELINE() profiler.mergePipeline()
+#else
+#define PROFILE_SCOPE(stage) ((void)0)
+#define PROFILE_COUNT(counter, value) ((void)0)
+#define PROFILE_BEGIN_FRAME() ((void)0)
+#define PROFILE_END_FRAME() ((void)0)
+#define PROFILE_MERGE_PIPELINE() ((void)0)
+#endif
@@ -0,0 +1,897 @@
+#pragma once
+#include <SDL2/SDL.h>
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <type_traits>
+#include "color.h"
+#include "framebuffer.h"
+
+// Rasterizador por funciones de borde (edge functions) en punto fijo.
+//
+// - Los vértices se ajustan a 1/16 de píxel, así las funciones de borde son
+//   enteras y exactas: dos triángulos que comparten un borde obtienen
+//   exactamente los mismos valores (con signo contrario).
+// - Regla top-left: un píxel que cae justo sobre un borde compartido se
+//   dibuja sólo una vez.
+// - Se recorre el bounding box en bloques de 8x8. Los bloques que quedan
+//   completamente fuera de algún borde se descartan antes de tocar un píxel,
+//   y los que quedan completamente dentro se dibujan sin evaluar bordes.
+// - Dentro de un bloque se procesan 4 (SSE2) u 8 (AVX2) píxeles por
+//   instrucción. El camino se elige en tiempo de ejecución, con una versión
+//   escalar como respaldo.
+// - Hi-Z: cada bloque de 8x8 guarda la profundidad máxima que tiene en el
+//   z-buffer. Si la profundidad mínima del triángulo dentro del bloque no
+//   es menor, el bloque se descarta sin leer el z-buffer.
+// - Los núcleos están parametrizados por el formato de profundidad (float,
+//   24 o 16 bits) y leen cada fila de un bloque con pixelOffset, así que
+//   sirven igual para la disposición lineal y la disposición por bloques.
+//   SSE2 sólo tiene núcleo para float; los formatos enteros usan el escalar.
+// - También están parametrizados por el origen del color (FlatPixels o un
+//   shader por píxel, ver shading.h). Con FlatPixels el color es constante
+//   y el bucle es el mismo sin interpolación de siempre; un shader sólo
+//   se evalúa en los píxeles que pasaron el test de profundidad.
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define RASTER_HAS_X86 1
+#include <immintrin.h>
+#else
+#define RASTER_HAS_X86 0
+#endif
+
+// GCC y Clang necesitan marcar las funciones que usan AVX2 cuando el resto
+// del programa se compila para x86-64 base; MSVC no lo necesita.
+#if RASTER_HAS_X86 && (defined(__GNUC__) || defined(__clang__))
+#define RASTER_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define RASTER_TARGET_AVX2
+#endif
+
+// Tamaño de bloque (en píxeles) y precisión subpíxel
+const int RASTER_BLOCK = 8;
+const int RASTER_SUBPIXEL_BITS = 4;
+const int RASTER_SUBPIXEL = 1 << RASTER_SUBPIXEL_BITS;
+
+// Coordenadas mayores que esto (en píxeles) no se pueden ajustar a punto fijo
+// sin desbordar los productos de 64 bits
+const float RASTER_MAX_COORD = 16777216.0f;
+
+enum class RasterPath {
+    Scalar,
+    SSE2,
+    AVX2
+};
+
+const char* rasterPathName(RasterPath path) {
+    switch (path) {
+        case RasterPath::AVX2: return "avx2";
+        case RasterPath::SSE2: return "sse2";
+        default: return "scalar";
+    }
+}
+
+// Elegir el mejor camino disponible en este CPU
+RasterPath detectRasterPath() {
+#if RASTER_HAS_X86
+    if (SDL_HasAVX2()) return RasterPath::AVX2;
+    if (SDL_HasSSE2()) return RasterPath::SSE2;
+#endif
+    return RasterPath::Scalar;
+}
+
+// Convertir un nombre ("scalar", "sse2", "avx2") a un camino soportado.
+// Si el CPU no soporta el camino pedido se usa el mejor disponible.
+RasterPath parseRasterPath(const std::string& name) {
+    RasterPath best = detectRasterPath();
+    if (name == "scalar") return RasterPath::Scalar;
+    if (name == "sse2" && best != RasterPath::Scalar) return RasterPath::SSE2;
+    if (name == "avx2" && best == RasterPath::AVX2) return RasterPath::AVX2;
+    return best;
+}
+
+RasterPath rasterPath = detectRasterPath();
+
+// Usar el Hi-Z para descartar bloques (y triángulos, en el render por tiles)
+bool rasterHiZ = true;
+
+static_assert(RASTER_BLOCK == HIZ_BLOCK, "Los bloques del Hi-Z deben coincidir con los del rasterizador");
+
+// Contadores del rasterizador
+struct RasterStats {
+    uint64_t trianglesRejected = 0;     // Triángulos descartados enteros por el Hi-Z (por tile)
+    uint64_t blocksRejected = 0;        // Bloques de 8x8 descartados por el Hi-Z
+    uint64_t pixelsHiZRejected = 0;     // Píxeles del bounding box en esos bloques
+    uint64_t pixelsTested = 0;          // Píxeles cubiertos que llegaron al test de profundidad
+    uint64_t pixelsWritten = 0;         // Píxeles que pasaron el test y se escribieron
+
+    void add(const RasterStats& other) {
+        trianglesRejected += other.trianglesRejected;
+        blocksRejected += other.blocksRejected;
+        pixelsHiZRejected += other.pixelsHiZRejected;
+        pixelsTested += other.pixelsTested;
+        pixelsWritten += other.pixelsWritten;
+    }
+};
+
+// Contadores acumulados; quien dibuja decide cuándo reiniciarlos
+RasterStats rasterStats;
+
+// Buffers de color y profundidad sobre los que escribe el rasterizador
+struct RasterTarget {
+    Color* color;
+    void* depth;                // Valores de depthFormat
+    DepthFormat depthFormat;
+    FramebufferLayout layout;
+    int stride;
+    float* hiz;                 // Un valor por bloque de 8x8
+    int hizStride;
+    Framebuffer* lazy;          // Borrar cada bloque la primera vez que se toca (nullptr = ya borrado)
+    RasterStats* stats;
+
+    inline size_t offset(int x, int y) const {
+        return pixelOffset(layout, stride, x, y);
+    }
+};
+
+// Rectángulo de recorte (inclusivo), en píxeles
+struct RasterRect {
+    int minX, minY, maxX, maxY;
+};
+
+// Datos de un triángulo preparados para rasterizar
+struct RasterSetup {
+    // Funciones de borde: E(P) = A*P.x + B*P.y + C, en unidades de 1/256 px²
+    int64_t A[3], B[3], C[3];
+
+    // Plano de profundidad relativo al vértice 0
+    float x0, y0, z0;
+    float dzdx, dzdy;
+    float zMin;             // Profundidad mínima de los vértices
+
+    // Bounding box ya recortado
+    int minX, minY, maxX, maxY;
+
+    Color color;
+    Uint32 packed;      // El mismo color como entero de 32 bits
+};
+
+// Valores de los bordes en la esquina de un bloque de 8x8
+struct RasterBlock {
+    int32_t e[3];
+    int32_t stepX[3];
+    int32_t stepY[3];
+    int x, y;               // Esquina del bloque en píxeles
+    int colMin, colMax;     // Columnas del bloque dentro del bounding box
+    int rowMin, rowMax;     // Filas del bloque dentro del bounding box
+    bool full;              // Todas las muestras están dentro del triángulo
+    float dxBase;           // (x + 0.5) - x0, para interpolar profundidad
+};
+
+inline int countTrailingZeros32(unsigned value) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctz(value);
+#else
+    int count = 0;
+    for (; !(value & 1u); value >>= 1) count++;
+    return count;
+#endif
+}
+
+inline int popcount32(unsigned value) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_popcount(value);
+#else
+    int count = 0;
+    for (; value; value &= value - 1) count++;
+    return count;
+#endif
+}
+
+inline Uint32 packColor(const Color& color) {
+    Uint32 packed;
+    std::memcpy(&packed, &color, sizeof(packed));
+    return packed;
+}
+
+// División entera que redondea hacia -infinito
+inline int64_t floorDiv(int64_t a, int64_t b) {
+    int64_t q = a / b;
+    return (a % b != 0 && ((a < 0) != (b < 0))) ? q - 1 : q;
+}
+
+// Preparar un triángulo. Devuelve false si no cubre ningún píxel del rectángulo.
+bool setupTriangle(glm::vec3 v0, glm::vec3 v1, glm::vec3 v2, const Color& color,
+                   const RasterRect& clip, RasterSetup& s) {
+    // Descartar vértices no finitos o demasiado lejanos para punto fijo
+    for (const glm::vec3* v : {&v0, &v1, &v2}) {
+        if (!(std::abs(v->x) < RASTER_MAX_COORD && std::abs(v->y) < RASTER_MAX_COORD)) {
+            return false;
+        }
+    }
+
+    int64_t X[3], Y[3];
+    X[0] = std::llround(v0.x * RASTER_SUBPIXEL); Y[0] = std::llround(v0.y * RASTER_SUBPIXEL);
+    X[1] = std::llround(v1.x * RASTER_SUBPIXEL); Y[1] = std::llround(v1.y * RASTER_SUBPIXEL);
+    X[2] = std::llround(v2.x * RASTER_SUBPIXEL); Y[2] = std::llround(v2.y * RASTER_SUBPIXEL);
+
+    // Área con signo; orientar todos los triángulos igual
+    int64_t area = (X[1] - X[0]) * (Y[2] - Y[0]) - (X[2] - X[0]) * (Y[1] - Y[0]);
+    if (area == 0) return false;
+    if (area < 0) {
+        std::swap(v1, v2);
+        std::swap(X[1], X[2]);
+        std::swap(Y[1], Y[2]);
+    }
+
+    // Bounding box de los centros de píxel cubiertos
+    int64_t minXf = std::min({X[0], X[1], X[2]});
+    int64_t minYf = std::min({Y[0], Y[1], Y[2]});
+    int64_t maxXf = std::max({X[0], X[1], X[2]});
+    int64_t maxYf = std::max({Y[0], Y[1], Y[2]});
+    const int64_t half = RASTER_SUBPIXEL / 2;
+
+    s.minX = static_cast<int>(std::max<int64_t>(clip.minX, floorDiv(minXf - half + RASTER_SUBPIXEL - 1, RASTER_SUBPIXEL)));
+    s.minY = static_cast<int>(std::max<int64_t>(clip.minY, floorDiv(minYf - half + RASTER_SUBPIXEL - 1, RASTER_SUBPIXEL)));
+    s.maxX = static_cast<int>(std::min<int64_t>(clip.maxX, floorDiv(maxXf - half, RASTER_SUBPIXEL)));
+    s.maxY = static_cast<int>(std::min<int64_t>(clip.maxY, floorDiv(maxYf - half, RASTER_SUBPIXEL)));
+    if (s.minX > s.maxX || s.minY > s.maxY) return false;
+
+    // Bordes: 0 = v1->v2, 1 = v2->v0, 2 = v0->v1
+    for (int i = 0; i < 3; i++) {
+        int a = (i + 1) % 3;
+        int b = (i + 2) % 3;
+        s.A[i] = Y[a] - Y[b];
+        s.B[i] = X[b] - X[a];
+        s.C[i] = X[a] * Y[b] - Y[a] * X[b];
+
+        // Regla top-left: en los bordes que no son izquierdos ni superiores
+        // un punto exactamente sobre el borde queda fuera
+        bool topLeft = s.A[i] > 0 || (s.A[i] == 0 && s.B[i] > 0);
+        if (!topLeft) s.C[i] -= 1;
+    }
+
+    // Gradientes de profundidad en espacio de pantalla
+    double ex1 = static_cast<double>(v1.x) - v0.x, ey1 = static_cast<double>(v1.y) - v0.y;
+    double ex2 = static_cast<double>(v2.x) - v0.x, ey2 = static_cast<double>(v2.y) - v0.y;
+    double ez1 = static_cast<double>(v1.z) - v0.z, ez2 = static_cast<double>(v2.z) - v0.z;
+    double det = ex1 * ey2 - ex2 * ey1;
+    if (det == 0.0) return false;
+
+    s.x0 = v0.x;
+    s.y0 = v0.y;
+    s.z0 = v0.z;
+    s.dzdx = static_cast<float>((ez1 * ey2 - ez2 * ey1) / det);
+    s.dzdy = static_cast<float>((ez2 * ex1 - ez1 * ex2) / det);
+    s.zMin = std::min({v0.z, v1.z, v2.z});
+    s.color = color;
+    s.packed = packColor(color);
+    return true;
+}
+
+// Valor de un borde en el centro del píxel (px, py)
+inline int64_t edgeAt(const RasterSetup& s, int i, int px, int py) {
+    const int64_t half = RASTER_SUBPIXEL / 2;
+    return s.A[i] * (static_cast<int64_t>(px) * RASTER_SUBPIXEL + half) +
+           s.B[i] * (static_cast<int64_t>(py) * RASTER_SUBPIXEL + half) + s.C[i];
+}
+
+// Profundidad en el centro del píxel; todos los caminos usan exactamente
+// esta misma secuencia de operaciones para dar resultados idénticos
+inline float rowDepth(const RasterSetup& s, int py) {
+    return s.z0 + s.dzdy * ((static_cast<float>(py) + 0.5f) - s.y0);
+}
+
+// Origen del color de cada píxel: el color constante del triángulo. Los
+// orígenes con CONSTANT = false definen Color shade(px, py) const, el
+// color en el punto (px, py) de la pantalla; los que tienen COLOR = false
+// sólo escriben profundidad.
+struct FlatPixels {
+    static constexpr bool CONSTANT = true;
+    static constexpr bool COLOR = true;
+};
+
+// Sólo profundidad (pasada previa de la malla de alambre)
+struct DepthOnlyPixels {
+    static constexpr bool CONSTANT = true;
+    static constexpr bool COLOR = false;
+};
+
+// N atributos interpolados con corrección de perspectiva: en pantalla son
+// lineales a/w y 1/w, así que se guardan sus planos y en cada píxel se
+// divide uno por el otro
+template <int N>
+struct VaryingPlanes {
+    float x0, y0;
+    float q0, dqdx, dqdy;               // 1/w
+    float a0[N], dadx[N], dady[N];      // a/w
+
+    // invW[k] = 1/w del vértice k; values[k][i] = atributo i del vértice k
+    bool setup(const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2,
+               const float invW[3], const float values[3][N]) {
+        double ex1 = static_cast<double>(v1.x) - v0.x, ey1 = static_cast<double>(v1.y) - v0.y;
+        double ex2 = static_cast<double>(v2.x) - v0.x, ey2 = static_cast<double>(v2.y) - v0.y;
+        double det = ex1 * ey2 - ex2 * ey1;
+        if (det == 0.0) return false;
+
+        auto plane = [&](double f0, double f1, double f2, float& base, float& ddx, float& ddy) {
+            double e1 = f1 - f0, e2 = f2 - f0;
+            base = static_cast<float>(f0);
+            ddx = static_cast<float>((e1 * ey2 - e2 * ey1) / det);
+            ddy = static_cast<float>((e2 * ex1 - e1 * ex2) / det);
+        };
+
+        x0 = v0.x;
+        y0 = v0.y;
+        plane(invW[0], invW[1], invW[2], q0, dqdx, dqdy);
+        for (int i = 0; i < N; i++) {
+            plane(static_cast<double>(values[0][i]) * invW[0], static_cast<double>(values[1][i]) * invW[1],
+                  static_cast<double>(values[2][i]) * invW[2], a0[i], dadx[i], dady[i]);
+        }
+        return true;
+    }
+
+    inline void evaluate(float px, float py, float out[N]) const {
+        float dx = px - x0;
+        float dy = py - y0;
+        float w = 1.0f / (q0 + dqdx * dx + dqdy * dy);
+        for (int i = 0; i < N; i++) {
+            out[i] = (a0[i] + dadx[i] * dx + dady[i] * dy) * w;
+        }
+    }
+};
+
+// Colores empaquetados de los carriles de mask de la fila y de un bloque,
+// desde la columna x; los demás carriles no se tocan
+template <typename P>
+inline void shadeLanes(const P& pixels, unsigned mask, int x, int y, Uint32* out) {
+    float py = static_cast<float>(y) + 0.5f;
+    for (; mask; mask &= mask - 1) {
+        int lane = countTrailingZeros32(mask);
+        out[lane] = packColor(pixels.shade(static_cast<float>(x + lane) + 0.5f, py));
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Núcleos por bloque
+// ---------------------------------------------------------------------------
+
+// Recalcular la profundidad máxima de un bloque después de escribir en él
+template <typename D>
+void updateBlockHiZ(const RasterBlock& b, const RasterTarget& t) {
+    using Depth = typename D::Type;
+    const Depth* zbuf = static_cast<const Depth*>(t.depth);
+    Depth maxDepth = std::numeric_limits<Depth>::lowest();
+    for (int r = 0; r < RASTER_BLOCK; r++) {
+        const Depth* row = zbuf + t.offset(b.x, b.y + r);
+        for (int lane = 0; lane < RASTER_BLOCK; lane++) {
+            maxDepth = std::max(maxDepth, row[lane]);
+        }
+    }
+    t.hiz[(b.y / RASTER_BLOCK) * t.hizStride + b.x / RASTER_BLOCK] = D::hizBound(maxDepth);
+}
+
+template <typename D, typename P>
+void rasterBlockScalar(const RasterSetup& s, const RasterBlock& b, const RasterTarget& t, const P& pixels) {
+    typename D::Type* zbuf = static_cast<typename D::Type*>(t.depth);
+    int tested = 0;
+    int written = 0;
+    float zx[RASTER_BLOCK];
+    for (int lane = 0; lane < RASTER_BLOCK; lane++) {
+        zx[lane] = s.dzdx * (b.dxBase + static_cast<float>(lane));
+    }
+
+    int32_t row[3] = {
+        b.e[0] + b.rowMin * b.stepY[0],
+        b.e[1] + b.rowMin * b.stepY[1],
+        b.e[2] + b.rowMin * b.stepY[2]
+    };
+
+    for (int r = b.rowMin; r <= b.rowMax; r++) {
+        int y = b.y + r;
+        float zr = rowDepth(s, y);
+        size_t index = t.offset(b.x, y);
+
+        for (int lane = b.colMin; lane <= b.colMax; lane++) {
+            if (!b.full) {
+                int32_t w0 = row[0] + lane * b.stepX[0];
+                int32_t w1 = row[1] + lane * b.stepX[1];
+                int32_t w2 = row[2] + lane * b.stepX[2];
+                if ((w0 | w1 | w2) < 0) continue;
+            }
+
+            typename D::Type depth = D::encode(zr + zx[lane]);
+            tested++;
+            if (depth < zbuf[index + lane]) {
+                zbuf[index + lane] = depth;
+                if constexpr (!P::COLOR) {
+                    // Sólo profundidad
+                } else if constexpr (P::CONSTANT) {
+                    t.color[index + lane] = s.color;
+                } else {
+                    t.color[index + lane] = pixels.shade(static_cast<float>(b.x + lane) + 0.5f,
+                                                         static_cast<float>(y) + 0.5f);
+                }
+                written++;
+            }
+        }
+
+        row[0] += b.stepY[0];
+        row[1] += b.stepY[1];
+        row[2] += b.stepY[2];
+    }
+
+    t.stats->pixelsTested += tested;
+    t.stats->pixelsWritten += written;
+    if (written > 0) updateBlockHiZ<D>(b, t);
+}
+
+#if RASTER_HAS_X86
+template <typename P>
+void rasterBlockSSE2(const RasterSetup& s, const RasterBlock& b, const RasterTarget& t, const P& pixels) {
+    // SSE2 no tiene multiplicación de enteros de 32 bits, los pasos por carril
+    // se arman con sumas
+    __m128i stepX[3], stepX4[3];
+    for (int i = 0; i < 3; i++) {
+        int32_t d = b.stepX[i];
+        stepX[i] = _mm_setr_epi32(0, d, 2 * d, 3 * d);
+        stepX4[i] = _mm_set1_epi32(4 * d);
+    }
+
+    const __m128i lane = _mm_setr_epi32(0, 1, 2, 3);
+    const __m128i four = _mm_set1_epi32(4);
+    __m128i colLo = _mm_set1_epi32(b.colMin - 1);
+    __m128i colHi = _mm_set1_epi32(b.colMax + 1);
+    __m128i colMask[2] = {
+        _mm_and_si128(_mm_cmpgt_epi32(lane, colLo), _mm_cmplt_epi32(lane, colHi)),
+        _mm_and_si128(_mm_cmpgt_epi32(_mm_add_epi32(lane, four), colLo),
+                      _mm_cmplt_epi32(_mm_add_epi32(lane, four), colHi))
+    };
+
+    __m128 dzdx = _mm_set1_ps(s.dzdx);
+    __m128 dxBase = _mm_set1_ps(b.dxBase);
+    __m128 zx[2] = {
+        _mm_mul_ps(dzdx, _mm_add_ps(dxBase, _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f))),
+        _mm_mul_ps(dzdx, _mm_add_ps(dxBase, _mm_setr_ps(4.0f, 5.0f, 6.0f, 7.0f)))
+    };
+    __m128i color = _mm_set1_epi32(static_cast<int>(s.packed));
+    __m128i minusOne = _mm_set1_epi32(-1);
+    int tested = 0;
+    int written = 0;
+
+    int32_t row[3] = {
+        b.e[0] + b.rowMin * b.stepY[0],
+        b.e[1] + b.rowMin * b.stepY[1],
+        b.e[2] + b.rowMin * b.stepY[2]
+    };
+
+    float* zbuf = static_cast<float*>(t.depth);
+
+    for (int r = b.rowMin; r <= b.rowMax; r++) {
+        int y = b.y + r;
+        __m128 zr = _mm_set1_ps(rowDepth(s, y));
+        size_t index = t.offset(b.x, y);
+
+        for (int half = 0; half < 2; half++) {
+            __m128i inside = colMask[half];
+            if (!b.full) {
+                __m128i w0 = _mm_add_epi32(_mm_set1_epi32(row[0]), stepX[0]);
+                __m128i w1 = _mm_add_epi32(_mm_set1_epi32(row[1]), stepX[1]);
+                __m128i w2 = _mm_add_epi32(_mm_set1_epi32(row[2]), stepX[2]);
+                if (half == 1) {
+                    w0 = _mm_add_epi32(w0, stepX4[0]);
+                    w1 = _mm_add_epi32(w1, stepX4[1]);
+                    w2 = _mm_add_epi32(w2, stepX4[2]);
+                }
+                __m128i w = _mm_or_si128(w0, _mm_or_si128(w1, w2));
+                inside = _mm_and_si128(inside, _mm_cmpgt_epi32(w, minusOne));
+            }
+            int insideMask = _mm_movemask_ps(_mm_castsi128_ps(inside));
+            if (insideMask == 0) continue;
+            tested += popcount32(insideMask);
+
+            float* zp = zbuf + index + half * 4;
+            __m128 z = _mm_add_ps(zr, zx[half]);
+            __m128 zb = _mm_loadu_ps(zp);
+            __m128 pass = _mm_and_ps(_mm_cmplt_ps(z, zb), _mm_castsi128_ps(inside));
+            int passMask = _mm_movemask_ps(pass);
+            if (passMask == 0) continue;
+            written += popcount32(passMask);
+
+            _mm_storeu_ps(zp, _mm_or_ps(_mm_and_ps(pass, z), _mm_andnot_ps(pass, zb)));
+            if constexpr (!P::COLOR) continue;
+
+            __m128i shaded = color;
+            if constexpr (!P::CONSTANT) {
+                alignas(16) Uint32 lanes[4] = {};
+                shadeLanes(pixels, static_cast<unsigned>(passMask), b.x + half * 4, y, lanes);
+                shaded = _mm_load_si128(reinterpret_cast<const __m128i*>(lanes));
+            }
+
+            __m128i* cp = reinterpret_cast<__m128i*>(t.color + index + half * 4);
+            __m128i passi = _mm_castps_si128(pass);
+            __m128i cb = _mm_loadu_si128(cp);
+            _mm_storeu_si128(cp, _mm_or_si128(_mm_and_si128(passi, shaded), _mm_andnot_si128(passi, cb)));
+        }
+
+        row[0] += b.stepY[0];
+        row[1] += b.stepY[1];
+        row[2] += b.stepY[2];
+    }
+
+    t.stats->pixelsTested += tested;
+    t.stats->pixelsWritten += written;
+
+    if (written > 0) {
+        __m128 maxDepth = _mm_set1_ps(-std::numeric_limits<float>::max());
+        for (int r = 0; r < RASTER_BLOCK; r++) {
+            const float* zp = zbuf + t.offset(b.x, b.y + r);
+            maxDepth = _mm_max_ps(maxDepth, _mm_max_ps(_mm_loadu_ps(zp), _mm_loadu_ps(zp + 4)));
+        }
+        maxDepth = _mm_max_ps(maxDepth, _mm_shuffle_ps(maxDepth, maxDepth, _MM_SHUFFLE(1, 0, 3, 2)));
+        maxDepth = _mm_max_ps(maxDepth, _mm_shuffle_ps(maxDepth, maxDepth, _MM_SHUFFLE(2, 3, 0, 1)));
+        t.hiz[(b.y / RASTER_BLOCK) * t.hizStride + b.x / RASTER_BLOCK] = _mm_cvtss_f32(maxDepth);
+    }
+}
+
+// Operaciones de 8 profundidades por formato para el núcleo AVX2
+template <typename D>
+struct DepthLanesAVX2;
+
+template <>
+struct DepthLanesAVX2<DepthF32> {
+    RASTER_TARGET_AVX2 static inline __m256 load(const float* p) {
+        return _mm256_loadu_ps(p);
+    }
+    RASTER_TARGET_AVX2 static inline __m256 encode(__m256 z) {
+        return z;
+    }
+    RASTER_TARGET_AVX2 static inline __m256 less(__m256 a, __m256 b) {
+        return _mm256_cmp_ps(a, b, _CMP_LT_OQ);
+    }
+    RASTER_TARGET_AVX2 static inline __m256 select(__m256 old, __m256 value, __m256 mask) {
+        return _mm256_blendv_ps(old, value, mask);
+    }
+    RASTER_TARGET_AVX2 static inline void store(float* p, __m256 v) {
+        _mm256_storeu_ps(p, v);
+    }
+    // Cota del Hi-Z para el bloque con esquina (x, y)
+    RASTER_TARGET_AVX2 static inline float blockBound(const float* zbuf, const RasterTarget& t, int x, int y) {
+        __m256 maxDepth = _mm256_loadu_ps(zbuf + t.offset(x, y));
+        for (int r = 1; r < RASTER_BLOCK; r++) {
+            maxDepth = _mm256_max_ps(maxDepth, _mm256_loadu_ps(zbuf + t.offset(x, y + r)));
+        }
+        __m128 m = _mm_max_ps(_mm256_castps256_ps128(maxDepth), _mm256_extractf128_ps(maxDepth, 1));
+        m = _mm_max_ps(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(1, 0, 3, 2)));
+        m = _mm_max_ps(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(2, 3, 0, 1)));
+        return _mm_cvtss_f32(m);
+    }
+};
+
+// Enteros de 24 o 16 bits: se comparan como enteros de 32 bits con signo,
+// que alcanzan porque los valores no llegan a 2^31
+template <int BITS, typename T>
+struct DepthLanesAVX2<DepthUnorm<BITS, T>> {
+    using D = DepthUnorm<BITS, T>;
+
+    RASTER_TARGET_AVX2 static inline __m256i load(const T* p) {
+        if constexpr (sizeof(T) == 2) {
+            return _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+        } else {
+            return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        }
+    }
+    // Mismas operaciones que D::encode
+    RASTER_TARGET_AVX2 static inline __m256i encode(__m256 z) {
+        __m256 scale = _mm256_set1_ps(D::SCALE);
+        __m256 d = _mm256_add_ps(_mm256_mul_ps(z, scale), scale);
+        d = _mm256_min_ps(_mm256_max_ps(d, _mm256_setzero_ps()), _mm256_set1_ps(static_cast<float>(D::MAX)));
+        return _mm256_cvttps_epi32(d);
+    }
+    RASTER_TARGET_AVX2 static inline __m256 less(__m256i a, __m256i b) {
+        return _mm256_castsi256_ps(_mm256_cmpgt_epi32(b, a));
+    }
+    RASTER_TARGET_AVX2 static inline __m256i select(__m256i old, __m256i value, __m256 mask) {
+        return _mm256_blendv_epi8(old, value, _mm256_castps_si256(mask));
+    }
+    RASTER_TARGET_AVX2 static inline void store(T* p, __m256i v) {
+        if constexpr (sizeof(T) == 2) {
+            // packus trabaja por mitades de 128 bits: juntar las dos mitades bajas
+            __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(v, v), 0x08);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(p), _mm256_castsi256_si128(packed));
+        } else {
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v);
+        }
+    }
+    RASTER_TARGET_AVX2 static inline float blockBound(const T* zbuf, const RasterTarget& t, int x, int y) {
+        __m256i maxDepth = load(zbuf + t.offset(x, y));
+        for (int r = 1; r < RASTER_BLOCK; r++) {
+            maxDepth = _mm256_max_epi32(maxDepth, load(zbuf + t.offset(x, y + r)));
+        }
+        __m128i m = _mm_max_epi32(_mm256_castsi256_si128(maxDepth), _mm256_extracti128_si256(maxDepth, 1));
+        m = _mm_max_epi32(m, _mm_shuffle_epi32(m, _MM_SHUFFLE(1, 0, 3, 2)));
+        m = _mm_max_epi32(m, _mm_shuffle_epi32(m, _MM_SHUFFLE(2, 3, 0, 1)));
+        return D::hizBound(static_cast<T>(_mm_cvtsi128_si32(m)));
+    }
+};
+
+template <typename D, typename P>
+RASTER_TARGET_AVX2
+void rasterBlockAVX2(const RasterSetup& s, const RasterBlock& b, const RasterTarget& t, const P& pixels) {
+    using Lanes = DepthLanesAVX2<D>;
+    typename D::Type* zbuf = static_cast<typename D::Type*>(t.depth);
+
+    const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    __m256i stepX[3];
+    for (int i = 0; i < 3; i++) {
+        stepX[i] = _mm256_mullo_epi32(lane, _mm256_set1_epi32(b.stepX[i]));
+    }
+
+    __m256i colMask = _mm256_and_si256(
+        _mm256_cmpgt_epi32(lane, _mm256_set1_epi32(b.colMin - 1)),
+        _mm256_cmpgt_epi32(_mm256_set1_epi32(b.colMax + 1), lane));
+
+    __m256 laneF = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+    __m256 zx = _mm256_mul_ps(_mm256_set1_ps(s.dzdx), _mm256_add_ps(_mm256_set1_ps(b.dxBase), laneF));
+    __m256i color = _mm256_set1_epi32(static_cast<int>(s.packed));
+    __m256i minusOne = _mm256_set1_epi32(-1);
+    int tested = 0;
+    int written = 0;
+
+    int32_t row[3] = {
+        b.e[0] + b.rowMin * b.stepY[0],
+        b.e[1] + b.rowMin * b.stepY[1],
+        b.e[2] + b.rowMin * b.stepY[2]
+    };
+
+    for (int r = b.rowMin; r <= b.rowMax; r++) {
+        int y = b.y + r;
+        size_t index = t.offset(b.x, y);
+
+        __m256i inside = colMask;
+        if (!b.full) {
+            __m256i w0 = _mm256_add_epi32(_mm256_set1_epi32(row[0]), stepX[0]);
+            __m256i w1 = _mm256_add_epi32(_mm256_set1_epi32(row[1]), stepX[1]);
+            __m256i w2 = _mm256_add_epi32(_mm256_set1_epi32(row[2]), stepX[2]);
+            __m256i w = _mm256_or_si256(w0, _mm256_or_si256(w1, w2));
+            inside = _mm256_and_si256(inside, _mm256_cmpgt_epi32(w, minusOne));
+        }
+
+        row[0] += b.stepY[0];
+        row[1] += b.stepY[1];
+        row[2] += b.stepY[2];
+
+        int insideMask = _mm256_movemask_ps(_mm256_castsi256_ps(inside));
+        if (insideMask == 0) continue;
+        tested += popcount32(insideMask);
+
+        typename D::Type* zp = zbuf + index;
+        auto z = Lanes::encode(_mm256_add_ps(_mm256_set1_ps(rowDepth(s, y)), zx));
+        auto zb = Lanes::load(zp);
+        __m256 pass = _mm256_and_ps(Lanes::less(z, zb), _mm256_castsi256_ps(inside));
+        int passMask = _mm256_movemask_ps(pass);
+        if (passMask == 0) continue;
+        written += popcount32(passMask);
+
+        Lanes::store(zp, Lanes::select(zb, z, pass));
+        if constexpr (!P::COLOR) continue;
+
+        __m256i shaded = color;
+        if constexpr (!P::CONSTANT) {
+            alignas(32) Uint32 lanes[RASTER_BLOCK] = {};
+            shadeLanes(pixels, static_cast<unsigned>(passMask), b.x, y, lanes);
+            shaded = _mm256_load_si256(reinterpret_cast<const __m256i*>(lanes));
+        }
+
+        __m256i* cp = reinterpret_cast<__m256i*>(t.color + index);
+        __m256i cb = _mm256_loadu_si256(cp);
+        _mm256_storeu_si256(cp, _mm256_blendv_epi8(cb, shaded, _mm256_castps_si256(pass)));
+    }
+
+    t.stats->pixelsTested += tested;
+    t.stats->pixelsWritten += written;
+
+    if (written > 0) {
+        t.hiz[(b.y / RASTER_BLOCK) * t.hizStride + b.x / RASTER_BLOCK] = Lanes::blockBound(zbuf, t, b.x, b.y);
+    }
+}
+#endif
+
+// Camino de respaldo para triángulos cuyos bordes no caben en 32 bits
+// (vértices muy lejos de la pantalla): evalúa todo en 64 bits
+template <typename D, typename P>
+void rasterTriangleWide(const RasterSetup& s, const RasterTarget& t, const P& pixels) {
+    typename D::Type* zbuf = static_cast<typename D::Type*>(t.depth);
+    const int64_t stepX[3] = {s.A[0] * RASTER_SUBPIXEL, s.A[1] * RASTER_SUBPIXEL, s.A[2] * RASTER_SUBPIXEL};
+
+    for (int y = s.minY; y <= s.maxY; y++) {
+        int64_t w[3] = {edgeAt(s, 0, s.minX, y), edgeAt(s, 1, s.minX, y), edgeAt(s, 2, s.minX, y)};
+        float zr = rowDepth(s, y);
+
+        for (int x = s.minX; x <= s.maxX; x++) {
+            if ((w[0] | w[1] | w[2]) >= 0) {
+                int bx = x & ~(RASTER_BLOCK - 1);
+                float dxBase = (static_cast<float>(bx) + 0.5f) - s.x0;
+                typename D::Type depth = D::encode(zr + s.dzdx * (dxBase + static_cast<float>(x - bx)));
+                if (t.lazy) t.lazy->ensureBlock(x / RASTER_BLOCK, y / RASTER_BLOCK);
+                size_t index = t.offset(x, y);
+                t.stats->pixelsTested++;
+                if (depth < zbuf[index]) {
+                    zbuf[index] = depth;
+                    if constexpr (!P::COLOR) {
+                        // Sólo profundidad
+                    } else if constexpr (P::CONSTANT) {
+                        t.color[index] = s.color;
+                    } else {
+                        t.color[index] = pixels.shade(static_cast<float>(x) + 0.5f, static_cast<float>(y) + 0.5f);
+                    }
+                    t.stats->pixelsWritten++;
+                }
+            }
+            w[0] += stepX[0];
+            w[1] += stepX[1];
+            w[2] += stepX[2];
+        }
+    }
+}
+
+// Recorrer el bounding box por bloques y despachar al núcleo elegido
+template <typename D, typename P>
+bool rasterizeSetup(const RasterSetup& s, const RasterTarget& t, const P& pixels) {
+    int bx0 = s.minX & ~(RASTER_BLOCK - 1);
+    int by0 = s.minY & ~(RASTER_BLOCK - 1);
+
+    // Si algún borde no cabe en 32 bits en las esquinas del área recorrida,
+    // usar el camino de 64 bits
+    const int64_t limit = INT32_MAX / 2;
+    for (int i = 0; i < 3; i++) {
+        int x1 = s.maxX | (RASTER_BLOCK - 1);
+        int y1 = s.maxY | (RASTER_BLOCK - 1);
+        int64_t c00 = edgeAt(s, i, bx0, by0), c10 = edgeAt(s, i, x1, by0);
+        int64_t c01 = edgeAt(s, i, bx0, y1), c11 = edgeAt(s, i, x1, y1);
+        if (std::max({std::abs(c00), std::abs(c10), std::abs(c01), std::abs(c11)}) > limit) {
+            rasterTriangleWide<D>(s, t, pixels);
+            return true;
+        }
+    }
+
+    RasterBlock b;
+    int64_t blockStepX[3], blockStepY[3];
+    int64_t spanX[3], spanY[3];
+    for (int i = 0; i < 3; i++) {
+        b.stepX[i] = static_cast<int32_t>(s.A[i] * RASTER_SUBPIXEL);
+        b.stepY[i] = static_cast<int32_t>(s.B[i] * RASTER_SUBPIXEL);
+        blockStepX[i] = static_cast<int64_t>(b.stepX[i]) * RASTER_BLOCK;
+        blockStepY[i] = static_cast<int64_t>(b.stepY[i]) * RASTER_BLOCK;
+        spanX[i] = static_cast<int64_t>(b.stepX[i]) * (RASTER_BLOCK - 1);
+        spanY[i] = static_cast<int64_t>(b.stepY[i]) * (RASTER_BLOCK - 1);
+    }
+
+    int64_t rowStart[3] = {edgeAt(s, 0, bx0, by0), edgeAt(s, 1, bx0, by0), edgeAt(s, 2, bx0, by0)};
+
+    // Variación máxima hacia abajo del plano de profundidad dentro de un bloque
+    float blockDepthDrop = std::min(0.0f, s.dzdx * (RASTER_BLOCK - 1)) + std::min(0.0f, s.dzdy * (RASTER_BLOCK - 1));
+    bool drawn = false;
+
+    for (int by = by0; by <= s.maxY; by += RASTER_BLOCK) {
+        b.y = by;
+        b.rowMin = std::max(0, s.minY - by);
+        b.rowMax = std::min(RASTER_BLOCK - 1, s.maxY - by);
+
+        int64_t e[3] = {rowStart[0], rowStart[1], rowStart[2]};
+
+        for (int bx = bx0; bx <= s.maxX; bx += RASTER_BLOCK) {
+            // Valores mínimo y máximo de cada borde en las esquinas del bloque
+            bool outside = false;
+            bool full = true;
+            for (int i = 0; i < 3; i++) {
+                int64_t lo = e[i] + std::min<int64_t>(0, spanX[i]) + std::min<int64_t>(0, spanY[i]);
+                int64_t hi = e[i] + std::max<int64_t>(0, spanX[i]) + std::max<int64_t>(0, spanY[i]);
+                if (hi < 0) outside = true;
+                if (lo < 0) full = false;
+            }
+
+            if (!outside) {
+                b.x = bx;
+                b.colMin = std::max(0, s.minX - bx);
+                b.colMax = std::min(RASTER_BLOCK - 1, s.maxX - bx);
+                b.full = full;
+                b.dxBase = (static_cast<float>(bx) + 0.5f) - s.x0;
+                for (int i = 0; i < 3; i++) b.e[i] = static_cast<int32_t>(e[i]);
+
+                // Profundidad mínima del triángulo dentro del bloque contra
+                // la máxima que ya tiene el z-buffer
+                if (rasterHiZ) {
+                    float planeMin = rowDepth(s, by) + s.dzdx * b.dxBase + blockDepthDrop;
+                    float blockMin = std::max(planeMin, s.zMin);
+                    if (blockMin >= t.hiz[(by / RASTER_BLOCK) * t.hizStride + bx / RASTER_BLOCK]) {
+                        t.stats->blocksRejected++;
+                        t.stats->pixelsHiZRejected += (b.colMax - b.colMin + 1) * (b.rowMax - b.rowMin + 1);
+                        for (int i = 0; i < 3; i++) e[i] += blockStepX[i];
+                        continue;
+                    }
+                }
+                drawn = true;
+                if (t.lazy) t.lazy->ensureBlock(bx / RASTER_BLOCK, by / RASTER_BLOCK);
+
+                switch (rasterPath) {
+#if RASTER_HAS_X86
+                    case RasterPath::AVX2:
+                        rasterBlockAVX2<D>(s, b, t, pixels);
+                        break;
+                    case RasterPath::SSE2:
+                        if (std::is_same<D, DepthF32>::value) {
+                            rasterBlockSSE2(s, b, t, pixels);
+                            break;
+                        }
+                        rasterBlockScalar<D>(s, b, t, pixels);
+                        break;
+#endif
+                    default:
+                        rasterBlockScalar<D>(s, b, t, pixels);
+                        break;
+                }
+            }
+
+            for (int i = 0; i < 3; i++) e[i] += blockStepX[i];
+        }
+
+        for (int i = 0; i < 3; i++) rowStart[i] += blockStepY[i];
+    }
+
+    return drawn;
+}
+
+// Preparar un triángulo y dibujarlo con el color de pixels. El rectángulo
+// de recorte debe empezar en múltiplos de RASTER_BLOCK y los buffers deben
+// tener bloques completos. Devuelve true si se llegó a dibujar algún bloque.
+template <typename P>
+bool rasterizeShaded(const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2, const Color& color,
+                     const RasterRect& clip, const RasterTarget& t, const P& pixels) {
+    RasterSetup s;
+    if (!setupTriangle(v0, v1, v2, color, clip, s)) return false;
+
+    switch (t.depthFormat) {
+        case DepthFormat::Unorm24: return rasterizeSetup<DepthU24>(s, t, pixels);
+        case DepthFormat::Unorm16: return rasterizeSetup<DepthU16>(s, t, pixels);
+        default: return rasterizeSetup<DepthF32>(s, t, pixels);
+    }
+}
+
+// Triángulo de un solo color
+bool rasterizeTriangle(const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2,
+                       const Color& color, const RasterRect& clip, const RasterTarget& t) {
+    return rasterizeShaded(v0, v1, v2, color, clip, t, FlatPixels());
+}
+
+// Lo mismo para cualquier triángulo con v0, v1, v2 y color. shading.h
+// agrega la versión para los triángulos con atributos por vértice.
+template <typename Tri>
+bool rasterizeTriangle(const Tri& tri, const RasterRect& clip, const RasterTarget& t) {
+    return rasterizeTriangle(tri.v0, tri.v1, tri.v2, tri.color, clip, t);
+}
+
+// Sólo la profundidad de cualquier triángulo con v0, v1, v2
+template <typename Tri>
+bool rasterizeTriangleDepth(const Tri& tri, const RasterRect& clip, const RasterTarget& t) {
+    return rasterizeShaded(tri.v0, tri.v1, tri.v2, Color(), clip, t, DepthOnlyPixels());
+}
+
+// Destino sobre un framebuffer, con borrado diferido si está activo
+RasterTarget framebufferTarget(Framebuffer& fb, RasterStats* stats) {
+    return RasterTarget{fb.color.data(), fb.depth.data(), fb.depthFormat, fb.layout, fb.stride,
+                        fb.hiz.data(), fb.blocksX, fb.lazyClear ? &fb : nullptr, stats};
+}
+
+// Destino por defecto: el framebuffer global
+RasterTarget screenTarget() {
+    return framebufferTarget(framebuffer, &rasterStats);
+}
+
+RasterRect screenRect() {
+    return RasterRect{0, 0, renderWidth - 1, renderHeight - 1};
+}
@@ -0,0 +1,156 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include "clusters.h"
+#include "color.h"
+#include "rasterizer.h"
+#include "vertexstage.h"
+
+// Sombreado: plano (un color por cara), Gouraud (luz por vértice,
+// interpolada) o Phong (normal interpolada, luz por píxel).
+//
+// Cada shader es un tipo con VARYINGS atributos por vértice, una función
+// vertex que los calcula a partir de la normal del vértice y una función
+// pixel que da el color a partir de los atributos interpolados. El
+// rasterizador se instancia con cada shader, así que en el bucle por píxel
+// no hay llamadas virtuales ni std::function. El sombreado plano no pasa
+// por acá: usa el camino de color constante del rasterizador.
+//
+// Las normales y la luz están en espacio del objeto.
+
+enum class ShadingMode {
+    Flat,
+    Gouraud,
+    Phong
+};
+
+const char* shadingModeName(ShadingMode mode) {
+    switch (mode) {
+        case ShadingMode::Gouraud: return "gouraud";
+        case ShadingMode::Phong: return "phong";
+        default: return "flat";
+    }
+}
+
+ShadingMode parseShadingMode(const std::string& name) {
+    if (name == "gouraud") return ShadingMode::Gouraud;
+    if (name == "phong") return ShadingMode::Phong;
+    return ShadingMode::Flat;
+}
+
+// Aplicar la luz a un color base
+inline Color shadeColor(const Color& baseColor, float lightIntensity) {
+    // === Iluminación ambiental + difusa ===
+    float ambientLight = 0.4f;
+    float diffuseLight = 0.6f * std::max(0.0f, lightIntensity);
+    float finalIntensity = ambientLight + diffuseLight;
+    finalIntensity = std::clamp(finalIntensity, 0.0f, 1.0f);
+
+    // Aplicar la iluminación al color final
+    return Color(
+        static_cast<int>(baseColor.r * finalIntensity),
+        static_cast<int>(baseColor.g * finalIntensity),
+        static_cast<int>(baseColor.b * finalIntensity)
+    );
+}
+
+// Constantes de los shaders durante un dibujo
+struct ShadingUniforms {
+    glm::vec3 lightDir = glm::vec3(0.0f, 0.0f, 1.0f);      // Unitaria, en espacio del objeto
+};
+
+ShadingUniforms shadingUniforms;
+
+// Luz calculada en cada vértice e interpolada
+struct GouraudShader {
+    static constexpr int VARYINGS = 1;
+
+    static inline void vertex(const glm::vec3& normal, const ShadingUniforms& u, float out[VARYINGS]) {
+        out[0] = glm::dot(normal, u.lightDir);
+    }
+
+    static inline Color pixel(const Color& base, const float in[VARYINGS], const ShadingUniforms&) {
+        return shadeColor(base, in[0]);
+    }
+};
+
+// Normal interpolada y luz en cada píxel
+struct PhongShader {
+    static constexpr int VARYINGS = 3;
+
+    static inline void vertex(const glm::vec3& normal, const ShadingUniforms&, float out[VARYINGS]) {
+        out[0] = normal.x;
+        out[1] = normal.y;
+        out[2] = normal.z;
+    }
+
+    static inline Color pixel(const Color& base, const float in[VARYINGS], const ShadingUniforms& u) {
+        float lengthSquared = in[0] * in[0] + in[1] * in[1] + in[2] * in[2];
+        float intensity = in[0] * u.lightDir.x + in[1] * u.lightDir.y + in[2] * u.lightDir.z;
+        return shadeColor(base, lengthSquared > 0.0f ? intensity / std::sqrt(lengthSquared) : 0.0f);
+    }
+};
+
+// Triángulo listo para rasterizar con un shader: posiciones en pantalla,
+// color base de la cara, 1/w y atributos de cada vértice
+template <typename S>
+struct ShadedTriangle {
+    glm::vec3 v0, v1, v2;
+    Color color;
+    float invW[3];
+    float varyings[3][S::VARYINGS];
+};
+
+// Color de cada píxel según el shader S
+template <typename S>
+struct ShaderPixels {
+    static constexpr bool CONSTANT = false;
+    static constexpr bool COLOR = true;
+
+    VaryingPlanes<S::VARYINGS> planes;
+    Color base;
+    const ShadingUniforms* uniforms;
+
+    inline Color shade(float px, float py) const {
+        float in[S::VARYINGS];
+        planes.evaluate(px, py, in);
+        return S::pixel(base, in, *uniforms);
+    }
+};
+
+// Dibujar un triángulo con su shader (la llama rasterizeBinned)
+template <typename S>
+bool rasterizeTriangle(const ShadedTriangle<S>& tri, const RasterRect& clip, const RasterTarget& t) {
+    ShaderPixels<S> pixels;
+    if (!pixels.planes.setup(tri.v0, tri.v1, tri.v2, tri.invW, tri.varyings)) return false;
+    pixels.base = tri.color;
+    pixels.uniforms = &shadingUniforms;
+    return rasterizeShaded(tri.v0, tri.v1, tri.v2, tri.color, clip, t, pixels);
+}
+
+// Armar un triángulo sombreado: el shader de vértices corre en los tres
+// vértices de la cara y cada esquina mezcla sus salidas con sus pesos
+// (distintos de la identidad sólo si la cara se recortó)
+template <typename S>
+void makeShadedTriangle(const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2, const Color& base,
+                        const TriangleCorners& corners, const VertexStreams& normals,
+                        const ShadingUniforms& uniforms, ShadedTriangle<S>& tri) {
+    float outputs[3][S::VARYINGS];
+    for (int v = 0; v < 3; v++) {
+        S::vertex(normals.get(corners.vertices[v]), uniforms, outputs[v]);
+    }
+
+    tri.v0 = v0;
+    tri.v1 = v1;
+    tri.v2 = v2;
+    tri.color = base;
+    for (int corner = 0; corner < 3; corner++) {
+        const glm::vec3& weights = corners.weights[corner];
+        tri.invW[corner] = 1.0f / corners.w[corner];
+        for (int i = 0; i < S::VARYINGS; i++) {
+            tri.varyings[corner][i] = weights.x * outputs[0][i] + weights.y * outputs[1][i] + weights.z * outputs[2][i];
+        }
+    }
+}
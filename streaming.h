@@ -0,0 +1,875 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "clipping.h"
+#include "clusters.h"
+#include "color.h"
+#include "depthsort.h"
+#include "mappedfile.h"
+#include "objloader.h"
+#include "profiler.h"
+#include "shading.h"
+#include "threadpool.h"
+#include "tiles.h"
+#include "vertexstage.h"
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+// Mallas fuera de memoria (out-of-core): modelos que no caben en RAM.
+//
+// La malla se guarda en un archivo .meshchunks partido en chunks
+// espacialmente coherentes de hasta STREAM_CHUNK_MAX_VERTICES vértices, con
+// índices locales de 16 bits. Un directorio al final del archivo guarda por
+// chunk la caja y la esfera que lo contienen y dónde están sus datos, con
+// desplazamientos de 64 bits: ni el archivo ni la cantidad de vértices o
+// triángulos tienen límite de 32 bits.
+//
+// Para dibujar, el archivo se mapea entero (sólo ocupa espacio de
+// direcciones) y en memoria sólo vive el directorio. Cada frame se
+// descartan los chunks fuera del frustum con su esfera sin tocar sus datos;
+// los visibles se copian desde el mapeo a una caché de residencia de tamaño
+// acotado (la que no se usa hace más tiempo sale primero) y las páginas
+// leídas se devuelven al sistema. Así la memoria del proceso queda en el
+// presupuesto de la caché más el directorio y los buffers de un grupo de
+// chunks, sin importar el tamaño del archivo.
+//
+// Los chunks visibles se procesan de adelante hacia atrás en grupos de
+// tantos chunks como hilos: la carga es secuencial, el armado de cada chunk
+// va en paralelo y los triángulos del grupo se rasterizan juntos por tiles.
+
+const char STREAM_MAGIC[8] = {'M', 'E', 'S', 'H', 'C', 'H', 'N', 'K'};
+const uint32_t STREAM_VERSION = 1;
+
+// Índices locales de 16 bits
+const size_t STREAM_CHUNK_MAX_VERTICES = 65536;
+
+// Triángulos por chunk al partir un .obj
+const size_t STREAM_CHUNK_TARGET_TRIANGLES = 32768;
+
+// Color de las mallas sin material
+const Color STREAM_BASE_COLOR(200, 200, 205);
+
+struct StreamHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t chunkCount;
+    uint64_t vertexCount;
+    uint64_t triangleCount;
+    uint64_t directoryOffset;   // Bytes desde el inicio del archivo
+    glm::vec3 boundsMin, boundsMax;
+};
+
+// Entrada del directorio
+struct StreamChunk {
+    uint64_t vertexOffset;      // glm::vec3 por vértice
+    uint64_t indexOffset;       // uint16_t por esquina
+    uint64_t firstTriangle;     // Índice global del primer triángulo
+    uint32_t vertexCount, triangleCount;
+    glm::vec3 boundsMin, boundsMax;
+    glm::vec3 center;           // Esfera envolvente
+    float radius;
+};
+
+// ---------------------------------------------------------------------------
+// Escritura
+// ---------------------------------------------------------------------------
+
+// Escribe los chunks de a uno, sin guardar más que el directorio. El
+// archivo se escribe en un temporal y se renombra al terminar.
+class StreamWriter {
+public:
+    ~StreamWriter() {
+        if (file) {
+            std::fclose(file);
+            std::error_code error;
+            std::filesystem::remove(tempPath, error);
+        }
+    }
+
+    bool open(const std::string& path) {
+        finalPath = path;
+        tempPath = path + ".tmp";
+        file = std::fopen(tempPath.c_str(), "wb");
+        if (!file) {
+            std::cerr << "Error: No se pudo escribir " << path << std::endl;
+            return false;
+        }
+        header = StreamHeader();
+        std::memcpy(header.magic, STREAM_MAGIC, sizeof(header.magic));
+        header.version = STREAM_VERSION;
+        header.boundsMin = glm::vec3(std::numeric_limits<float>::max());
+        header.boundsMax = glm::vec3(-std::numeric_limits<float>::max());
+        offset = 0;
+        return put(&header, sizeof(header));
+    }
+
+    // Agregar un chunk (a lo sumo STREAM_CHUNK_MAX_VERTICES vértices)
+    bool addChunk(const std::vector<glm::vec3>& positions, const std::vector<uint16_t>& indices) {
+        if (positions.empty() || indices.empty()) return true;
+
+        StreamChunk chunk;
+        chunk.vertexCount = static_cast<uint32_t>(positions.size());
+        chunk.triangleCount = static_cast<uint32_t>(indices.size() / 3);
+        chunk.firstTriangle = header.triangleCount;
+        chunk.boundsMin = positions[0];
+        chunk.boundsMax = positions[0];
+        for (const glm::vec3& p : positions) {
+            chunk.boundsMin = glm::min(chunk.boundsMin, p);
+            chunk.boundsMax = glm::max(chunk.boundsMax, p);
+        }
+        chunk.center = (chunk.boundsMin + chunk.boundsMax) * 0.5f;
+        chunk.radius = glm::length(chunk.boundsMax - chunk.center);
+
+        chunk.vertexOffset = offset;
+        bool ok = put(positions.data(), positions.size() * sizeof(glm::vec3));
+        chunk.indexOffset = offset;
+        ok = ok && put(indices.data(), indices.size() * sizeof(uint16_t));
+
+        // Los vértices del siguiente chunk quedan alineados a 4 bytes
+        static const char padding[4] = {};
+        if (offset % 4) ok = ok && put(padding, 4 - offset % 4);
+
+        directory.push_back(chunk);
+        header.chunkCount++;
+        header.vertexCount += chunk.vertexCount;
+        header.triangleCount += chunk.triangleCount;
+        header.boundsMin = glm::min(header.boundsMin, chunk.boundsMin);
+        header.boundsMax = glm::max(header.boundsMax, chunk.boundsMax);
+        return ok;
+    }
+
+    // Escribir el directorio y la cabecera y dejar el archivo en su lugar
+    bool finish() {
+        header.directoryOffset = offset;
+        bool ok = put(directory.data(), directory.size() * sizeof(StreamChunk));
+        ok = ok && std::fseek(file, 0, SEEK_SET) == 0 && std::fwrite(&header, sizeof(header), 1, file) == 1;
+        ok = std::fclose(file) == 0 && ok;
+        file = nullptr;
+
+        std::error_code error;
+        if (ok) std::filesystem::rename(tempPath, finalPath, error);
+        if (!ok || error) {
+            std::filesystem::remove(tempPath, error);
+            std::cerr << "Error: No se pudo escribir " << finalPath << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    const StreamHeader& summary() const {
+        return header;
+    }
+
+private:
+    bool put(const void* data, size_t bytes) {
+        offset += bytes;
+        return bytes == 0 || std::fwrite(data, 1, bytes, file) == bytes;
+    }
+
+    FILE* file = nullptr;
+    std::string finalPath, tempPath;
+    StreamHeader header;
+    std::vector<StreamChunk> directory;
+    uint64_t offset = 0;
+};
+
+// Arma chunks a partir de triángulos con índices globales: asigna índices
+// locales y cierra el chunk cuando se llenaría
+struct StreamChunkBuilder {
+    std::unordered_map<uint64_t, uint16_t> local;
+    std::vector<glm::vec3> positions;
+    std::vector<uint16_t> indices;
+
+    // positionOf(índice global) da la posición de un vértice
+    template <typename PositionFn>
+    bool add(const uint64_t triangle[3], PositionFn& positionOf, StreamWriter& writer) {
+        if (positions.size() + 3 > STREAM_CHUNK_MAX_VERTICES ||
+            indices.size() >= STREAM_CHUNK_TARGET_TRIANGLES * 3) {
+            if (!flush(writer)) return false;
+        }
+        for (int v = 0; v < 3; v++) {
+            auto inserted = local.emplace(triangle[v], static_cast<uint16_t>(positions.size()));
+            if (inserted.second) positions.push_back(positionOf(triangle[v]));
+            indices.push_back(inserted.first->second);
+        }
+        return true;
+    }
+
+    bool flush(StreamWriter& writer) {
+        bool ok = writer.addChunk(positions, indices);
+        local.clear();
+        positions.clear();
+        indices.clear();
+        return ok;
+    }
+};
+
+// ---------------------------------------------------------------------------
+// Conversión desde .obj
+// ---------------------------------------------------------------------------
+
+// Escritura secuencial con buffer de valores de tipo T
+template <typename T>
+class BufferedOutput {
+public:
+    explicit BufferedOutput(FILE* file) : file(file) {
+        buffer.reserve(BUFFER_VALUES);
+    }
+
+    bool push(const T& value) {
+        buffer.push_back(value);
+        return buffer.size() < BUFFER_VALUES || flush();
+    }
+
+    bool flush() {
+        bool ok = buffer.empty() || std::fwrite(buffer.data(), sizeof(T), buffer.size(), file) == buffer.size();
+        buffer.clear();
+        return ok;
+    }
+
+private:
+    static const size_t BUFFER_VALUES = 1 << 16;
+    FILE* file;
+    std::vector<T> buffer;
+};
+
+struct StreamTriangle64 {
+    uint64_t v[3];
+};
+
+// Convertir un .obj de cualquier tamaño a .meshchunks usando a lo sumo
+// unos memoryBudget bytes para los triángulos en vuelo.
+//
+// 1. Una pasada por el .obj mapeado deja los vértices y los triángulos
+//    (índices globales de 64 bits) en dos temporales binarios.
+// 2. Se elige una rejilla sobre la caja del modelo con unos
+//    STREAM_CHUNK_TARGET_TRIANGLES triángulos por celda y se cuentan los
+//    triángulos de cada celda por su centroide.
+// 3. Las celdas se recorren en orden en tandas que caben en memoryBudget:
+//    por tanda se leen los triángulos de sus celdas y cada celda se parte
+//    en chunks.
+bool buildStreamFromObj(const std::string& objPath, const std::string& outPath, size_t memoryBudget) {
+    auto start = std::chrono::steady_clock::now();
+    std::string vertexPath = outPath + ".vertices.tmp";
+    std::string trianglePath = outPath + ".triangles.tmp";
+    struct TempFiles {
+        std::string a, b;
+        ~TempFiles() {
+            std::error_code error;
+            std::filesystem::remove(a, error);
+            std::filesystem::remove(b, error);
+        }
+    } temps{vertexPath, trianglePath};
+
+    // 1. Vértices y triángulos a binario
+    uint64_t vertexCount = 0;
+    uint64_t triangleCount = 0;
+    uint64_t skipped = 0;
+    glm::vec3 boundsMin(std::numeric_limits<float>::max());
+    glm::vec3 boundsMax(-std::numeric_limits<float>::max());
+    {
+        MappedFile obj;
+        if (!obj.open(objPath)) {
+            std::cerr << "Error: No se pudo abrir el archivo " << objPath << std::endl;
+            return false;
+        }
+        FILE* vertexFile = std::fopen(vertexPath.c_str(), "wb");
+        FILE* triangleFile = std::fopen(trianglePath.c_str(), "wb");
+        if (!vertexFile || !triangleFile) {
+            if (vertexFile) std::fclose(vertexFile);
+            if (triangleFile) std::fclose(triangleFile);
+            std::cerr << "Error: No se pudieron crear los temporales junto a " << outPath << std::endl;
+            return false;
+        }
+        BufferedOutput<glm::vec3> vertexOut(vertexFile);
+        BufferedOutput<StreamTriangle64> triangleOut(triangleFile);
+
+        const char* end = obj.data() + obj.size();
+        const size_t releaseStep = 64 << 20;
+        size_t released = 0;
+        std::vector<long long> corners;
+        bool ok = true;
+        for (const char* p = obj.data(); p < end && ok;) {
+            const char* eol = lineEnd(p, end);
+            const char* q = skipBlanks(p, eol);
+            if (isVertexLine(q, eol)) {
+                glm::vec3 vertex;
+                q = parseFloat(q + 2, eol, vertex.x);
+                q = parseFloat(q, eol, vertex.y);
+                parseFloat(q, eol, vertex.z);
+                boundsMin = glm::min(boundsMin, vertex);
+                boundsMax = glm::max(boundsMax, vertex);
+                ok = vertexOut.push(vertex);
+                vertexCount++;
+            } else if (isFaceLine(q, eol)) {
+                corners.clear();
+                bool valid = true;
+                for (q += 2;;) {
+                    q = skipBlanks(q, eol);
+                    if (q >= eol) break;
+                    long long index = 0;
+                    bool parsed = false;
+                    q = parseInt(q, eol, index, parsed);
+                    long long resolved = index > 0 ? index - 1 : static_cast<long long>(vertexCount) + index;
+                    if (!parsed || index == 0 || resolved < 0) {
+                        valid = false;
+                        break;
+                    }
+                    corners.push_back(resolved);
+                    while (q < eol && !isBlank(*q)) q++;
+                }
+                if (!valid || corners.size() < 3) {
+                    skipped++;
+                } else {
+                    for (size_t i = 1; i + 1 < corners.size() && ok; i++) {
+                        StreamTriangle64 tri = {{static_cast<uint64_t>(corners[0]), static_cast<uint64_t>(corners[i]),
+                                                 static_cast<uint64_t>(corners[i + 1])}};
+                        ok = triangleOut.push(tri);
+                        triangleCount++;
+                    }
+                }
+            }
+            p = eol + 1;
+
+            // Lo ya parseado no hace falta en memoria
+            if (static_cast<size_t>(p - obj.data()) >= released + releaseStep) {
+                obj.release(released, releaseStep);
+                released += releaseStep;
+            }
+        }
+        ok = vertexOut.flush() && ok;
+        ok = triangleOut.flush() && ok;
+        ok = std::fclose(vertexFile) == 0 && ok;
+        ok = std::fclose(triangleFile) == 0 && ok;
+        if (!ok) {
+            std::cerr << "Error: No se pudieron escribir los temporales junto a " << outPath << std::endl;
+            return false;
+        }
+    }
+    if (triangleCount == 0) {
+        std::cerr << "Error: " << objPath << " no tiene caras" << std::endl;
+        return false;
+    }
+
+    MappedFile vertexData, triangleData;
+    if (!vertexData.open(vertexPath) || !triangleData.open(trianglePath)) {
+        std::cerr << "Error: No se pudieron leer los temporales junto a " << outPath << std::endl;
+        return false;
+    }
+    const glm::vec3* positions = reinterpret_cast<const glm::vec3*>(vertexData.data());
+    const StreamTriangle64* triangles = reinterpret_cast<const StreamTriangle64*>(triangleData.data());
+    auto positionOf = [positions](uint64_t index) { return positions[index]; };
+    auto inRange = [vertexCount](const StreamTriangle64& tri) {
+        return tri.v[0] < vertexCount && tri.v[1] < vertexCount && tri.v[2] < vertexCount;
+    };
+
+    // 2. Rejilla: la celda más grande que deja al menos las celdas
+    // buscadas (los ejes planos quedan con una sola celda)
+    uint64_t wantedCells = std::max<uint64_t>(1, triangleCount / STREAM_CHUNK_TARGET_TRIANGLES);
+    glm::vec3 extent = glm::max(boundsMax - boundsMin, glm::vec3(1e-6f));
+    float cellSize = std::max({extent.x, extent.y, extent.z});
+    int dims[3] = {1, 1, 1};
+    while (static_cast<uint64_t>(dims[0]) * dims[1] * dims[2] < wantedCells) {
+        cellSize *= 0.9f;
+        for (int axis = 0; axis < 3; axis++) {
+            dims[axis] = std::max(1, static_cast<int>(std::ceil(extent[axis] / cellSize)));
+        }
+    }
+    size_t cellCount = static_cast<size_t>(dims[0]) * dims[1] * dims[2];
+    auto cellOf = [&](const StreamTriangle64& tri) {
+        glm::vec3 centroid = (positions[tri.v[0]] + positions[tri.v[1]] + positions[tri.v[2]]) / 3.0f;
+        size_t cell = 0;
+        for (int axis = 2; axis >= 0; axis--) {
+            int c = static_cast<int>((centroid[axis] - boundsMin[axis]) / cellSize);
+            cell = cell * dims[axis] + std::clamp(c, 0, dims[axis] - 1);
+        }
+        return cell;
+    };
+
+    std::vector<uint64_t> cellTriangles(cellCount, 0);
+    for (uint64_t t = 0; t < triangleCount; t++) {
+        if (inRange(triangles[t])) cellTriangles[cellOf(triangles[t])]++;
+        else skipped++;
+    }
+
+    // 3. Tandas de celdas
+    StreamWriter writer;
+    if (!writer.open(outPath)) return false;
+    StreamChunkBuilder builder;
+    size_t budgetTriangles = std::max<size_t>(STREAM_CHUNK_TARGET_TRIANGLES, memoryBudget / sizeof(StreamTriangle64));
+    std::vector<StreamTriangle64> pass;
+    std::vector<uint64_t> cellStart(cellCount + 1);
+    int passes = 0;
+
+    for (size_t first = 0; first < cellCount;) {
+        size_t last = first;
+        uint64_t count = 0;
+        while (last < cellCount && (last == first || count + cellTriangles[last] <= budgetTriangles)) {
+            count += cellTriangles[last++];
+        }
+
+        // Orden por celda dentro de la tanda (conteo)
+        uint64_t running = 0;
+        for (size_t c = first; c < last; c++) {
+            cellStart[c] = running;
+            running += cellTriangles[c];
+        }
+        pass.resize(count);
+        std::vector<uint64_t> fill(cellStart.begin() + first, cellStart.begin() + last);
+        for (uint64_t t = 0; t < triangleCount; t++) {
+            const StreamTriangle64& tri = triangles[t];
+            if (!inRange(tri)) continue;
+            size_t cell = cellOf(tri);
+            if (cell >= first && cell < last) pass[fill[cell - first]++] = tri;
+        }
+
+        for (size_t c = first; c < last; c++) {
+            for (uint64_t t = cellStart[c]; t < cellStart[c] + cellTriangles[c]; t++) {
+                if (!builder.add(pass[t].v, positionOf, writer)) return false;
+            }
+            if (!builder.flush(writer)) return false;
+        }
+        passes++;
+        first = last;
+    }
+    if (!writer.finish()) return false;
+
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    const StreamHeader& summary = writer.summary();
+    std::cout << "Malla por chunks: " << summary.triangleCount << " triángulos, " << summary.vertexCount
+              << " vértices en " << summary.chunkCount << " chunks (" << dims[0] << "x" << dims[1] << "x" << dims[2]
+              << " celdas, " << passes << " tandas, " << ms << " ms)" << std::endl;
+    if (skipped > 0) {
+        std::cerr << "Aviso: " << skipped << " caras con índices inválidos ignoradas" << std::endl;
+    }
+    return true;
+}
+
+// Malla de prueba de unos triangleTarget triángulos: un terreno ondulado
+// de chunks de STREAM_TEST_QUADS x STREAM_TEST_QUADS cuadrados, generado y
+// escrito de a un chunk
+const int STREAM_TEST_QUADS = 128;
+
+bool buildStreamTestTerrain(const std::string& path, uint64_t triangleTarget) {
+    auto start = std::chrono::steady_clock::now();
+    const uint64_t chunkTriangles = 2ull * STREAM_TEST_QUADS * STREAM_TEST_QUADS;
+    int side = std::max(1, static_cast<int>(std::ceil(std::sqrt(static_cast<double>(triangleTarget) / chunkTriangles))));
+
+    // Un cuadrado por unidad; el terreno queda centrado en el origen
+    const int row = STREAM_TEST_QUADS + 1;
+    float half = side * STREAM_TEST_QUADS * 0.5f;
+    auto height = [](float x, float z) {
+        return 6.0f * std::sin(x * 0.011f) * std::cos(z * 0.013f) + 1.5f * std::sin(x * 0.07f + z * 0.05f);
+    };
+
+    std::vector<glm::vec3> positions(static_cast<size_t>(row) * row);
+    std::vector<uint16_t> indices;
+    indices.reserve(chunkTriangles * 3);
+    for (int v = 0; v < STREAM_TEST_QUADS; v++) {
+        for (int u = 0; u < STREAM_TEST_QUADS; u++) {
+            uint16_t a = static_cast<uint16_t>(v * row + u);
+            uint16_t b = static_cast<uint16_t>(a + row);
+            indices.insert(indices.end(), {a, b, static_cast<uint16_t>(a + 1),
+                                           static_cast<uint16_t>(a + 1), b, static_cast<uint16_t>(b + 1)});
+        }
+    }
+
+    StreamWriter writer;
+    if (!writer.open(path)) return false;
+    for (int cz = 0; cz < side; cz++) {
+        for (int cx = 0; cx < side; cx++) {
+            for (int v = 0; v < row; v++) {
+                for (int u = 0; u < row; u++) {
+                    float x = (cx * STREAM_TEST_QUADS + u) - half;
+                    float z = (cz * STREAM_TEST_QUADS + v) - half;
+                    positions[static_cast<size_t>(v) * row + u] = glm::vec3(x, height(x, z), z);
+                }
+            }
+            if (!writer.addChunk(positions, indices)) {
+                std::cerr << "Error: No se pudo escribir " << path << std::endl;
+                return false;
+            }
+        }
+    }
+    if (!writer.finish()) return false;
+
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    const StreamHeader& summary = writer.summary();
+    std::cout << "Terreno de prueba: " << summary.triangleCount << " triángulos en " << summary.chunkCount
+              << " chunks (" << ms << " ms)" << std::endl;
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Dibujo
+// ---------------------------------------------------------------------------
+
+// Pico de memoria residente del proceso en MB (-1 si no se sabe)
+double peakResidentMB() {
+#ifdef _WIN32
+    return -1.0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return -1.0;
+#ifdef __APPLE__
+    return usage.ru_maxrss / (1024.0 * 1024.0);
+#else
+    return usage.ru_maxrss / 1024.0;
+#endif
+#endif
+}
+
+// Si count elementos de elementSize bytes desde offset caben en un archivo
+// de fileSize bytes, sin desbordar con offsets o cantidades corruptas
+inline bool streamRangeFits(uint64_t offset, uint64_t count, uint64_t elementSize, uint64_t fileSize) {
+    return offset <= fileSize && count <= (fileSize - offset) / elementSize;
+}
+
+// Contadores del dibujo por chunks
+struct StreamStats {
+    uint64_t chunks = 0;
+    uint64_t culledChunks = 0;          // Fuera del frustum por su esfera
+    uint64_t loads = 0;                 // Chunks copiados desde el archivo
+    uint64_t evictions = 0;
+    uint64_t bytesLoaded = 0;
+    uint64_t triangles = 0;             // De los chunks visibles
+    uint64_t backfaceTriangles = 0;
+    uint64_t clipped = 0;
+    uint64_t drawn = 0;                 // Enviados al rasterizador
+};
+
+// Cámara con la que se dibuja la malla. lightDir está en espacio de vista.
+struct StreamCamera {
+    glm::mat4 view, projection, viewport;
+    glm::vec3 lightDir;
+};
+
+struct StreamedTriangle {
+    glm::vec3 v0, v1, v2;
+    Color color;
+};
+
+// Chunk copiado a memoria
+struct ResidentChunk {
+    int chunk = -1;
+    VertexStreams positions;
+    std::vector<uint16_t> indices;
+    uint64_t lastUse = 0;
+    size_t bytes = 0;
+};
+
+class StreamedMesh {
+public:
+    // Abrir un .meshchunks. budget es el tamaño máximo de la caché de
+    // residencia en bytes.
+    bool open(const std::string& path, size_t budget) {
+        if (!file.open(path)) {
+            std::cerr << "Error: No se pudo abrir " << path << std::endl;
+            return false;
+        }
+        bool ok = file.size() >= sizeof(StreamHeader);
+        if (ok) {
+            std::memcpy(&header, file.data(), sizeof(header));
+            ok = std::memcmp(header.magic, STREAM_MAGIC, sizeof(header.magic)) == 0 &&
+                 header.version == STREAM_VERSION &&
+                 streamRangeFits(header.directoryOffset, header.chunkCount, sizeof(StreamChunk), file.size());
+        }
+        if (ok) {
+            chunks.resize(header.chunkCount);
+            std::memcpy(chunks.data(), file.data() + header.directoryOffset, chunks.size() * sizeof(StreamChunk));
+            for (const StreamChunk& chunk : chunks) {
+                // Los índices van después de los vértices: release() en
+                // acquire() devuelve los dos juntos
+                if (chunk.vertexCount > STREAM_CHUNK_MAX_VERTICES || chunk.indexOffset < chunk.vertexOffset ||
+                    !streamRangeFits(chunk.vertexOffset, chunk.vertexCount, sizeof(glm::vec3), file.size()) ||
+                    !streamRangeFits(chunk.indexOffset, static_cast<uint64_t>(chunk.triangleCount) * 3,
+                                     sizeof(uint16_t), file.size())) {
+                    ok = false;
+                }
+            }
+        }
+        if (!ok) {
+            std::cerr << "Error: " << path << " no es un .meshchunks válido" << std::endl;
+            file.close();
+            return false;
+        }
+        file.release(0, file.size());
+
+        filePath = path;
+        budgetBytes = budget;
+        residentBytes = 0;
+        peakBytes = 0;
+        slotOf.assign(chunks.size(), -1);
+        slots.clear();
+        return true;
+    }
+
+    const StreamHeader& info() const {
+        return header;
+    }
+
+    size_t residentSize() const {
+        return residentBytes;
+    }
+
+    size_t peakResidentSize() const {
+        return peakBytes;
+    }
+
+    // Dibujar la malla en el framebuffer (ya borrado). false si un chunk
+    // resultó inválido al leerlo.
+    bool render(const StreamCamera& camera, StreamStats& stats) {
+        glm::mat4 mvp = camera.projection * camera.view;
+        FrustumPlanes frustum = extractFrustum(mvp);
+        glm::mat3 inverseRotation = glm::transpose(glm::mat3(camera.view));
+        glm::vec3 eye = -(inverseRotation * glm::vec3(camera.view[3]));
+        glm::vec3 objectLight = inverseRotation * camera.lightDir;
+
+        // Chunks visibles de adelante hacia atrás, sin tocar sus datos
+        visible.clear();
+        distances.clear();
+        {
+            PROFILE_SCOPE(PROFILE_CULL);
+            for (size_t i = 0; i < chunks.size(); i++) {
+                const StreamChunk& chunk = chunks[i];
+                stats.chunks++;
+                if (sphereOutsideFrustum(frustum, chunk.center, chunk.radius)) {
+                    stats.culledChunks++;
+                    continue;
+                }
+                visible.push_back(static_cast<uint32_t>(i));
+                distances.push_back(glm::length(chunk.center - eye) - chunk.radius);
+            }
+            sorter.sortFrontToBack(distances.data(), distances.size(), order);
+        }
+
+        ThreadPool& pool = renderPool();
+        size_t groupSize = static_cast<size_t>(pool.size());
+        work.resize(groupSize);
+        VertexTransform transform = makeVertexTransform(mvp, camera.view, camera.viewport);
+
+        for (size_t first = 0; first < order.size(); first += groupSize) {
+            size_t count = std::min(groupSize, order.size() - first);
+            useClock++;
+
+            // Carga secuencial: la caché no se comparte entre hilos. Los
+            // lugares se guardan como índices porque slots puede crecer
+            // mientras se carga el grupo.
+            {
+                PROFILE_SCOPE(PROFILE_STREAM);
+                for (size_t k = 0; k < count; k++) {
+                    work[k].chunk = visible[order[first + k]];
+                    work[k].slot = acquire(work[k].chunk, stats);
+                    if (work[k].slot < 0) return false;
+                }
+            }
+
+            {
+                PROFILE_SCOPE(PROFILE_ASSEMBLE);
+                pool.parallelFor(static_cast<int>(count), [&](int k, int) {
+                    assembleChunk(work[k], transform, camera, frustum, eye, objectLight);
+                });
+            }
+
+            // Un solo reparto y rasterizado por grupo, en el orden de los chunks
+            groupTriangles.clear();
+            for (size_t k = 0; k < count; k++) {
+                const ChunkWork& w = work[k];
+                groupTriangles.insert(groupTriangles.end(), w.triangles.begin(), w.triangles.end());
+                stats.triangles += chunks[w.chunk].triangleCount;
+                stats.backfaceTriangles += w.backface;
+                stats.clipped += w.clipped;
+            }
+            stats.drawn += groupTriangles.size();
+            PROFILE_COUNT(COUNTER_TRIANGLES_DRAWN, groupTriangles.size());
+            rasterizeTiled(groupTriangles);
+        }
+        return true;
+    }
+
+private:
+    // Lo que arma un hilo a partir de un chunk
+    struct ChunkWork {
+        uint32_t chunk = 0;
+        int slot = -1;                  // Lugar en slots
+        TransformedVertices vertices;
+        std::vector<StreamedTriangle> triangles;
+        uint64_t backface = 0;
+        uint64_t clipped = 0;
+    };
+
+    // Lugar en slots del chunk, copiándolo del archivo si hace falta, o -1
+    // si sus índices se salen de sus vértices. Para hacer lugar sale el que
+    // no se usa hace más tiempo, salvo los del grupo actual (si el
+    // presupuesto no alcanza para un grupo se excede).
+    int acquire(uint32_t index, StreamStats& stats) {
+        if (slotOf[index] >= 0) {
+            slots[slotOf[index]].lastUse = useClock;
+            return slotOf[index];
+        }
+
+        const StreamChunk& chunk = chunks[index];
+        const uint16_t* sourceIndices = reinterpret_cast<const uint16_t*>(file.data() + chunk.indexOffset);
+        size_t indexCount = static_cast<size_t>(chunk.triangleCount) * 3;
+        for (size_t i = 0; i < indexCount; i++) {
+            if (sourceIndices[i] >= chunk.vertexCount) {
+                std::cerr << "Error: " << filePath << ": el chunk " << index
+                          << " tiene índices fuera de sus vértices" << std::endl;
+                return -1;
+            }
+        }
+
+        size_t bytes = static_cast<size_t>(chunk.vertexCount) * 3 * sizeof(float) + indexCount * sizeof(uint16_t);
+        int slot = -1;
+        while (residentBytes + bytes > budgetBytes) {
+            int oldest = -1;
+            for (size_t s = 0; s < slots.size(); s++) {
+                if (slots[s].chunk >= 0 && slots[s].lastUse < useClock &&
+                    (oldest < 0 || slots[s].lastUse < slots[oldest].lastUse)) {
+                    oldest = static_cast<int>(s);
+                }
+            }
+            if (oldest < 0) break;
+            evict(slots[oldest]);
+            stats.evictions++;
+            slot = oldest;
+        }
+        if (slot < 0) {
+            for (size_t s = 0; s < slots.size() && slot < 0; s++) {
+                if (slots[s].chunk < 0) slot = static_cast<int>(s);
+            }
+        }
+        if (slot < 0) {
+            slot = static_cast<int>(slots.size());
+            slots.emplace_back();
+        }
+
+        // Copiar y devolver las páginas leídas del mapeo
+        ResidentChunk& resident = slots[slot];
+        const glm::vec3* source = reinterpret_cast<const glm::vec3*>(file.data() + chunk.vertexOffset);
+        resident.positions.resize(chunk.vertexCount);
+        for (uint32_t v = 0; v < chunk.vertexCount; v++) {
+            resident.positions.x[v] = source[v].x;
+            resident.positions.y[v] = source[v].y;
+            resident.positions.z[v] = source[v].z;
+        }
+        resident.indices.assign(sourceIndices, sourceIndices + indexCount);
+        file.release(chunk.vertexOffset, chunk.indexOffset + resident.indices.size() * sizeof(uint16_t) -
+                                         chunk.vertexOffset);
+
+        resident.chunk = static_cast<int>(index);
+        resident.lastUse = useClock;
+        resident.bytes = bytes;
+        slotOf[index] = slot;
+        residentBytes += bytes;
+        peakBytes = std::max(peakBytes, residentBytes);
+        stats.loads++;
+        stats.bytesLoaded += bytes;
+        return slot;
+    }
+
+    void evict(ResidentChunk& resident) {
+        slotOf[resident.chunk] = -1;
+        residentBytes -= resident.bytes;
+        resident.chunk = -1;
+        resident.bytes = 0;
+        // Liberar de verdad: resize no devuelve la memoria
+        resident.positions = VertexStreams();
+        std::vector<uint16_t>().swap(resident.indices);
+    }
+
+    // Transformar un chunk y armar sus triángulos de frente: cara trasera
+    // en espacio del objeto y recorte contra el plano cercano (y la banda
+    // de guarda) sólo si la esfera del chunk lo cruza
+    void assembleChunk(ChunkWork& w, const VertexTransform& transform, const StreamCamera& camera,
+                       const FrustumPlanes& frustum, const glm::vec3& eye, const glm::vec3& objectLight) {
+        const ResidentChunk& resident = slots[w.slot];
+        const StreamChunk& chunk = chunks[w.chunk];
+        const VertexStreams& positions = resident.positions;
+        size_t vertexCount = positions.size();
+        w.vertices.screen.resize(vertexCount);
+        w.vertices.view.resize(vertexCount);
+        transformRange(transform, positions, w.vertices, 0, vertexCount);
+
+        int clipMask = sphereClipMask(frustum, chunk.center, chunk.radius);
+        w.triangles.clear();
+        w.backface = 0;
+        w.clipped = 0;
+        const uint16_t* indices = resident.indices.data();
+        for (size_t t = 0; t < resident.indices.size(); t += 3) {
+            glm::vec3 p0 = positions.get(indices[t]);
+            glm::vec3 p1 = positions.get(indices[t + 1]);
+            glm::vec3 p2 = positions.get(indices[t + 2]);
+            glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+            if (!(glm::dot(normal, eye - p0) > 0.0f)) {
+                w.backface++;
+                continue;
+            }
+            float length = glm::length(normal);
+            float intensity = length > 0.0f ? glm::dot(normal, objectLight) / length : 0.0f;
+            Color color = shadeColor(STREAM_BASE_COLOR, intensity);
+
+            if (clipMask) {
+                glm::vec4 clip[3];
+                int outcodeAll = ~0;
+                int outcodeAny = 0;
+                for (int v = 0; v < 3; v++) {
+                    clip[v] = camera.projection * glm::vec4(w.vertices.view.get(indices[t + v]), 1.0f);
+                    int outcode = clipOutcode(clip[v]) & clipMask;
+                    outcodeAll &= outcode;
+                    outcodeAny |= outcode;
+                }
+                if (outcodeAll) continue;
+                if (outcodeAny) {
+                    glm::vec4 polygon[CLIP_MAX_VERTICES];
+                    glm::vec3 weights[CLIP_MAX_VERTICES];
+                    int n = clipTriangle(clip, outcodeAny, polygon, weights);
+                    w.clipped++;
+                    for (int k = 1; k + 1 < n; k++) {
+                        w.triangles.push_back(StreamedTriangle{clipToScreen(polygon[0], camera.viewport),
+                                                               clipToScreen(polygon[k], camera.viewport),
+                                                               clipToScreen(polygon[k + 1], camera.viewport), color});
+                    }
+                    continue;
+                }
+            }
+            w.triangles.push_back(StreamedTriangle{w.vertices.screen.get(indices[t]),
+                                                   w.vertices.screen.get(indices[t + 1]),
+                                                   w.vertices.screen.get(indices[t + 2]), color});
+        }
+    }
+
+    MappedFile file;
+    std::string filePath;
+    StreamHeader header = {};
+    std::vector<StreamChunk> chunks;
+
+    // Caché de residencia
+    size_t budgetBytes = 0;
+    size_t residentBytes = 0;
+    size_t peakBytes = 0;
+    std::vector<int> slotOf;            // Por chunk: su lugar en slots o -1
+    std::vector<ResidentChunk> slots;
+    uint64_t useClock = 0;
+
+    // Buffers reutilizados entre frames
+    std::vector<uint32_t> visible;
+    std::vector<float> distances;
+    std::vector<uint32_t> order;
+    DepthSorter sorter;
+    std::vector<ChunkWork> work;
+    std::vector<StreamedTriangle> groupTriangles;
+};
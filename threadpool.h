@@ -0,0 +1,134 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Pool de hilos persistente para repartir trabajo por índices (tiles,
+// rangos de vértices, etc.). El hilo que llama a parallelFor también
+// trabaja, así que un pool de N hilos crea N - 1 hilos extra.
+//
+// parallelFor no es reentrante: no debe llamarse desde dentro de una tarea.
+// Sí pueden llamarla dos hilos a la vez (el principal y el del pipeline de
+// frames): se turnan, y mientras uno reparte su trabajo el otro sigue con
+// sus etapas de un solo hilo.
+class ThreadPool {
+public:
+    explicit ThreadPool(int threads) {
+        if (threads < 1) threads = 1;
+        for (int i = 1; i < threads; i++) {
+            workers.emplace_back([this, i] { workerLoop(i); });
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int size() const {
+        return static_cast<int>(workers.size()) + 1;
+    }
+
+    // Ejecutar fn(index, worker) para cada index en [0, count). Los índices se
+    // reparten dinámicamente; worker identifica al hilo (0 = el que llama).
+    void parallelFor(int count, const std::function<void(int, int)>& fn) {
+        if (count <= 0) return;
+        if (workers.empty() || count == 1) {
+            for (int i = 0; i < count; i++) fn(i, 0);
+            return;
+        }
+
+        std::lock_guard<std::mutex> turn(submitMutex);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            task = &fn;
+            taskCount = count;
+            nextIndex.store(0);
+            pending = static_cast<int>(workers.size());
+            generation++;
+        }
+        wake.notify_all();
+
+        runTasks(0);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] { return pending == 0; });
+        task = nullptr;
+    }
+
+private:
+    void runTasks(int worker) {
+        while (true) {
+            int index = nextIndex.fetch_add(1);
+            if (index >= taskCount) break;
+            (*task)(index, worker);
+        }
+    }
+
+    void workerLoop(int worker) {
+        uint64_t seen = 0;
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            wake.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping) return;
+            seen = generation;
+
+            lock.unlock();
+            runTasks(worker);
+            lock.lock();
+
+            if (--pending == 0) {
+                done.notify_one();
+            }
+        }
+    }
+
+    std::vector<std::thread> workers;
+    std::mutex submitMutex;     // Un parallelFor a la vez
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+
+    const std::function<void(int, int)>* task = nullptr;
+    int taskCount = 0;
+    std::atomic<int> nextIndex{0};
+    int pending = 0;
+    uint64_t generation = 0;
+    bool stopping = false;
+};
+
+// Número de hilos de render (0 = uno por núcleo)
+int renderThreads = 0;
+
+std::unique_ptr<ThreadPool> renderPoolInstance;
+
+// Un hilo por núcleo
+int defaultThreadCount() {
+    return std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+}
+
+// Pool compartido por todas las etapas (carga, vértices, tiles); se recrea
+// si cambia renderThreads
+ThreadPool& renderPool() {
+    int wanted = renderThreads > 0 ? renderThreads : defaultThreadCount();
+    if (!renderPoolInstance || renderPoolInstance->size() != wanted) {
+        renderPoolInstance.reset();
+        renderPoolInstance.reset(new ThreadPool(wanted));
+    }
+    return *renderPoolInstance;
+}
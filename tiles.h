@@ -0,0 +1,182 @@
+#pragma once
+#include <SDL2/SDL.h>
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include "color.h"
+#include "framebuffer.h"
+#include "profiler.h"
+#include "rasterizer.h"
+#include "threadpool.h"
+
+// Rasterización por tiles en varios hilos.
+//
+// Los triángulos ya transformados se reparten (binning) en tiles de
+// TILE_SIZE x TILE_SIZE píxeles. Cada hilo procesa tiles completos, así que
+// ningún píxel de color o profundidad lo escriben dos hilos a la vez y no
+// hacen falta locks ni atómicos. Dentro de cada tile los triángulos se
+// dibujan en el mismo orden en que llegaron, y el rasterizador calcula cada
+// píxel igual sin importar el rectángulo de recorte, así que el resultado es
+// idéntico al de un solo hilo.
+//
+// Cada tile guarda además la profundidad máxima de su z-buffer (el nivel
+// grueso del Hi-Z). Un triángulo cuyo vértice más cercano queda detrás de
+// ese valor se descarta antes de preparar sus aristas. Con los triángulos
+// ordenados de adelante hacia atrás esto elimina casi todo lo oculto.
+
+// Múltiplo de RASTER_BLOCK
+const int TILE_SIZE = 64;
+
+// Tiles a la resolución de la ventana; a menor resolución se usan menos
+const int MAX_TILES = ((SCREEN_WIDTH + TILE_SIZE - 1) / TILE_SIZE) * ((SCREEN_HEIGHT + TILE_SIZE - 1) / TILE_SIZE);
+
+// Tiles a la resolución interna actual
+inline int tilesX() {
+    return (renderWidth + TILE_SIZE - 1) / TILE_SIZE;
+}
+
+inline int tilesY() {
+    return (renderHeight + TILE_SIZE - 1) / TILE_SIZE;
+}
+
+// Índices de triángulos por tile, reutilizados entre frames
+std::vector<std::vector<uint32_t>> tileBins(MAX_TILES);
+
+// Profundidad máxima por tile; se recalcula desde el Hi-Z cuando el tile
+// recibió escrituras
+std::vector<float> tileMaxDepth(MAX_TILES);
+std::vector<uint8_t> tileMaxDirty(MAX_TILES, 1);
+
+// Contadores de cada hilo durante rasterizeTiled
+std::vector<RasterStats> tileWorkerStats;
+
+RasterRect tileRect(int tile) {
+    int tx = tile % tilesX();
+    int ty = tile / tilesX();
+    return RasterRect{
+        tx * TILE_SIZE,
+        ty * TILE_SIZE,
+        std::min(renderWidth, (tx + 1) * TILE_SIZE) - 1,
+        std::min(renderHeight, (ty + 1) * TILE_SIZE) - 1
+    };
+}
+
+float tileDepthBound(int tile) {
+    if (tileMaxDirty[tile]) {
+        RasterRect rect = tileRect(tile);
+        float maxDepth = -std::numeric_limits<float>::max();
+        for (int by = rect.minY / HIZ_BLOCK; by <= rect.maxY / HIZ_BLOCK; by++) {
+            for (int bx = rect.minX / HIZ_BLOCK; bx <= rect.maxX / HIZ_BLOCK; bx++) {
+                maxDepth = std::max(maxDepth, framebuffer.hiz[by * framebuffer.blocksX + bx]);
+            }
+        }
+        tileMaxDepth[tile] = maxDepth;
+        tileMaxDirty[tile] = 0;
+    }
+    return tileMaxDepth[tile];
+}
+
+// Repartir triángulos en los tiles que toca su bounding box, en el orden
+// dado por order (vacío = el orden de la lista).
+// Tri debe tener v0, v1, v2 en coordenadas de pantalla.
+template <typename Tri>
+void binTriangles(const std::vector<Tri>& triangles, const std::vector<uint32_t>& order) {
+    PROFILE_SCOPE(PROFILE_BIN);
+    for (auto& bin : tileBins) {
+        bin.clear();
+    }
+
+    int columns = tilesX();
+    int rows = tilesY();
+    float width = static_cast<float>(renderWidth);
+    float height = static_cast<float>(renderHeight);
+
+    size_t count = order.empty() ? triangles.size() : order.size();
+    for (size_t n = 0; n < count; n++) {
+        uint32_t i = order.empty() ? static_cast<uint32_t>(n) : order[n];
+        const Tri& tri = triangles[i];
+        float minX = std::min({tri.v0.x, tri.v1.x, tri.v2.x});
+        float minY = std::min({tri.v0.y, tri.v1.y, tri.v2.y});
+        float maxX = std::max({tri.v0.x, tri.v1.x, tri.v2.x});
+        float maxY = std::max({tri.v0.y, tri.v1.y, tri.v2.y});
+
+        // También descarta coordenadas NaN
+        if (!(maxX >= 0.0f && maxY >= 0.0f && minX < width && minY < height)) {
+            continue;
+        }
+
+        int tx0 = static_cast<int>(std::max(minX, 0.0f)) / TILE_SIZE;
+        int ty0 = static_cast<int>(std::max(minY, 0.0f)) / TILE_SIZE;
+        int tx1 = std::min(columns - 1, static_cast<int>(std::min(maxX, width)) / TILE_SIZE);
+        int ty1 = std::min(rows - 1, static_cast<int>(std::min(maxY, height)) / TILE_SIZE);
+
+        for (int ty = ty0; ty <= ty1; ty++) {
+            for (int tx = tx0; tx <= tx1; tx++) {
+                tileBins[ty * columns + tx].push_back(i);
+            }
+        }
+    }
+}
+
+// Dibujar los triángulos ya repartidos por binTriangles repartiendo los
+// tiles entre hilos. draw(tri, índice, rect, target) dibuja un triángulo
+// recortado al tile y devuelve si llegó a escribir algo. Los contadores se
+// suman a rasterStats.
+template <typename Tri, typename Draw>
+void rasterizeBinnedWith(const std::vector<Tri>& triangles, Draw draw) {
+    PROFILE_SCOPE(PROFILE_RASTER);
+    ThreadPool& pool = renderPool();
+    tileWorkerStats.assign(pool.size(), RasterStats());
+    std::fill(tileMaxDirty.begin(), tileMaxDirty.end(), 1);
+
+    pool.parallelFor(tilesX() * tilesY(), [&](int tile, int worker) {
+        RasterTarget target = screenTarget();
+        target.stats = &tileWorkerStats[worker];
+
+        RasterRect rect = tileRect(tile);
+        for (uint32_t index : tileBins[tile]) {
+            const Tri& tri = triangles[index];
+            if (rasterHiZ) {
+                float zMin = std::min({tri.v0.z, tri.v1.z, tri.v2.z});
+                if (zMin >= tileDepthBound(tile)) {
+                    target.stats->trianglesRejected++;
+                    continue;
+                }
+            }
+            if (draw(tri, index, rect, target)) {
+                tileMaxDirty[tile] = 1;
+            }
+        }
+    });
+
+    for (const RasterStats& stats : tileWorkerStats) {
+        rasterStats.add(stats);
+        PROFILE_COUNT(COUNTER_TRIANGLES_HIZ, stats.trianglesRejected);
+        PROFILE_COUNT(COUNTER_PIXELS_TESTED, stats.pixelsTested);
+        PROFILE_COUNT(COUNTER_PIXELS_WRITTEN, stats.pixelsWritten);
+    }
+}
+
+// Con depthOnly sólo se escribe la profundidad
+template <typename Tri>
+void rasterizeBinned(const std::vector<Tri>& triangles, bool depthOnly = false) {
+    rasterizeBinnedWith(triangles, [depthOnly](const Tri& tri, uint32_t, const RasterRect& rect,
+                                               const RasterTarget& target) {
+        return depthOnly ? rasterizeTriangleDepth(tri, rect, target) : rasterizeTriangle(tri, rect, target);
+    });
+}
+
+// Repartir y dibujar una lista de triángulos en el orden dado
+template <typename Tri>
+void rasterizeTiled(const std::vector<Tri>& triangles, const std::vector<uint32_t>& order, bool depthOnly = false) {
+    binTriangles(triangles, order);
+    rasterizeBinned(triangles, depthOnly);
+}
+
+template <typename Tri>
+void rasterizeTiled(const std::vector<Tri>& triangles) {
+    rasterizeTiled(triangles, std::vector<uint32_t>());
+}
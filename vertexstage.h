@@ -0,0 +1,234 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+#include "rasterizer.h"
+#include "tiles.h"
+
+// Etapa de vértices: transforma cada vértice del modelo una sola vez por
+// frame. Los datos se guardan como estructura de arreglos (SoA) para poder
+// procesar 4 u 8 vértices por instrucción; las caras sólo guardan índices.
+
+// A partir de este número de vértices la transformación se reparte entre hilos
+const size_t VERTEX_PARALLEL_THRESHOLD = 16384;
+const size_t VERTEX_CHUNK = 8192;
+
+// Coordenadas x, y, z en arreglos separados
+struct VertexStreams {
+    std::vector<float> x, y, z;
+
+    size_t size() const {
+        return x.size();
+    }
+
+    void resize(size_t n) {
+        x.resize(n);
+        y.resize(n);
+        z.resize(n);
+    }
+
+    glm::vec3 get(size_t i) const {
+        return glm::vec3(x[i], y[i], z[i]);
+    }
+};
+
+// Resultado de la etapa de vértices
+struct TransformedVertices {
+    VertexStreams screen;   // x, y en píxeles; z = profundidad NDC
+    VertexStreams view;     // Posición en espacio de vista
+};
+
+// Pasar los vértices del modelo a SoA, centrados y escalados
+void loadVertexStreams(const std::vector<glm::vec3>& in, const glm::vec3& center, float scale,
+                       VertexStreams& out) {
+    out.resize(in.size());
+    for (size_t i = 0; i < in.size(); i++) {
+        glm::vec3 centered = (in[i] - center) * scale;
+        out.x[i] = centered.x;
+        out.y[i] = centered.y;
+        out.z[i] = centered.z;
+    }
+}
+
+// Elementos de las matrices como escalares, en el orden en que los usan
+// los núcleos
+struct VertexTransform {
+    float mvp[16];
+    float mv[12];
+    float scaleX, scaleY;       // Viewport
+    float offsetX, offsetY;
+};
+
+VertexTransform makeVertexTransform(const glm::mat4& mvp, const glm::mat4& mv, const glm::mat4& viewport) {
+    VertexTransform t;
+    for (int col = 0; col < 4; col++) {
+        for (int row = 0; row < 4; row++) {
+            t.mvp[col * 4 + row] = mvp[col][row];
+        }
+        for (int row = 0; row < 3; row++) {
+            t.mv[col * 3 + row] = mv[col][row];
+        }
+    }
+    t.scaleX = viewport[0][0];
+    t.scaleY = viewport[1][1];
+    t.offsetX = viewport[3][0];
+    t.offsetY = viewport[3][1];
+    return t;
+}
+
+void transformRangeScalar(const VertexTransform& t, const VertexStreams& in, TransformedVertices& out,
+                          size_t begin, size_t end) {
+    const float* m = t.mvp;
+    const float* v = t.mv;
+
+    for (size_t i = begin; i < end; i++) {
+        float x = in.x[i], y = in.y[i], z = in.z[i];
+
+        float cx = (m[0] * x + m[4] * y) + (m[8] * z + m[12]);
+        float cy = (m[1] * x + m[5] * y) + (m[9] * z + m[13]);
+        float cz = (m[2] * x + m[6] * y) + (m[10] * z + m[14]);
+        float cw = (m[3] * x + m[7] * y) + (m[11] * z + m[15]);
+
+        if (cw != 0.0f) {
+            cx /= cw;
+            cy /= cw;
+            cz /= cw;
+        }
+
+        out.screen.x[i] = t.scaleX * cx + t.offsetX;
+        out.screen.y[i] = t.scaleY * cy + t.offsetY;
+        out.screen.z[i] = cz;
+
+        out.view.x[i] = (v[0] * x + v[3] * y) + (v[6] * z + v[9]);
+        out.view.y[i] = (v[1] * x + v[4] * y) + (v[7] * z + v[10]);
+        out.view.z[i] = (v[2] * x + v[5] * y) + (v[8] * z + v[11]);
+    }
+}
+
+#if RASTER_HAS_X86
+// Fila r de una matriz guardada por columnas de n elementos, aplicada a (x, y, z, 1)
+inline __m128 matrixRowSSE2(const __m128* c, int r, int n, __m128 x, __m128 y, __m128 z) {
+    return _mm_add_ps(_mm_add_ps(_mm_mul_ps(c[r], x), _mm_mul_ps(c[r + n], y)),
+                      _mm_add_ps(_mm_mul_ps(c[r + 2 * n], z), c[r + 3 * n]));
+}
+
+RASTER_TARGET_AVX2
+inline __m256 matrixRowAVX2(const __m256* c, int r, int n, __m256 x, __m256 y, __m256 z) {
+    return _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(c[r], x), _mm256_mul_ps(c[r + n], y)),
+                         _mm256_add_ps(_mm256_mul_ps(c[r + 2 * n], z), c[r + 3 * n]));
+}
+
+void transformRangeSSE2(const VertexTransform& t, const VertexStreams& in, TransformedVertices& out,
+                        size_t begin, size_t end) {
+    __m128 m[16], v[12];
+    for (int i = 0; i < 16; i++) m[i] = _mm_set1_ps(t.mvp[i]);
+    for (int i = 0; i < 12; i++) v[i] = _mm_set1_ps(t.mv[i]);
+    __m128 sx = _mm_set1_ps(t.scaleX), ox = _mm_set1_ps(t.offsetX);
+    __m128 sy = _mm_set1_ps(t.scaleY), oy = _mm_set1_ps(t.offsetY);
+    __m128 zero = _mm_setzero_ps();
+    __m128 one = _mm_set1_ps(1.0f);
+
+    size_t i = begin;
+    for (; i + 4 <= end; i += 4) {
+        __m128 x = _mm_loadu_ps(&in.x[i]);
+        __m128 y = _mm_loadu_ps(&in.y[i]);
+        __m128 z = _mm_loadu_ps(&in.z[i]);
+
+        __m128 cx = matrixRowSSE2(m, 0, 4, x, y, z);
+        __m128 cy = matrixRowSSE2(m, 1, 4, x, y, z);
+        __m128 cz = matrixRowSSE2(m, 2, 4, x, y, z);
+        __m128 cw = matrixRowSSE2(m, 3, 4, x, y, z);
+
+        // w == 0 deja el vértice sin dividir, igual que el camino escalar
+        __m128 isZero = _mm_cmpeq_ps(cw, zero);
+        cw = _mm_or_ps(_mm_and_ps(isZero, one), _mm_andnot_ps(isZero, cw));
+        cx = _mm_div_ps(cx, cw);
+        cy = _mm_div_ps(cy, cw);
+        cz = _mm_div_ps(cz, cw);
+
+        _mm_storeu_ps(&out.screen.x[i], _mm_add_ps(_mm_mul_ps(sx, cx), ox));
+        _mm_storeu_ps(&out.screen.y[i], _mm_add_ps(_mm_mul_ps(sy, cy), oy));
+        _mm_storeu_ps(&out.screen.z[i], cz);
+
+        _mm_storeu_ps(&out.view.x[i], matrixRowSSE2(v, 0, 3, x, y, z));
+        _mm_storeu_ps(&out.view.y[i], matrixRowSSE2(v, 1, 3, x, y, z));
+        _mm_storeu_ps(&out.view.z[i], matrixRowSSE2(v, 2, 3, x, y, z));
+    }
+
+    transformRangeScalar(t, in, out, i, end);
+}
+
+RASTER_TARGET_AVX2
+void transformRangeAVX2(const VertexTransform& t, const VertexStreams& in, TransformedVertices& out,
+                        size_t begin, size_t end) {
+    __m256 m[16], v[12];
+    for (int i = 0; i < 16; i++) m[i] = _mm256_set1_ps(t.mvp[i]);
+    for (int i = 0; i < 12; i++) v[i] = _mm256_set1_ps(t.mv[i]);
+    __m256 sx = _mm256_set1_ps(t.scaleX), ox = _mm256_set1_ps(t.offsetX);
+    __m256 sy = _mm256_set1_ps(t.scaleY), oy = _mm256_set1_ps(t.offsetY);
+    __m256 zero = _mm256_setzero_ps();
+    __m256 one = _mm256_set1_ps(1.0f);
+
+    size_t i = begin;
+    for (; i + 8 <= end; i += 8) {
+        __m256 x = _mm256_loadu_ps(&in.x[i]);
+        __m256 y = _mm256_loadu_ps(&in.y[i]);
+        __m256 z = _mm256_loadu_ps(&in.z[i]);
+
+        __m256 cx = matrixRowAVX2(m, 0, 4, x, y, z);
+        __m256 cy = matrixRowAVX2(m, 1, 4, x, y, z);
+        __m256 cz = matrixRowAVX2(m, 2, 4, x, y, z);
+        __m256 cw = matrixRowAVX2(m, 3, 4, x, y, z);
+
+        cw = _mm256_blendv_ps(cw, one, _mm256_cmp_ps(cw, zero, _CMP_EQ_OQ));
+        cx = _mm256_div_ps(cx, cw);
+        cy = _mm256_div_ps(cy, cw);
+        cz = _mm256_div_ps(cz, cw);
+
+        _mm256_storeu_ps(&out.screen.x[i], _mm256_add_ps(_mm256_mul_ps(sx, cx), ox));
+        _mm256_storeu_ps(&out.screen.y[i], _mm256_add_ps(_mm256_mul_ps(sy, cy), oy));
+        _mm256_storeu_ps(&out.screen.z[i], cz);
+
+        _mm256_storeu_ps(&out.view.x[i], matrixRowAVX2(v, 0, 3, x, y, z));
+        _mm256_storeu_ps(&out.view.y[i], matrixRowAVX2(v, 1, 3, x, y, z));
+        _mm256_storeu_ps(&out.view.z[i], matrixRowAVX2(v, 2, 3, x, y, z));
+    }
+
+    transformRangeScalar(t, in, out, i, end);
+}
+#endif
+
+void transformRange(const VertexTransform& t, const VertexStreams& in, TransformedVertices& out,
+                    size_t begin, size_t end) {
+    switch (rasterPath) {
+#if RASTER_HAS_X86
+        case RasterPath::AVX2: transformRangeAVX2(t, in, out, begin, end); break;
+        case RasterPath::SSE2: transformRangeSSE2(t, in, out, begin, end); break;
+#endif
+        default: transformRangeScalar(t, in, out, begin, end); break;
+    }
+}
+
+// Transformar todos los vértices a pantalla y a espacio de vista. Las
+// mallas grandes se reparten en bloques entre los hilos de render.
+void transformVertices(const VertexStreams& in, const glm::mat4& mvp, const glm::mat4& mv,
+                       const glm::mat4& viewport, TransformedVertices& out) {
+    size_t count = in.size();
+    out.screen.resize(count);
+    out.view.resize(count);
+
+    VertexTransform t = makeVertexTransform(mvp, mv, viewport);
+
+    if (count < VERTEX_PARALLEL_THRESHOLD) {
+        transformRange(t, in, out, 0, count);
+        return;
+    }
+
+    int chunks = static_cast<int>((count + VERTEX_CHUNK - 1) / VERTEX_CHUNK);
+    renderPool().parallelFor(chunks, [&](int chunk, int) {
+        size_t begin = static_cast<size_t>(chunk) * VERTEX_CHUNK;
+        size_t end = std::min(count, begin + VERTEX_CHUNK);
+        transformRange(t, in, out, begin, end);
+    });
+}
@@ -0,0 +1,155 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "color.h"
+#include "framebuffer.h"
+#include "profiler.h"
+#include "rasterizer.h"
+#include "shading.h"
+#include "threadpool.h"
+#include "tiles.h"
+
+// Buffer de visibilidad (--visibility-buffer, tecla V).
+//
+// La rasterización no calcula colores: en cada píxel que pasa el test de
+// profundidad escribe el índice del triángulo (32 bits) en visibilityIds.
+// Después una pasada por la pantalla busca el triángulo de cada píxel
+// visible y corre el sombreado una sola vez, sin importar cuántas capas se
+// dibujaron encima. La pasada se reparte por tiles entre los hilos del pool
+// y recorre cada bloque de 8x8 en el orden en que está en memoria.
+//
+// El índice se escribe con los mismos núcleos del color plano (el número
+// viaja en los cuatro bytes del Color), así que el triángulo que gana cada
+// píxel es el mismo que en el camino directo y, con el mismo sombreado en
+// el mismo centro de píxel, la imagen es idéntica.
+//
+// visibilityIds no se borra: un píxel está cubierto si está en un bloque
+// tocado en este frame y su profundidad ya no es la de clear(). Los
+// bloques sin tocar los completa resolve() con el color de fondo.
+
+bool visibilityBuffer = false;
+
+// Índice del triángulo de cada píxel, con la disposición del framebuffer.
+// Se guarda como Color para que lo escriban los núcleos del rasterizador.
+std::vector<Color> visibilityIds;
+
+// Shaders por píxel de cada triángulo de los modos suaves, y si su plano
+// de atributos es válido
+template <typename S>
+struct VisibilityShaders {
+    std::vector<ShaderPixels<S>> pixels;
+    std::vector<uint8_t> valid;
+};
+
+VisibilityShaders<GouraudShader> gouraudVisibility;
+VisibilityShaders<PhongShader> phongVisibility;
+
+// Triángulos que prepara cada tarea
+const int VISIBILITY_SETUP_BATCH = 1024;
+
+inline Color visibilityId(uint32_t index) {
+    unsigned char bytes[4];
+    std::memcpy(bytes, &index, sizeof(bytes));
+    return Color(bytes[0], bytes[1], bytes[2], bytes[3]);
+}
+
+inline uint32_t visibilityIndex(const Color& id) {
+    uint32_t index;
+    std::memcpy(&index, &id, sizeof(index));
+    return index;
+}
+
+// Repartir los triángulos en tiles y dibujarlos escribiendo su índice.
+// skip(i) descarta los que el camino directo tampoco dibujaría.
+template <typename Tri, typename Skip>
+void rasterizeVisibility(const std::vector<Tri>& triangles, const std::vector<uint32_t>& order, Skip skip) {
+    if (visibilityIds.size() < framebuffer.color.size()) visibilityIds.resize(framebuffer.color.size());
+    Color* ids = visibilityIds.data();
+
+    binTriangles(triangles, order);
+    rasterizeBinnedWith(triangles, [&skip, ids](const Tri& tri, uint32_t index, const RasterRect& rect,
+                                                const RasterTarget& target) {
+        if (skip(index)) return false;
+        RasterTarget idTarget = target;
+        idTarget.color = ids;
+        return rasterizeShaded(tri.v0, tri.v1, tri.v2, visibilityId(index), rect, idTarget, FlatPixels());
+    });
+}
+
+// Sombrear cada píxel visible de un tile: fb.color = shade(índice, px, py)
+template <typename D, typename Shade>
+void shadeVisibleTile(Framebuffer& fb, const RasterRect& rect, const Shade& shade) {
+    const typename D::Type* zbuf = fb.depthAs<D>();
+    const typename D::Type cleared = D::clearValue();
+
+    for (int by = rect.minY / HIZ_BLOCK; by <= rect.maxY / HIZ_BLOCK; by++) {
+        for (int bx = rect.minX / HIZ_BLOCK; bx <= rect.maxX / HIZ_BLOCK; bx++) {
+            if (fb.blockGeneration[by * fb.blocksX + bx] != fb.generation) continue;
+
+            int x0 = bx * HIZ_BLOCK;
+            int x1 = std::min(fb.width, x0 + HIZ_BLOCK);
+            for (int y = by * HIZ_BLOCK; y < std::min(fb.height, (by + 1) * HIZ_BLOCK); y++) {
+                size_t row = fb.offset(x0, y);
+                float py = static_cast<float>(y) + 0.5f;
+                for (int x = x0; x < x1; x++) {
+                    size_t index = row + (x - x0);
+                    if (zbuf[index] == cleared) continue;
+                    fb.color[index] = shade(visibilityIndex(visibilityIds[index]), static_cast<float>(x) + 0.5f, py);
+                }
+            }
+        }
+    }
+}
+
+// Pasada de sombreado sobre toda la pantalla, por tiles en paralelo
+template <typename Shade>
+void shadeVisibility(const Shade& shade) {
+    PROFILE_SCOPE(PROFILE_VISIBILITY);
+    Framebuffer& fb = framebuffer;
+    renderPool().parallelFor(tilesX() * tilesY(), [&](int tile, int) {
+        RasterRect rect = tileRect(tile);
+        switch (fb.depthFormat) {
+            case DepthFormat::Unorm24: shadeVisibleTile<DepthU24>(fb, rect, shade); break;
+            case DepthFormat::Unorm16: shadeVisibleTile<DepthU16>(fb, rect, shade); break;
+            default: shadeVisibleTile<DepthF32>(fb, rect, shade); break;
+        }
+    });
+}
+
+// Triángulos de un solo color, en el orden dado
+template <typename Tri>
+void drawVisibility(const std::vector<Tri>& triangles, const std::vector<uint32_t>& order) {
+    rasterizeVisibility(triangles, order, [](uint32_t) { return false; });
+    shadeVisibility([&triangles](uint32_t index, float, float) { return triangles[index].color; });
+}
+
+// Triángulos con shader, en el orden dado. Los planos de atributos se
+// preparan una vez por triángulo antes de rasterizar.
+template <typename S>
+void drawVisibility(const std::vector<ShadedTriangle<S>>& triangles, const std::vector<uint32_t>& order,
+                    VisibilityShaders<S>& shaders) {
+    {
+        PROFILE_SCOPE(PROFILE_SHADE);
+        shaders.pixels.resize(triangles.size());
+        shaders.valid.resize(triangles.size());
+        int batches = static_cast<int>((triangles.size() + VISIBILITY_SETUP_BATCH - 1) / VISIBILITY_SETUP_BATCH);
+        renderPool().parallelFor(batches, [&](int batch, int) {
+            size_t begin = static_cast<size_t>(batch) * VISIBILITY_SETUP_BATCH;
+            size_t end = std::min(triangles.size(), begin + VISIBILITY_SETUP_BATCH);
+            for (size_t i = begin; i < end; i++) {
+                const ShadedTriangle<S>& tri = triangles[i];
+                ShaderPixels<S>& pixels = shaders.pixels[i];
+                shaders.valid[i] = pixels.planes.setup(tri.v0, tri.v1, tri.v2, tri.invW, tri.varyings);
+                pixels.base = tri.color;
+                pixels.uniforms = &shadingUniforms;
+            }
+        });
+    }
+
+    rasterizeVisibility(triangles, order, [&shaders](uint32_t index) { return !shaders.valid[index]; });
+    shadeVisibility([&shaders](uint32_t index, float px, float py) {
+        return shaders.pixels[index].shade(px, py);
+    });
+}
@@ -0,0 +1,172 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "clipping.h"
+#include "clusters.h"
+#include "color.h"
+#include "lines.h"
+#include "profiler.h"
+#include "threadpool.h"
+#include "tiles.h"
+
+// Malla de alambre a partir de las aristas únicas de cada cluster.
+//
+// Las aristas se arman una vez al cargar (buildClusters); en cada frame se
+// toman sólo las de los clusters visibles, con los vértices que ya
+// transformó la etapa de vértices. Las de clusters que cruzan el plano
+// cercano se recortan en espacio de clip; todas se recortan después al
+// viewport y se reparten en los tiles que atraviesan, así que se dibujan
+// en paralelo igual que los triángulos.
+//
+// En el modo de alambre antes se dibuja la profundidad de la malla sin
+// color, y las líneas tapadas por caras más cercanas no se ven. En el modo
+// superpuesto las líneas se dibujan encima del modelo sombreado.
+
+enum class RenderMode {
+    Filled,
+    Wireframe,      // Sólo aristas, con las ocultas eliminadas por profundidad
+    Overlay         // Modelo sombreado con las aristas encima
+};
+
+const char* renderModeName(RenderMode mode) {
+    switch (mode) {
+        case RenderMode::Wireframe: return "wireframe";
+        case RenderMode::Overlay: return "overlay";
+        default: return "filled";
+    }
+}
+
+RenderMode parseRenderMode(const std::string& name) {
+    if (name == "wireframe") return RenderMode::Wireframe;
+    if (name == "overlay") return RenderMode::Overlay;
+    return RenderMode::Filled;
+}
+
+// Color de las aristas en el modo superpuesto
+const Color WIREFRAME_OVERLAY_COLOR(20, 20, 25);
+
+// Segmento listo para dibujar, ya recortado al viewport
+struct ScreenLine {
+    glm::vec3 a, b;
+    Color color;
+};
+
+// Recortar un segmento en espacio de clip contra el plano cercano. El
+// punto de corte se calcula desde el extremo de adentro, como en
+// clipTriangle, para que coincida con el borde de las caras recortadas.
+inline bool clipSegmentNear(glm::vec4& a, glm::vec4& b) {
+    const glm::vec4& plane = clipPlanes.planes[0];
+    float da = glm::dot(plane, a);
+    float db = glm::dot(plane, b);
+    if (da < 0.0f && db < 0.0f) return false;
+    if (da < 0.0f) {
+        a = b + (a - b) * (db / (db - da));
+    } else if (db < 0.0f) {
+        b = a + (b - a) * (da / (da - db));
+    }
+    return true;
+}
+
+// Armar las aristas de los clusters visibles ya transformados. colorOf(cara)
+// da el color de cada arista a partir de una cara que la usa.
+template <typename ColorFn>
+void assembleClusterLines(const ClusteredMesh& mesh, const std::vector<uint32_t>& visible,
+                          const std::vector<uint8_t>& clipMasks, const TransformedVertices& vertices,
+                          const glm::mat4& projection, const glm::mat4& viewport, ColorFn colorOf,
+                          std::vector<ScreenLine>& out) {
+    out.clear();
+    const VertexStreams& screenPos = vertices.screen;
+    const VertexStreams& viewPos = vertices.view;
+
+    for (size_t k = 0; k < visible.size(); k++) {
+        const Cluster& cluster = mesh.clusters[visible[k]];
+        bool nearClip = (clipMasks[k] & CLIP_NEAR) != 0;
+
+        for (uint32_t e = cluster.edgeBegin; e < cluster.edgeBegin + cluster.edgeCount; e++) {
+            const ClusterEdge& edge = mesh.edges[e];
+            ScreenLine line;
+            if (nearClip) {
+                glm::vec4 a = projection * glm::vec4(viewPos.get(edge.v0), 1.0f);
+                glm::vec4 b = projection * glm::vec4(viewPos.get(edge.v1), 1.0f);
+                if (!clipSegmentNear(a, b)) continue;
+                line.a = clipToScreen(a, viewport);
+                line.b = clipToScreen(b, viewport);
+            } else {
+                line.a = screenPos.get(edge.v0);
+                line.b = screenPos.get(edge.v1);
+            }
+            if (!clipLineToScreen(line.a, line.b)) continue;
+            line.color = colorOf(edge.face);
+            out.push_back(line);
+        }
+    }
+}
+
+// Índices de segmentos por tile, reutilizados entre frames
+std::vector<std::vector<uint32_t>> lineBins(MAX_TILES);
+
+// Repartir segmentos en los tiles que atraviesan: por cada columna de
+// tiles se toma el tramo de y que recorre el segmento en ella
+void binLines(const std::vector<ScreenLine>& lines) {
+    for (auto& bin : lineBins) {
+        bin.clear();
+    }
+
+    int columns = tilesX();
+    int rows = tilesY();
+    for (size_t i = 0; i < lines.size(); i++) {
+        const ScreenLine& line = lines[i];
+        float minX = std::min(line.a.x, line.b.x);
+        float maxX = std::max(line.a.x, line.b.x);
+        float dx = line.b.x - line.a.x;
+        float slope = dx != 0.0f ? (line.b.y - line.a.y) / dx : 0.0f;
+
+        int tx0 = static_cast<int>(minX) / TILE_SIZE;
+        int tx1 = std::min(columns - 1, static_cast<int>(maxX) / TILE_SIZE);
+        for (int tx = tx0; tx <= tx1; tx++) {
+            float y0 = line.a.y;
+            float y1 = line.b.y;
+            if (dx != 0.0f) {
+                float x0 = std::max(minX, static_cast<float>(tx * TILE_SIZE));
+                float x1 = std::min(maxX, static_cast<float>((tx + 1) * TILE_SIZE));
+                y0 = line.a.y + slope * (x0 - line.a.x);
+                y1 = line.a.y + slope * (x1 - line.a.x);
+            }
+            int ty0 = std::max(0, static_cast<int>(std::min(y0, y1)) / TILE_SIZE);
+            int ty1 = std::min(rows - 1, static_cast<int>(std::max(y0, y1)) / TILE_SIZE);
+            for (int ty = ty0; ty <= ty1; ty++) {
+                lineBins[ty * columns + tx].push_back(static_cast<uint32_t>(i));
+            }
+        }
+    }
+}
+
+// Repartir y dibujar segmentos por tiles en paralelo, con test de
+// profundidad contra lo que ya tiene el z-buffer. Los contadores se suman
+// a rasterStats.
+void rasterizeLinesTiled(const std::vector<ScreenLine>& lines) {
+    PROFILE_SCOPE(PROFILE_LINES);
+    binLines(lines);
+
+    ThreadPool& pool = renderPool();
+    tileWorkerStats.assign(pool.size(), RasterStats());
+    pool.parallelFor(tilesX() * tilesY(), [&](int tile, int worker) {
+        RasterTarget target = screenTarget();
+        target.stats = &tileWorkerStats[worker];
+
+        RasterRect rect = tileRect(tile);
+        for (uint32_t index : lineBins[tile]) {
+            const ScreenLine& line = lines[index];
+            rasterizeLine(line.a, line.b, line.color, rect, target);
+        }
+    });
+
+    for (const RasterStats& stats : tileWorkerStats) {
+        rasterStats.add(stats);
+        PROFILE_COUNT(COUNTER_PIXELS_TESTED, stats.pixelsTested);
+        PROFILE_COUNT(COUNTER_PIXELS_WRITTEN, stats.pixelsWritten);
+    }
+}